@@ -0,0 +1,361 @@
+// evaluation microbenchmarks
+//
+// usage: nnet.bench [ seconds ]
+//
+// Times evaluate_neural_network, neural_network::evaluate,
+// neural_network::evaluate_batch, with exact and fast_logistic_output
+// transfer functions, neural_network::evaluate_column_major,
+// incremental_evaluator::evaluate_with changing one input of a base row
+// per evaluation, sparse_neural_network with the synthetic weights
+// pruned by half, prediction_cache hits and, for float, half_neural_network
+// with fp16 and bf16 weights, on the 6-3-1, 3-2-1 and 4-2-3 test networks
+// and on synthetic larger topologies, for float and double and for
+// several batch sizes. Each measurement runs for at least
+// @a seconds (default 0.2). Results are written to standard output as
+// JSON with the time per row, the throughput and, on x86, time stamp
+// counter cycles per row.
+
+#include "gamboge/nnet.h"
+#include "gamboge/incremental_nnet.h"
+#include "gamboge/sparse_nnet.h"
+#include "gamboge/prediction_cache.h"
+#include "gamboge/half_nnet.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define GAMBOGE_NNET_BENCH_TSC 1
+#endif
+
+namespace
+{
+	// weights and inputs of the test networks, see gamboge_nnet_test.cpp
+	const float ann631_wts[] = {
+		  6.31414733F,   0.65097616F,   9.57090502F,   0.09918807F,   0.34747524F,  -0.22119165F,  -1.46227569F,
+		 -2.90137623F,   5.28471412F, -18.85611073F,  -1.23064304F,   0.67967101F,  -0.52377262F,   2.18077394F,
+		  2.73558004F,   1.84685605F,  -1.34649983F,   9.83496163F,  -8.08858473F,   1.23608243F, -11.48135362F,
+		 -3.51048773F,  -7.08398606F,  11.45778956F, -19.95901352F
+	};
+	const float ann631_inputs[] = {
+		 0.37182781F, -0.8311404F,  0.4259828F, -1.4220337F,  0.18336578F, -2.2287368F,
+		 0.54980689F, -0.8311404F,  1.0703898F, -0.5883251F,  0.18336578F, -1.0588553F,
+		-1.06745579F,  1.5445350F, -0.7493098F,  1.1007028F, -1.06960449F,  0.6201034F,
+		 0.09560690F, -0.6512472F, -0.7493098F,  0.3154891F,  0.08288661F,  0.6201034F
+	};
+
+	const float ann321_wts[] = {
+		0.56974212F, -1.5468268F, 1.494846F, -2.8907045F,
+		-6.5020564F, 3.0203401F, -1.7088961F, 2.5260361F,
+		3.393649F, -6.7710899F, -7.2983476F
+	};
+	const float ann321_inputs[] = {
+		1.4F, 6.8F, 4.8F,
+		2.3F, 6.4F, 5.3F,
+		1.3F, 5.7F, 4.1F,
+		0.2F, 4.7F, 1.3F
+	};
+
+	const float ann423_wts[] = {
+		 -7.5744544F, -0.98429384F, -1.216025F, 1.9840944F, 4.3170568F,
+		 0.35806831F, 0.47724404F, 1.5541206F, -2.4603607F, -0.99349176F,
+		 -1.6232478F, -2.1703089F, 6.0064449F,
+		 3.9738482F, -5.5195306F, -5.2175259F,
+		 -2.3506086F, 7.6898515F, -0.78892375F
+	};
+	const float ann423_inputs[] = {
+		4.4F, 3.0F, 1.3F, 0.2F,
+		5.1F, 3.8F, 1.9F, 0.4F,
+		7.2F, 3.2F, 6.0F, 1.8F,
+		5.6F, 2.7F, 4.2F, 1.3F
+	};
+
+	struct model
+	{
+		const char* name;
+		unsigned nx;
+		unsigned nh;
+		unsigned ny;
+		const float* wts;       // 0 for synthetic weights
+		const float* inputs;    // 0 for synthetic inputs
+		unsigned input_rows;
+	};
+
+	const model models[] = {
+		{ "6-3-1", 6, 3, 1, ann631_wts, ann631_inputs, 4 },
+		{ "3-2-1", 3, 2, 1, ann321_wts, ann321_inputs, 4 },
+		{ "4-2-3", 4, 2, 3, ann423_wts, ann423_inputs, 4 },
+		{ "32-16-1", 32, 16, 1, 0, 0, 0 },
+		{ "256-64-10", 256, 64, 10, 0, 0, 0 },
+		{ "1024-128-10", 1024, 128, 10, 0, 0, 0 }
+	};
+
+	const unsigned batch_sizes[] = { 1, 16, 256, 4096 };
+
+	// uniformly distributed value in [ -1, 1 )
+	double next_value( unsigned& seed )
+	{
+		seed = seed * 1103515245U + 12345U;
+		return static_cast< double >( ( seed >> 8 ) & 0xFFFFU ) / 32768.0 - 1.0;
+	}
+
+	unsigned long long cycle_count( )
+	{
+#ifdef GAMBOGE_NNET_BENCH_TSC
+		return __rdtsc( );
+#else
+		return 0;
+#endif
+	}
+
+	struct measurement
+	{
+		double ns_per_row;
+		double rows_per_s;
+		double cycles_per_row;
+		unsigned long long rows;
+	};
+
+	// run op, which scores one batch, until at least min_seconds elapse
+	template< typename Op >
+	measurement time_batches( Op op, unsigned batch, double min_seconds )
+	{
+		op( );   // warm caches and thread workspaces
+
+		unsigned long long batches = 0;
+		unsigned long long step = 1;
+		std::chrono::duration< double > elapsed( 0.0 );
+		unsigned long long cycles = 0;
+		while ( elapsed.count( ) < min_seconds )
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+			unsigned long long c0 = cycle_count( );
+			for ( unsigned long long k = 0; k < step; ++k )
+			{
+				op( );
+			}
+			cycles += cycle_count( ) - c0;
+			elapsed += std::chrono::steady_clock::now( ) - start;
+			batches += step;
+			step *= 2;
+		}
+
+		measurement m;
+		m.rows = batches * batch;
+		m.ns_per_row = elapsed.count( ) * 1e9 / m.rows;
+		m.rows_per_s = m.rows / elapsed.count( );
+		m.cycles_per_row = static_cast< double >( cycles ) / m.rows;
+		return m;
+	}
+
+	template< typename T >
+	struct type_name;
+
+	template< >
+	struct type_name< float >
+	{
+		static const char* get( )
+		{
+			return "float";
+		}
+	};
+
+	template< >
+	struct type_name< double >
+	{
+		static const char* get( )
+		{
+			return "double";
+		}
+	};
+
+	class json_writer
+	{
+	public:
+		json_writer( )
+		: count( 0 )
+		{
+		}
+
+		void result( const model& m, const char* type, const char* method, unsigned batch,
+			const measurement& t )
+		{
+			std::printf( "%s\n    { \"model\": \"%s\", \"inputs\": %u, \"hidden\": %u,"
+				" \"outputs\": %u, \"type\": \"%s\", \"method\": \"%s\", \"batch\": %u,"
+				" \"rows\": %llu, \"ns_per_row\": %.3f, \"rows_per_s\": %.0f,",
+				( count > 0 ) ? "," : "", m.name, m.nx, m.nh, m.ny, type, method, batch,
+				t.rows, t.ns_per_row, t.rows_per_s );
+#ifdef GAMBOGE_NNET_BENCH_TSC
+			std::printf( " \"cycles_per_row\": %.1f }", t.cycles_per_row );
+#else
+			std::printf( " \"cycles_per_row\": null }" );
+#endif
+			std::fflush( stdout );
+			++count;
+		}
+
+	private:
+		unsigned count;
+	};
+
+	// 16-bit weight networks evaluate float inputs only
+	template< typename T >
+	void run_half( const model&, const T*, const T*, T*, unsigned, double, json_writer& )
+	{
+	}
+
+	void run_half( const model& m, const float* w, const float* x, float* y, unsigned batch,
+		double min_seconds, json_writer& out )
+	{
+		const gamboge::half_neural_network< gamboge::fp16_storage > fp16_nnet( m.nx, m.nh, m.ny, w );
+		const gamboge::half_neural_network< gamboge::bf16_storage > bf16_nnet( m.nx, m.nh, m.ny, w );
+
+		out.result( m, "float", "half_neural_network<fp16>::evaluate_batch", batch,
+			time_batches( [&]
+			{
+				fp16_nnet.evaluate_batch( y, x, batch );
+			}, batch, min_seconds ) );
+
+		out.result( m, "float", "half_neural_network<bf16>::evaluate_batch", batch,
+			time_batches( [&]
+			{
+				bf16_nnet.evaluate_batch( y, x, batch );
+			}, batch, min_seconds ) );
+	}
+
+	template< typename T >
+	void run_model( const model& m, double min_seconds, json_writer& out, double& checksum )
+	{
+		typedef gamboge::neural_network< const T*, const T*, T*, unsigned > nnet_type;
+		typedef gamboge::neural_network< const T*, const T*, T*, unsigned,
+			gamboge::fast_logistic_output< T >, gamboge::fast_logistic_output< T > > fast_nnet_type;
+		const unsigned nw = ( m.nh > 0 ) ? m.nh * ( 1 + m.nx ) + m.ny * ( 1 + m.nh )
+			: m.ny * ( 1 + m.nx );
+		const unsigned max_batch = batch_sizes[ sizeof( batch_sizes ) / sizeof( batch_sizes[0] ) - 1 ];
+
+		unsigned seed = 2718U;
+		std::vector< T > wts( nw );
+		for ( unsigned k = 0; k < nw; ++k )
+		{
+			wts[k] = static_cast< T >( m.wts != 0 ? m.wts[k] : 0.1 * next_value( seed ) );
+		}
+		std::vector< T > values( max_batch * m.nx );
+		for ( unsigned k = 0; k < values.size( ); ++k )
+		{
+			values[k] = static_cast< T >( m.inputs != 0
+				? m.inputs[ k % ( m.input_rows * m.nx ) ] : next_value( seed ) );
+		}
+		std::vector< T > outputs( max_batch * m.ny );
+
+		const nnet_type nnet( m.nx, m.nh, m.ny, &(wts[0]) );
+		const fast_nnet_type fast_nnet( m.nx, m.nh, m.ny, &(wts[0]) );
+		const T* w = &(wts[0]);
+		const T* x = &(values[0]);
+		T* y = &(outputs[0]);
+		gamboge::incremental_evaluator< T > incr( m.nx, m.nh, m.ny, w );
+		incr.set_base( x );
+		// synthetic weights are uniform in [ -0.1, 0.1 ), half are dropped
+		const gamboge::sparse_neural_network< T > sparse( m.nx, m.nh, m.ny, w,
+			static_cast< T >( m.wts != 0 ? 0.0 : 0.05 ) );
+		gamboge::prediction_cache< nnet_type > cache( nnet, 2 * max_batch );
+		std::vector< T > columns( values.size( ) );
+		for ( unsigned r = 0; r < max_batch; ++r )
+		{
+			for ( unsigned k = 0; k < m.nx; ++k )
+			{
+				columns[ k * max_batch + r ] = values[ r * m.nx + k ];
+			}
+		}
+		const T* xc = &(columns[0]);
+		const char* type = type_name< T >::get( );
+
+		for ( unsigned b = 0; b < sizeof( batch_sizes ) / sizeof( batch_sizes[0] ); ++b )
+		{
+			const unsigned batch = batch_sizes[b];
+
+			out.result( m, type, "evaluate_neural_network", batch, time_batches( [&]
+				{
+					for ( unsigned r = 0; r < batch; ++r )
+					{
+						gamboge::evaluate_neural_network( x + r * m.nx, w, y + r * m.ny,
+							m.nx, m.nh, m.ny );
+					}
+				}, batch, min_seconds ) );
+
+			out.result( m, type, "neural_network::evaluate", batch, time_batches( [&]
+				{
+					for ( unsigned r = 0; r < batch; ++r )
+					{
+						nnet.evaluate( y + r * m.ny, x + r * m.nx );
+					}
+				}, batch, min_seconds ) );
+
+			out.result( m, type, "neural_network::evaluate_batch", batch, time_batches( [&]
+				{
+					nnet.evaluate_batch( y, x, batch );
+				}, batch, min_seconds ) );
+
+			out.result( m, type, "neural_network::evaluate_batch fast_logistic", batch,
+				time_batches( [&]
+				{
+					fast_nnet.evaluate_batch( y, x, batch );
+				}, batch, min_seconds ) );
+
+			out.result( m, type, "neural_network::evaluate_column_major", batch, time_batches( [&]
+				{
+					nnet.evaluate_column_major( y, xc, batch, max_batch );
+				}, batch, min_seconds ) );
+
+			out.result( m, type, "sparse_neural_network::evaluate_batch", batch, time_batches( [&]
+				{
+					sparse.evaluate_batch( y, x, batch );
+				}, batch, min_seconds ) );
+
+			out.result( m, type, "incremental_evaluator::evaluate_with", batch, time_batches( [&]
+				{
+					for ( unsigned r = 0; r < batch; ++r )
+					{
+						incr.evaluate_with( y + r * m.ny, r % m.nx, x[ m.nx + r ] );
+					}
+				}, batch, min_seconds ) );
+
+			// rows cached by the first, warm-up call
+			out.result( m, type, "prediction_cache::evaluate hit", batch, time_batches( [&]
+				{
+					for ( unsigned r = 0; r < batch; ++r )
+					{
+						cache.evaluate( y + r * m.ny, x + r * m.nx );
+					}
+				}, batch, min_seconds ) );
+
+			run_half( m, w, x, y, batch, min_seconds, out );
+
+			for ( unsigned k = 0; k < batch * m.ny; ++k )
+			{
+				checksum += outputs[k];
+			}
+		}
+	}
+}
+
+int
+main( int argc, char* argv[] )
+{
+	const double min_seconds = ( argc > 1 ) ? std::atof( argv[1] ) : 0.2;
+	json_writer out;
+	double checksum = 0.0;
+
+	std::printf( "{\n  \"benchmark\": \"gamboge_nnet\",\n  \"min_seconds\": %g,\n"
+		"  \"results\": [", min_seconds );
+	for ( unsigned k = 0; k < sizeof( models ) / sizeof( models[0] ); ++k )
+	{
+		run_model< float >( models[k], min_seconds, out, checksum );
+		run_model< double >( models[k], min_seconds, out, checksum );
+	}
+	// the checksum keeps the evaluations from being optimized away
+	std::printf( "\n  ],\n  \"checksum\": %.6g\n}\n", checksum );
+	return 0;
+}
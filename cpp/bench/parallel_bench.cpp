@@ -0,0 +1,97 @@
+// parallel_evaluator scaling benchmark
+//
+// usage: parallel.bench [ rows [ repeats ] ]
+//
+// Scores a synthetic 256-64-10 network over an input matrix with 1 to
+// hardware_concurrency worker threads and reports the throughput and the
+// speedup relative to one thread.
+
+#include "gamboge/nnet.h"
+#include "gamboge/packed_nnet.h"
+#include "gamboge/parallel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// uniformly distributed value in [ -1, 1 )
+	float next_value( unsigned& seed )
+	{
+		seed = seed * 1103515245U + 12345U;
+		return static_cast<float>( ( seed >> 8 ) & 0xFFFFU ) / 32768.0F - 1.0F;
+	}
+
+	template< typename Network >
+	void run_scaling( const char* name, const Network& nnet, const std::vector<float>& values,
+		std::size_t row_count, int repeats )
+	{
+		const std::size_t in_count = nnet.inputs( );
+		std::vector<float> outputs( row_count * nnet.outputs( ) );
+		const unsigned max_threads = std::max( 1U, std::thread::hardware_concurrency( ) );
+		double base_rate = 0.0;
+
+		std::printf( "%s\n%8s %12s %14s %8s\n", name, "threads", "seconds", "rows/s", "speedup" );
+		for ( unsigned threads = 1; threads <= max_threads; threads = ( threads < max_threads
+			&& threads * 2 > max_threads ) ? max_threads : threads * 2 )
+		{
+			gamboge::parallel_evaluator< Network > scorer( nnet, threads );
+			scorer.evaluate( &(outputs[0]), &(values[0]), row_count, in_count );
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+			for ( int k = 0; k < repeats; ++k )
+			{
+				scorer.evaluate( &(outputs[0]), &(values[0]), row_count, in_count );
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now( ) - start;
+
+			double rate = static_cast<double>( row_count ) * repeats / elapsed.count( );
+			if ( threads == 1 )
+			{
+				base_rate = rate;
+			}
+			std::printf( "%8u %12.4f %14.0f %8.2f\n", threads, elapsed.count( ), rate,
+				rate / base_rate );
+			if ( threads == max_threads )
+			{
+				break;
+			}
+		}
+	}
+}
+
+int
+main( int argc, char* argv[] )
+{
+	const std::size_t row_count = ( argc > 1 ) ? std::strtoul( argv[1], 0, 10 ) : 100000;
+	const int repeats = ( argc > 2 ) ? std::atoi( argv[2] ) : 5;
+	const unsigned in_count = 256;
+	const unsigned hidden_count = 64;
+	const unsigned out_count = 10;
+
+	unsigned seed = 2718U;
+	std::vector<float> wts( hidden_count * ( 1 + in_count ) + out_count * ( 1 + hidden_count ) );
+	for ( std::size_t k = 0; k < wts.size( ); ++k )
+	{
+		wts[k] = 0.1F * next_value( seed );
+	}
+	std::vector<float> values( row_count * in_count );
+	for ( std::size_t k = 0; k < values.size( ); ++k )
+	{
+		values[k] = next_value( seed );
+	}
+
+	typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+	const nnet_type nnet( in_count, hidden_count, out_count, &(wts[0]) );
+	const gamboge::packed_neural_network< float > packed_nnet( in_count, hidden_count,
+		out_count, &(wts[0]) );
+
+	std::printf( "256-64-10 network, %lu rows, %d repeats\n\n",
+		static_cast<unsigned long>( row_count ), repeats );
+	run_scaling( "neural_network", nnet, values, row_count, repeats );
+	std::printf( "\n" );
+	run_scaling( "packed_neural_network", packed_nnet, values, row_count, repeats );
+	return 0;
+}
@@ -0,0 +1,127 @@
+// inference_queue load generator
+//
+// usage: queue.bench [ clients [ requests ] ]
+//
+// Runs closed-loop client threads, each sending single-row requests for
+// a synthetic 256-64-10 network one after another, first calling
+// neural_network::evaluate once per request and then through an
+// inference_queue at several batch sizes and deadlines. Reports the
+// median and 99th percentile request latency and the throughput.
+
+#include "gamboge/nnet.h"
+#include "gamboge/inference_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+	typedef std::chrono::steady_clock clock_type;
+
+	// uniformly distributed value in [ -1, 1 )
+	float next_value( unsigned& seed )
+	{
+		seed = seed * 1103515245U + 12345U;
+		return static_cast<float>( ( seed >> 8 ) & 0xFFFFU ) / 32768.0F - 1.0F;
+	}
+
+	// run the clients, each making requests calls to op( client, row ),
+	// and report latency percentiles and throughput
+	template< typename Op >
+	void run_clients( const char* name, Op op, unsigned clients, unsigned requests,
+		std::size_t row_count )
+	{
+		std::vector< std::vector< double > > latencies( clients );
+		std::vector< std::thread > threads;
+		clock_type::time_point start = clock_type::now( );
+		for ( unsigned c = 0; c < clients; ++c )
+		{
+			threads.push_back( std::thread( [&, c]
+				{
+					std::vector< double >& lat = latencies[c];
+					lat.reserve( requests );
+					for ( unsigned k = 0; k < requests; ++k )
+					{
+						clock_type::time_point t0 = clock_type::now( );
+						op( c, ( c * requests + k ) % row_count );
+						lat.push_back( std::chrono::duration< double, std::micro >(
+							clock_type::now( ) - t0 ).count( ) );
+					}
+				} ) );
+		}
+		for ( unsigned c = 0; c < clients; ++c )
+		{
+			threads[c].join( );
+		}
+		std::chrono::duration< double > elapsed = clock_type::now( ) - start;
+
+		std::vector< double > all;
+		for ( unsigned c = 0; c < clients; ++c )
+		{
+			all.insert( all.end( ), latencies[c].begin( ), latencies[c].end( ) );
+		}
+		std::sort( all.begin( ), all.end( ) );
+		const double p50 = all[ all.size( ) / 2 ];
+		const double p99 = all[ std::min( all.size( ) - 1, all.size( ) * 99 / 100 ) ];
+		std::printf( "%-28s %10.1f %10.1f %14.0f\n", name, p50, p99,
+			all.size( ) / elapsed.count( ) );
+		std::fflush( stdout );
+	}
+}
+
+int
+main( int argc, char* argv[] )
+{
+	const unsigned clients = ( argc > 1 ) ? std::atoi( argv[1] ) : 16;
+	const unsigned requests = ( argc > 2 ) ? std::atoi( argv[2] ) : 2000;
+	const unsigned in_count = 256;
+	const unsigned hidden_count = 64;
+	const unsigned out_count = 10;
+	const std::size_t row_count = 1024;
+
+	unsigned seed = 2718U;
+	std::vector<float> wts( hidden_count * ( 1 + in_count ) + out_count * ( 1 + hidden_count ) );
+	for ( std::size_t k = 0; k < wts.size( ); ++k )
+	{
+		wts[k] = 0.1F * next_value( seed );
+	}
+	std::vector<float> values( row_count * in_count );
+	for ( std::size_t k = 0; k < values.size( ); ++k )
+	{
+		values[k] = next_value( seed );
+	}
+	const nnet_type nnet( in_count, hidden_count, out_count, &(wts[0]) );
+
+	std::printf( "256-64-10 network, %u clients, %u requests each\n\n", clients, requests );
+	std::printf( "%-28s %10s %10s %14s\n", "method", "p50 us", "p99 us", "requests/s" );
+
+	std::vector< std::vector< float > > outputs( clients, std::vector< float >( out_count ) );
+	run_clients( "evaluate per request", [&]( unsigned c, std::size_t r )
+		{
+			nnet.evaluate( &(outputs[c][0]), &(values[r*in_count]) );
+		}, clients, requests, row_count );
+
+	const unsigned max_batches[] = { 4, 16, 64 };
+	const unsigned max_waits_us[] = { 50, 500 };
+	for ( unsigned b = 0; b < sizeof( max_batches ) / sizeof( max_batches[0] ); ++b )
+	{
+		for ( unsigned w = 0; w < sizeof( max_waits_us ) / sizeof( max_waits_us[0] ); ++w )
+		{
+			gamboge::inference_queue< nnet_type > queue( nnet, max_batches[b],
+				std::chrono::microseconds( max_waits_us[w] ) );
+			char name[ 64 ];
+			std::snprintf( name, sizeof( name ), "queue batch %u wait %u us",
+				max_batches[b], max_waits_us[w] );
+			run_clients( name, [&]( unsigned c, std::size_t r )
+				{
+					outputs[c] = queue.submit( &(values[r*in_count]) ).get( );
+				}, clients, requests, row_count );
+		}
+	}
+	return 0;
+}
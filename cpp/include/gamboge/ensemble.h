@@ -0,0 +1,328 @@
+//! @file gamboge/ensemble.h
+//! gamboge ensemble of neural networks evaluated in one pass
+
+#ifndef _GAMBOGE_ENSEMBLE_H
+#define _GAMBOGE_ENSEMBLE_H 1
+
+#include "gamboge/nnet.h"
+#include <cstddef>
+#include <vector>
+
+namespace gamboge
+{
+	//! ensemble reducer, mean of the member outputs
+	//!
+	//! The reducer is called with the outputs of all members for one input
+	//! row; member @a m's @p ny outputs start at @p outputs + @a m * @p ny.
+	template< typename T >
+	struct mean_reducer
+	{
+		void operator()( const T* outputs, std::size_t nmembers, std::size_t ny,
+			T* result ) const
+		{
+			std::fill( result, result + ny, static_cast< T >( 0 ) );
+			for ( std::size_t m = 0; m < nmembers; ++m )
+			{
+				for ( std::size_t k = 0; k < ny; ++k )
+				{
+					result[k] += outputs[ m*ny + k ];
+				}
+			}
+			for ( std::size_t k = 0; k < ny; ++k )
+			{
+				result[k] /= static_cast< T >( nmembers );
+			}
+		}
+	};
+
+	//! ensemble reducer, fraction of members voting for each class
+	//!
+	//! With multiple outputs each member votes for its largest output. With
+	//! a single output each member votes for the class 1 if its output
+	//! exceeds 0.5, and the result is the fraction of members voting for 1.
+	template< typename T >
+	struct vote_reducer
+	{
+		void operator()( const T* outputs, std::size_t nmembers, std::size_t ny,
+			T* result ) const
+		{
+			std::fill( result, result + ny, static_cast< T >( 0 ) );
+			const T vote = static_cast< T >( 1 ) / static_cast< T >( nmembers );
+			for ( std::size_t m = 0; m < nmembers; ++m )
+			{
+				const T* mo = outputs + m * ny;
+				if ( ny > 1 )
+				{
+					result[ std::max_element( mo, mo + ny ) - mo ] += vote;
+				}
+				else if ( mo[0] > static_cast< T >( 0.5 ) )
+				{
+					result[0] += vote;
+				}
+			}
+		}
+	};
+
+	//! ensemble of artificial neural networks sharing their inputs
+	//!
+	//! @tparam T        value type of weights, inputs and outputs
+	//! @tparam Reducer  combines the member outputs for a row, e.g.
+	//!                  mean_reducer or vote_reducer
+	//! @tparam UnaryOp  output transform for a member's single output unit
+	//!
+	//! Holds the weights of many networks with the same input and output
+	//! counts, such as a bagged (avNNet) ensemble of R nnet models. Members
+	//! may have different hidden-layer counts. The hidden-layer weight
+	//! blocks of all members are concatenated into one wide layer, so the
+	//! inputs are buffered once and every member's hidden units are
+	//! computed in a single pass over the weights. Each member's output
+	//! layer is then applied to its slice of the hidden outputs, the
+	//! softmax operator or @p UnaryOp is applied as in
+	//! evaluate_neural_network, and the reducer combines the members.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	gamboge::ensemble_network< double > ensemble( in_count, out_count );
+	//! 	for ( unsigned m = 0; m < member_count; ++m )
+	//! 	{
+	//! 		ensemble.add_member( hidden_count, &(member_wts[m][0]) );
+	//! 	}
+	//! 	ensemble.evaluate( nn_out, nn_in );
+	//! }
+	//! @endcode
+	template< typename T, typename Reducer = mean_reducer< T >,
+		typename UnaryOp = logistic_output< T > >
+	class ensemble_network
+	{
+	public:
+		typedef T value_type;
+		typedef nnet_workspace< T > workspace_type;
+
+		//! constructor, ensemble without members
+		//!
+		//! @param n        input count
+		//! @param k        output count
+		//! @param reducer  combines the member outputs
+		//! @param unaryop  output transform for a single output-layer unit
+		ensemble_network( std::size_t n, std::size_t k, Reducer reducer = Reducer( ),
+			UnaryOp unaryop = UnaryOp( ) )
+		: input_count( n ),
+		  output_count( k ),
+		  hidden_total( 0 ),
+		  reducer( reducer ),
+		  unaryop( unaryop )
+		{
+		}
+
+		//! Add a member network
+		//!
+		//! @param m        hidden-layer count of the member
+		//! @param wts      start of the member's weights sequence, see
+		//!                 evaluate_neural_network
+		template< typename InIterWt >
+		void add_member( std::size_t m, InIterWt wts )
+		{
+			member mb;
+			mb.hidden_count = m;
+			mb.hidden_offset = hidden_total;
+			mb.output_offset = output_wts.size( );
+			for ( std::size_t k = 0; k < m * ( 1 + input_count ); ++k, ++wts )
+			{
+				hidden_wts.push_back( *wts );
+			}
+			const std::size_t out_inputs = ( m > 0 ) ? m : input_count;
+			for ( std::size_t k = 0; k < output_count * ( 1 + out_inputs ); ++k, ++wts )
+			{
+				output_wts.push_back( *wts );
+			}
+			hidden_total += m;
+			member_nets.push_back( mb );
+		}
+
+		//! Evaluate the ensemble outputs
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result, const T* values ) const
+		{
+			return evaluate_batch( result, values, 1, input_count, _thread_workspace< T >() );
+		}
+
+		//! Evaluate the ensemble outputs using a workspace
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result, const T* values, workspace_type& ws ) const
+		{
+			return evaluate_batch( result, values, 1, input_count, ws );
+		}
+
+		//! Evaluate the ensemble outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return pointer marking end of result sequence
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, input_count, _thread_workspace< T >() );
+		}
+
+		//! Evaluate the ensemble outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		//!
+		//! See evaluate_neural_network_batch for the matrix layouts. Rows are
+		//! evaluated in blocks, the wide hidden layer applied to all rows of
+		//! a block.
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows, std::size_t stride,
+			workspace_type& ws ) const
+		{
+			const std::size_t nm = member_nets.size( );
+			const std::size_t ny = output_count;
+			std::size_t nb = std::min( nrows,
+				_batch_block_rows< T >( input_count, hidden_total, nm * ny ) );
+			if ( nb == 0 || nm == 0 )
+			{
+				return result;
+			}
+
+			// buffers for a block of input rows, the hidden-layer outputs of
+			// all members, each member's linear outputs and one row of
+			// transformed member outputs
+			T* unitsbuf = ws.reserve( nb * ( input_count + hidden_total + nm * ny ) + nm * ny );
+			if ( unitsbuf == 0 )
+			{
+				return result;
+			}
+			T* inbuf = &(unitsbuf[0]);
+			T* hidden_out = &(unitsbuf[nb*input_count]);
+			T* linout = &(unitsbuf[nb*(input_count+hidden_total)]);
+			T* rowout = &(unitsbuf[nb*(input_count+hidden_total+nm*ny)]);
+
+			for ( std::size_t r0 = 0; r0 < nrows; r0 += nb )
+			{
+				std::size_t rows = std::min( nb, nrows - r0 );
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					const T* itx = values + ( r0 + r ) * stride;
+					std::copy( itx, itx + input_count, &(inbuf[r*input_count]) );
+				}
+
+				if ( hidden_total > 0 )
+				{
+					_evaluate_layer_block( hidden_wts.begin( ), inbuf, input_count,
+						hidden_total, rows, hidden_out, logistic_output< T >() );
+				}
+
+				// member m's linear outputs for row r are at
+				// linout + ( m * nb + r ) * ny
+				for ( std::size_t m = 0; m < nm; ++m )
+				{
+					const member& mb = member_nets[m];
+					if ( mb.hidden_count > 0 )
+					{
+						apply_output_layer( mb, hidden_out + mb.hidden_offset, hidden_total,
+							mb.hidden_count, rows, linout + m * nb * ny );
+					}
+					else
+					{
+						apply_output_layer( mb, inbuf, input_count, input_count,
+							rows, linout + m * nb * ny );
+					}
+				}
+
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					for ( std::size_t m = 0; m < nm; ++m )
+					{
+						T* lo = linout + ( m * nb + r ) * ny;
+						if ( ny > 1 )
+						{
+							_softmax( lo, lo + ny, lo );
+							std::copy( lo, lo + ny, rowout + m * ny );
+						}
+						else
+						{
+							rowout[m] = unaryop( lo[0] );
+						}
+					}
+					reducer( rowout, nm, ny, result );
+					result += ny;
+				}
+			}
+			return result;
+		}
+
+		//! @return member count
+		std::size_t members( ) const
+		{
+			return member_nets.size( );
+		}
+
+		//! @return input count
+		std::size_t inputs( ) const
+		{
+			return input_count;
+		}
+
+		//! @return hidden-layer unit count of all members
+		std::size_t hidden( ) const
+		{
+			return hidden_total;
+		}
+
+		//! @return output count
+		std::size_t outputs( ) const
+		{
+			return output_count;
+		}
+
+	private:
+		struct member
+		{
+			std::size_t hidden_count;
+			std::size_t hidden_offset;   // first unit in the wide hidden layer
+			std::size_t output_offset;   // first output-layer weight
+		};
+
+		// apply a member's output layer to a block of rows; row r of the
+		// layer's inputs is [ in + r * in_stride, in + r * in_stride + nin )
+		void apply_output_layer( const member& mb, const T* in, std::size_t in_stride,
+			std::size_t nin, std::size_t rows, T* out ) const
+		{
+			typename std::vector< T >::const_iterator itw = output_wts.begin( ) + mb.output_offset;
+			for ( std::size_t ok = 0; ok < output_count; ++ok )
+			{
+				T bias = *itw;
+				++itw;
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					out[ r*output_count + ok ] = std::inner_product( itw, itw + nin,
+						in + r * in_stride, bias );
+				}
+				itw += nin;
+			}
+		}
+
+		std::size_t input_count;
+		std::size_t output_count;
+		std::size_t hidden_total;
+		std::vector< member > member_nets;
+		std::vector< T > hidden_wts;
+		std::vector< T > output_wts;
+		Reducer reducer;
+		UnaryOp unaryop;
+	};
+}
+
+#endif
@@ -0,0 +1,579 @@
+//! @file gamboge/half_nnet.h
+//! gamboge neural network with 16-bit floating point weights
+
+#ifndef _GAMBOGE_HALF_NNET_H
+#define _GAMBOGE_HALF_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include "gamboge/nnet_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+namespace gamboge
+{
+	//! IEEE 754 binary16 weights: 11-bit significand, magnitudes from
+	//! about 6.0E-8 to 65504
+	struct fp16_storage
+	{
+	};
+
+	//! bfloat16 weights: 8-bit significand, the exponent range of float
+	struct bf16_storage
+	{
+	};
+
+	//! @cond
+	//! float to binary16, rounded to nearest even; overflow gives infinity
+	inline uint16_t
+	_float_to_half( float f, fp16_storage )
+	{
+		uint32_t x;
+		std::memcpy( &x, &f, sizeof( x ) );
+		const uint16_t sign = static_cast< uint16_t >( ( x >> 16 ) & 0x8000U );
+		x &= 0x7FFFFFFFU;
+		if ( x > 0x7F800000U )
+		{
+			return sign | 0x7E00U;
+		}
+		if ( x >= 0x477FF000U )    // 65520 and above round to infinity
+		{
+			return sign | 0x7C00U;
+		}
+		uint32_t r;
+		uint32_t rem;
+		uint32_t half;
+		if ( x < 0x38800000U )     // below 2^-14, subnormal binary16
+		{
+			if ( x < 0x33000000U )
+			{
+				return sign;
+			}
+			const uint32_t shift = 126 - ( x >> 23 );
+			const uint32_t m = ( x & 0x007FFFFFU ) | 0x00800000U;
+			r = m >> shift;
+			rem = m & ( ( 1U << shift ) - 1 );
+			half = 1U << ( shift - 1 );
+		}
+		else
+		{
+			r = ( x - 0x38000000U ) >> 13;
+			rem = x & 0x1FFFU;
+			half = 0x1000U;
+		}
+		if ( rem > half || ( rem == half && ( r & 1 ) ) )
+		{
+			++r;
+		}
+		return sign | static_cast< uint16_t >( r );
+	}
+
+	inline float
+	_half_to_float( uint16_t h, fp16_storage )
+	{
+		const uint32_t sign = static_cast< uint32_t >( h & 0x8000U ) << 16;
+		const uint32_t e = ( h >> 10 ) & 0x1FU;
+		const uint32_t m = h & 0x03FFU;
+		uint32_t x;
+		if ( e == 0x1FU )
+		{
+			x = sign | 0x7F800000U | ( m << 13 );
+		}
+		else if ( e == 0 )
+		{
+			const float v = std::ldexp( static_cast< float >( m ), -24 );
+			return sign ? -v : v;
+		}
+		else
+		{
+			x = sign | ( ( e + 112 ) << 23 ) | ( m << 13 );
+		}
+		float f;
+		std::memcpy( &f, &x, sizeof( f ) );
+		return f;
+	}
+
+	//! float to bfloat16, rounded to nearest even
+	inline uint16_t
+	_float_to_half( float f, bf16_storage )
+	{
+		uint32_t x;
+		std::memcpy( &x, &f, sizeof( x ) );
+		if ( ( x & 0x7FFFFFFFU ) > 0x7F800000U )
+		{
+			return static_cast< uint16_t >( ( x >> 16 ) | 0x0040U );
+		}
+		return static_cast< uint16_t >( ( x + 0x7FFFU + ( ( x >> 16 ) & 1 ) ) >> 16 );
+	}
+
+	inline float
+	_half_to_float( uint16_t h, bf16_storage )
+	{
+		const uint32_t x = static_cast< uint32_t >( h ) << 16;
+		float f;
+		std::memcpy( &f, &x, sizeof( f ) );
+		return f;
+	}
+
+	//! portable layer kernel; units' weights are rows of nin 16-bit values
+	template< typename Format >
+	void
+	_half_layer_scalar( const uint16_t* w, const float* bias, const float* x, std::size_t xstride,
+		std::size_t nrows, std::size_t nin, std::size_t nunits, float* out, std::size_t ostride )
+	{
+		for ( std::size_t r = 0; r < nrows; ++r )
+		{
+			const float* xr = x + r * xstride;
+			for ( std::size_t u = 0; u < nunits; ++u )
+			{
+				const uint16_t* wu = w + u * nin;
+				float acc = 0.0F;
+				for ( std::size_t k = 0; k < nin; ++k )
+				{
+					acc += _half_to_float( wu[k], Format( ) ) * xr[k];
+				}
+				out[ r * ostride + u ] = bias[u] + acc;
+			}
+		}
+	}
+
+#ifdef GAMBOGE_NNET_X86_SIMD
+	// The vector kernels compute four units at a time for every row of the
+	// block, so the four units' weights are read from memory once per block
+	// and from cache for the other rows. Weights are widened to float as
+	// they are loaded and the products accumulated in float. Partial
+	// vectors are copied through a zeroed buffer.
+
+	__attribute__(( target( "avx2,fma,f16c" ) ))
+	inline __m256
+	_widen_avx2( __m128i h, fp16_storage )
+	{
+		return _mm256_cvtph_ps( h );
+	}
+
+	__attribute__(( target( "avx2,fma,f16c" ) ))
+	inline __m256
+	_widen_avx2( __m128i h, bf16_storage )
+	{
+		return _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_cvtepu16_epi32( h ), 16 ) );
+	}
+
+	template< typename Format >
+	__attribute__(( target( "avx2,fma,f16c" ) ))
+	inline __m256
+	_load_half_avx2( const uint16_t* w, std::size_t n )
+	{
+		if ( n >= 8 )
+		{
+			return _widen_avx2( _mm_loadu_si128( reinterpret_cast< const __m128i* >( w ) ),
+				Format( ) );
+		}
+		uint16_t buf[ 8 ] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		std::copy( w, w + n, buf );
+		return _widen_avx2( _mm_loadu_si128( reinterpret_cast< const __m128i* >( buf ) ), Format( ) );
+	}
+
+	__attribute__(( target( "avx2,fma,f16c" ) ))
+	inline float
+	_reduce_add_avx2( __m256 a )
+	{
+		__m128 s = _mm_add_ps( _mm256_castps256_ps128( a ), _mm256_extractf128_ps( a, 1 ) );
+		s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+		s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+		return _mm_cvtss_f32( s );
+	}
+
+	template< typename Format >
+	__attribute__(( target( "avx2,fma,f16c" ) ))
+	void
+	_half_layer_avx2( const uint16_t* w, const float* bias, const float* x, std::size_t xstride,
+		std::size_t nrows, std::size_t nin, std::size_t nunits, float* out, std::size_t ostride )
+	{
+		for ( std::size_t u = 0; u < nunits; u += 4 )
+		{
+			// a group of fewer than four units repeats its first unit
+			const std::size_t nu = std::min( nunits - u, std::size_t( 4 ) );
+			const uint16_t* w0 = w + u * nin;
+			const uint16_t* w1 = ( nu > 1 ) ? w0 + nin : w0;
+			const uint16_t* w2 = ( nu > 2 ) ? w0 + 2 * nin : w0;
+			const uint16_t* w3 = ( nu > 3 ) ? w0 + 3 * nin : w0;
+			for ( std::size_t r = 0; r < nrows; ++r )
+			{
+				const float* xr = x + r * xstride;
+				__m256 a0 = _mm256_setzero_ps( ), a1 = a0, a2 = a0, a3 = a0;
+				for ( std::size_t k = 0; k < nin; k += 8 )
+				{
+					const std::size_t n = nin - k;
+					__m256 xv;
+					if ( n >= 8 )
+					{
+						xv = _mm256_loadu_ps( xr + k );
+					}
+					else
+					{
+						float buf[ 8 ] = { 0.0F, 0.0F, 0.0F, 0.0F, 0.0F, 0.0F, 0.0F, 0.0F };
+						std::copy( xr + k, xr + nin, buf );
+						xv = _mm256_loadu_ps( buf );
+					}
+					a0 = _mm256_fmadd_ps( _load_half_avx2< Format >( w0 + k, n ), xv, a0 );
+					a1 = _mm256_fmadd_ps( _load_half_avx2< Format >( w1 + k, n ), xv, a1 );
+					a2 = _mm256_fmadd_ps( _load_half_avx2< Format >( w2 + k, n ), xv, a2 );
+					a3 = _mm256_fmadd_ps( _load_half_avx2< Format >( w3 + k, n ), xv, a3 );
+				}
+				const float sums[ 4 ] = { _reduce_add_avx2( a0 ), _reduce_add_avx2( a1 ),
+					_reduce_add_avx2( a2 ), _reduce_add_avx2( a3 ) };
+				for ( std::size_t j = 0; j < nu; ++j )
+				{
+					out[ r * ostride + u + j ] = bias[ u + j ] + sums[j];
+				}
+			}
+		}
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline __m512
+	_widen_avx512( __m256i h, fp16_storage )
+	{
+		return _mm512_cvtph_ps( h );
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline __m512
+	_widen_avx512( __m256i h, bf16_storage )
+	{
+		return _mm512_castsi512_ps( _mm512_slli_epi32( _mm512_cvtepu16_epi32( h ), 16 ) );
+	}
+
+	template< typename Format >
+	__attribute__(( target( "avx512f" ) ))
+	inline __m512
+	_load_half_avx512( const uint16_t* w, std::size_t n )
+	{
+		if ( n >= 16 )
+		{
+			return _widen_avx512( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( w ) ),
+				Format( ) );
+		}
+		uint16_t buf[ 16 ] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+		std::copy( w, w + n, buf );
+		return _widen_avx512( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( buf ) ),
+			Format( ) );
+	}
+
+	template< typename Format >
+	__attribute__(( target( "avx512f" ) ))
+	void
+	_half_layer_avx512( const uint16_t* w, const float* bias, const float* x, std::size_t xstride,
+		std::size_t nrows, std::size_t nin, std::size_t nunits, float* out, std::size_t ostride )
+	{
+		for ( std::size_t u = 0; u < nunits; u += 4 )
+		{
+			// a group of fewer than four units repeats its first unit
+			const std::size_t nu = std::min( nunits - u, std::size_t( 4 ) );
+			const uint16_t* w0 = w + u * nin;
+			const uint16_t* w1 = ( nu > 1 ) ? w0 + nin : w0;
+			const uint16_t* w2 = ( nu > 2 ) ? w0 + 2 * nin : w0;
+			const uint16_t* w3 = ( nu > 3 ) ? w0 + 3 * nin : w0;
+			for ( std::size_t r = 0; r < nrows; ++r )
+			{
+				const float* xr = x + r * xstride;
+				__m512 a0 = _mm512_setzero_ps( ), a1 = a0, a2 = a0, a3 = a0;
+				for ( std::size_t k = 0; k < nin; k += 16 )
+				{
+					const std::size_t n = nin - k;
+					__mmask16 m = ( n >= 16 ) ? __mmask16( 0xFFFF ) : __mmask16( ( 1U << n ) - 1 );
+					__m512 xv = _mm512_maskz_loadu_ps( m, xr + k );
+					a0 = _mm512_fmadd_ps( _load_half_avx512< Format >( w0 + k, n ), xv, a0 );
+					a1 = _mm512_fmadd_ps( _load_half_avx512< Format >( w1 + k, n ), xv, a1 );
+					a2 = _mm512_fmadd_ps( _load_half_avx512< Format >( w2 + k, n ), xv, a2 );
+					a3 = _mm512_fmadd_ps( _load_half_avx512< Format >( w3 + k, n ), xv, a3 );
+				}
+				const float sums[ 4 ] = { _mm512_reduce_add_ps( a0 ), _mm512_reduce_add_ps( a1 ),
+					_mm512_reduce_add_ps( a2 ), _mm512_reduce_add_ps( a3 ) };
+				for ( std::size_t j = 0; j < nu; ++j )
+				{
+					out[ r * ostride + u + j ] = bias[ u + j ] + sums[j];
+				}
+			}
+		}
+	}
+#endif
+	//! @endcond
+
+	//! layer kernel for 16-bit weights
+	//!
+	//! @par layer
+	//! computes the linear outputs of @a nunits units for @a nrows rows,
+	//! @a out[ @a r * @a ostride + @a u ] = @a bias[ @a u ] +
+	//! &lang; @a x + @a r * @a xstride, @a w + @a u * @a nin &rang;, the
+	//! weights of each unit being @a nin consecutive 16-bit values.
+	template< typename Format >
+	struct half_kernels
+	{
+		void (*layer)( const uint16_t* w, const float* bias, const float* x, std::size_t xstride,
+			std::size_t nrows, std::size_t nin, std::size_t nunits, float* out, std::size_t ostride );
+		simd_level level;
+	};
+
+	//! Obtain the 16-bit weight kernels for an instruction set level
+	//!
+	//! @param level    requested level, limited to simd_supported_level
+	//! @return kernel dispatch table; there are AVX2 kernels, using F16C
+	//!         for fp16_storage, and AVX-512 kernels, other levels use the
+	//!         portable kernels
+	template< typename Format >
+	half_kernels< Format >
+	half_select( simd_level level )
+	{
+		half_kernels< Format > k = { &_half_layer_scalar< Format >, simd_scalar };
+#ifdef GAMBOGE_NNET_X86_SIMD
+		level = std::min( level, simd_supported_level( ) );
+		if ( level >= simd_avx512 )
+		{
+			k.layer = &_half_layer_avx512< Format >;
+			k.level = simd_avx512;
+		}
+		else if ( level >= simd_avx2 && __builtin_cpu_supports( "f16c" ) )
+		{
+			k.layer = &_half_layer_avx2< Format >;
+			k.level = simd_avx2;
+		}
+#else
+		(void)level;
+#endif
+		return k;
+	}
+
+	//! Obtain the 16-bit weight kernels for the running CPU
+	//!
+	//! @return kernel dispatch table, selected on first use
+	template< typename Format >
+	const half_kernels< Format >&
+	half_dispatch( )
+	{
+		static const half_kernels< Format > kernels = half_select< Format >( simd_avx512 );
+		return kernels;
+	}
+
+	//! artificial neural network with 16-bit floating point weights
+	//!
+	//! @tparam Format   weight format, fp16_storage or bf16_storage
+	//! @tparam UnaryOp  output transform for a single output-layer unit
+	//!
+	//! Approximates evaluate_neural_network for float inputs and outputs.
+	//! Each unit's input weights are rounded to the 16-bit format, halving
+	//! their storage; biases remain float. Weights are widened to float
+	//! by the kernels as they are read, with F16C or AVX-512 conversion
+	//! instructions where available, and inner products are accumulated in
+	//! float.
+	//!
+	//! The rounding error of a weight is at most 2^-11 (fp16) or 2^-8
+	//! (bf16) of its magnitude, so the error of a unit's linear output
+	//! grows with the magnitude of its weights and inputs; fp16 weights
+	//! also overflow beyond 65504. Outputs are accurate to roughly 1E-3
+	//! (fp16) and 1E-2 (bf16) for typical models, well outside the
+	//! tolerance of the float evaluator.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	const gamboge::half_neural_network< gamboge::fp16_storage > hnet( in_count,
+	//! 		hidden_count, out_count, wts );
+	//! 	hnet.evaluate( nn_out, nn_in );
+	//! }
+	//! @endcode
+	template< typename Format, typename UnaryOp = logistic_output< float > >
+	class half_neural_network
+	{
+	public:
+		typedef float value_type;
+		typedef nnet_workspace< float > workspace_type;
+
+		//! constructor, rounds the network weights to the 16-bit format
+		//!
+		//! @param n        input count
+		//! @param m        hidden-layer count
+		//! @param k        output count
+		//! @param wts      start of weights sequence, see evaluate_neural_network
+		//! @param unaryop  output transform for a single output-layer unit
+		//! @param kernels  kernel dispatch table
+		template< typename InIterWt >
+		half_neural_network( std::size_t n, std::size_t m, std::size_t k, InIterWt wts,
+			UnaryOp unaryop = UnaryOp( ),
+			const half_kernels< Format >& kernels = half_dispatch< Format >( ) )
+		: input_count( n ),
+		  hidden_count( m ),
+		  output_count( k ),
+		  unaryop( unaryop ),
+		  kernels( kernels ),
+		  float_kernels( simd_select< float >( kernels.level ) )
+		{
+			std::size_t out_inputs = input_count;
+			if ( hidden_count > 0 )
+			{
+				wts = round_layer( wts, input_count, hidden_count, hidden_wts, hidden_bias );
+				out_inputs = hidden_count;
+			}
+			round_layer( wts, out_inputs, output_count, output_wts, output_bias );
+		}
+
+		//! Evaluate artificial neural network outputs
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return pointer marking end of result sequence
+		float* evaluate( float* result, const float* values ) const
+		{
+			return evaluate( result, values, _thread_workspace< float >() );
+		}
+
+		//! Evaluate artificial neural network outputs using a workspace
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		float* evaluate( float* result, const float* values, workspace_type& ws ) const
+		{
+			return evaluate_batch( result, values, 1, input_count, ws );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return pointer marking end of result sequence
+		float* evaluate_batch( float* result, const float* values, std::size_t nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, input_count,
+				_thread_workspace< float >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		//!
+		//! Rows are evaluated in blocks; the kernels apply each group of
+		//! units to all rows of a block while its weights are in cache.
+		float* evaluate_batch( float* result, const float* values, std::size_t nrows,
+			std::size_t stride, workspace_type& ws ) const
+		{
+			std::size_t nb = std::min( nrows,
+				_batch_block_rows< float >( input_count, hidden_count, output_count ) );
+			if ( nb == 0 )
+			{
+				return result;
+			}
+			float* unitsbuf = ws.reserve( nb * ( hidden_count + output_count ) );
+			if ( unitsbuf == 0 )
+			{
+				return result;
+			}
+			float* hidden_out = &(unitsbuf[0]);
+			float* linout = &(unitsbuf[nb*hidden_count]);
+
+			for ( std::size_t r0 = 0; r0 < nrows; r0 += nb )
+			{
+				std::size_t rows = std::min( nb, nrows - r0 );
+				const float* block = values + r0 * stride;
+
+				if ( hidden_count > 0 )
+				{
+					kernels.layer( &(hidden_wts[0]), &(hidden_bias[0]), block, stride, rows,
+						input_count, hidden_count, hidden_out, hidden_count );
+					float_kernels.logistic( hidden_out, rows * hidden_count );
+					kernels.layer( &(output_wts[0]), &(output_bias[0]), hidden_out, hidden_count,
+						rows, hidden_count, output_count, linout, output_count );
+				}
+				else  // hidden_count is 0
+				{
+					kernels.layer( &(output_wts[0]), &(output_bias[0]), block, stride, rows,
+						input_count, output_count, linout, output_count );
+				}
+
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					float* lo = &(linout[r*output_count]);
+					if ( output_count > 1 )
+					{
+						_softmax( lo, lo + output_count, lo );
+						result = std::copy( lo, lo + output_count, result );
+					}
+					else
+					{
+						result = std::transform( lo, lo + output_count, result, unaryop );
+					}
+				}
+			}
+			return result;
+		}
+
+		//! @return input count
+		std::size_t inputs( ) const
+		{
+			return input_count;
+		}
+
+		//! @return hidden-layer unit count
+		std::size_t hidden( ) const
+		{
+			return hidden_count;
+		}
+
+		//! @return output count
+		std::size_t outputs( ) const
+		{
+			return output_count;
+		}
+
+		//! @return bytes of 16-bit weights and float biases
+		std::size_t weight_bytes( ) const
+		{
+			return ( hidden_wts.size( ) + output_wts.size( ) ) * sizeof( uint16_t )
+				+ ( hidden_bias.size( ) + output_bias.size( ) ) * sizeof( float );
+		}
+
+	private:
+		// read a layer's weight blocks in evaluate_neural_network order,
+		// rounding the input weights and keeping the biases apart
+		template< typename InIterWt >
+		static InIterWt round_layer( InIterWt itw, std::size_t nin, std::size_t nunits,
+			std::vector< uint16_t >& w, std::vector< float >& bias )
+		{
+			w.assign( std::max( nunits * nin, std::size_t( 1 ) ), 0 );
+			bias.assign( std::max( nunits, std::size_t( 1 ) ), 0.0F );
+			for ( std::size_t u = 0; u < nunits; ++u )
+			{
+				bias[u] = static_cast< float >( *itw );
+				++itw;
+				for ( std::size_t k = 0; k < nin; ++k, ++itw )
+				{
+					w[ u*nin + k ] = _float_to_half( static_cast< float >( *itw ), Format( ) );
+				}
+			}
+			return itw;
+		}
+
+		std::size_t input_count;
+		std::size_t hidden_count;
+		std::size_t output_count;
+		std::vector< uint16_t > hidden_wts;
+		std::vector< float > hidden_bias;
+		std::vector< uint16_t > output_wts;
+		std::vector< float > output_bias;
+		UnaryOp unaryop;
+		half_kernels< Format > kernels;
+		simd_kernels< float > float_kernels;
+	};
+}
+
+#endif
@@ -0,0 +1,286 @@
+//! @file gamboge/incremental_nnet.h
+//! gamboge neural network re-evaluation after changes to a few inputs
+
+#ifndef _GAMBOGE_INCREMENTAL_NNET_H
+#define _GAMBOGE_INCREMENTAL_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+namespace gamboge
+{
+	//! neural network evaluator caching the state of a base input row
+	//!
+	//! @tparam T         value type of weights, inputs and outputs
+	//! @tparam UnaryOp   output transform, see neural_network
+	//! @tparam HiddenOp  transfer function for hidden-layer units
+	//!
+	//! Holds an input row together with the hidden-layer units' linear
+	//! outputs (their pre-activations) for that row and, with skip-layer
+	//! connections, the inputs' contributions to the output units. A
+	//! change to input @a k adds ( @a v - @a x_k ) times column @a k of the
+	//! hidden-layer weights to the pre-activations, O( @a nh ) work rather
+	//! than the O( @a nx * @a nh ) of a full evaluation; the hidden-layer
+	//! transfer function and the output layer are then recomputed. The
+	//! weights are copied at construction, the hidden-layer weights
+	//! transposed so that each input's column is contiguous.
+	//!
+	//! The cached sums are updated, not recomputed, so each update adds
+	//! rounding error; after many update() calls set_base() restores
+	//! results equal to evaluate_neural_network up to reassociation of
+	//! the sums. An evaluator may be used by one thread at a time.
+	//!
+	//! Example, the outputs for each input increased in turn by 10%
+	//! @code
+	//! {
+	//! 	gamboge::incremental_evaluator< double > eval( in_count, hidden_count,
+	//! 		out_count, &(wts[0]) );
+	//! 	eval.set_base( &(base_row[0]) );
+	//! 	for ( unsigned k = 0; k < in_count; ++k )
+	//! 	{
+	//! 		eval.evaluate_with( &(outputs[k*out_count]), k, 1.1 * base_row[k] );
+	//! 	}
+	//! }
+	//! @endcode
+	template< typename T, typename UnaryOp = logistic_output< T >,
+		typename HiddenOp = logistic_output< T > >
+	class incremental_evaluator
+	{
+	public:
+		typedef T value_type;
+
+		//! constructor, evaluator for a network
+		//!
+		//! @param n        input count
+		//! @param m        hidden-layer count
+		//! @param k        output count
+		//! @param wts      start of weights sequence, see evaluate_neural_network
+		//! @param unaryop  output transform for a single output-layer unit
+		//! @param hiddenop transfer function for hidden-layer units
+		//!
+		//! The base row is all zeros until set_base is called.
+		template< typename InIterWt >
+		incremental_evaluator( std::size_t n, std::size_t m, std::size_t k, InIterWt wts,
+			UnaryOp unaryop = UnaryOp( ), HiddenOp hiddenop = HiddenOp( ) )
+		: topo( n, m, k ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop )
+		{
+			assign( wts );
+		}
+
+		//! constructor, evaluator for a network topology
+		//!
+		//! @param topo     units, skip-layer connections and output transform
+		//! @param wts      start of weights sequence, R nnet$wts
+		//! @param unaryop  output transform, see neural_network
+		//! @param hiddenop transfer function for hidden-layer units
+		template< typename InIterWt >
+		incremental_evaluator( const nnet_topology& topo, InIterWt wts,
+			UnaryOp unaryop = UnaryOp( ), HiddenOp hiddenop = HiddenOp( ) )
+		: topo( topo ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop )
+		{
+			assign( wts );
+		}
+
+		//! Set the base input row, computing its cached state in full
+		//!
+		//! @param values   start of input value sequence
+		template< typename InIter >
+		void set_base( InIter values )
+		{
+			const std::size_t nx = topo.inputs;
+			for ( std::size_t k = 0; k < nx; ++k, ++values )
+			{
+				inputs[k] = *values;
+			}
+			hidden_pre = hidden_bias;
+			std::fill( skip_pre.begin( ), skip_pre.end( ), static_cast< T >( 0 ) );
+			for ( std::size_t k = 0; k < nx; ++k )
+			{
+				add_column( k, inputs[k], hidden_pre.data( ), skip_pre.data( ) );
+			}
+		}
+
+		//! Change one input of the base row
+		//!
+		//! @param k        input index
+		//! @param value    new value of input @p k
+		void update( std::size_t k, T value )
+		{
+			add_column( k, value - inputs[k], hidden_pre.data( ), skip_pre.data( ) );
+			inputs[k] = value;
+		}
+
+		//! Change several inputs of the base row
+		//!
+		//! @param indices  start of input index sequence
+		//! @param values   start of new value sequence, one per index
+		//! @param n        count of changed inputs
+		template< typename InIterIdx, typename InIter >
+		void update( InIterIdx indices, InIter values, std::size_t n )
+		{
+			for ( std::size_t j = 0; j < n; ++j, ++indices, ++values )
+			{
+				update( static_cast< std::size_t >( *indices ), static_cast< T >( *values ) );
+			}
+		}
+
+		//! Evaluate the outputs for the base row
+		//!
+		//! @param result   start of output sequence
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result )
+		{
+			return evaluate_state( result, hidden_pre.data( ), skip_pre.data( ) );
+		}
+
+		//! Evaluate the outputs for the base row with one input changed,
+		//! leaving the base row unchanged
+		//!
+		//! @param result   start of output sequence
+		//! @param k        input index
+		//! @param value    value of input @p k
+		//! @return pointer marking end of result sequence
+		T* evaluate_with( T* result, std::size_t k, T value )
+		{
+			T* pre = scratch.data( );
+			T* skip = pre + topo.hidden;
+			std::copy( hidden_pre.begin( ), hidden_pre.end( ), pre );
+			std::copy( skip_pre.begin( ), skip_pre.end( ), skip );
+			add_column( k, value - inputs[k], pre, skip );
+			return evaluate_state( result, pre, skip );
+		}
+
+		//! Evaluate the outputs for a sweep of one input over several
+		//! values, leaving the base row unchanged
+		//!
+		//! @param result   start of output matrix, @a ny values per sweep value
+		//! @param k        input index
+		//! @param values   start of sequence of values of input @p k
+		//! @param n        count of values
+		//! @return pointer marking end of result sequence
+		template< typename InIter >
+		T* sweep( T* result, std::size_t k, InIter values, std::size_t n )
+		{
+			for ( std::size_t j = 0; j < n; ++j, ++values )
+			{
+				result = evaluate_with( result, k, static_cast< T >( *values ) );
+			}
+			return result;
+		}
+
+		//! @return start of the base input row
+		const T* base( ) const
+		{
+			return inputs.data( );
+		}
+
+		//! @return network topology
+		const nnet_topology& topology( ) const
+		{
+			return topo;
+		}
+
+	private:
+		// copy the weights, transposing the input columns
+		template< typename InIterWt >
+		void assign( InIterWt itw )
+		{
+			const std::size_t nx = topo.inputs;
+			const std::size_t nh = topo.hidden;
+			const std::size_t ny = topo.outputs;
+			const bool skip = topo.skip_layer( );
+			hidden_bias.assign( nh, static_cast< T >( 0 ) );
+			hidden_cols.assign( nx * nh, static_cast< T >( 0 ) );
+			for ( std::size_t h = 0; h < nh; ++h )
+			{
+				hidden_bias[h] = *itw;
+				++itw;
+				for ( std::size_t k = 0; k < nx; ++k, ++itw )
+				{
+					hidden_cols[ k*nh + h ] = *itw;
+				}
+			}
+			output_wts.assign( ny * ( 1 + nh ), static_cast< T >( 0 ) );
+			skip_cols.assign( skip ? nx * ny : 0, static_cast< T >( 0 ) );
+			for ( std::size_t o = 0; o < ny; ++o )
+			{
+				for ( std::size_t j = 0; j < 1 + nh; ++j, ++itw )
+				{
+					output_wts[ o*(1+nh) + j ] = *itw;
+				}
+				for ( std::size_t k = 0; skip && k < nx; ++k, ++itw )
+				{
+					skip_cols[ k*ny + o ] = *itw;
+				}
+			}
+			inputs.assign( nx, static_cast< T >( 0 ) );
+			hidden_pre = hidden_bias;
+			skip_pre.assign( skip ? ny : 0, static_cast< T >( 0 ) );
+			scratch.assign( 2 * ( nh + ny ), static_cast< T >( 0 ) );
+		}
+
+		// add d times input k's weight columns to the cached sums
+		void add_column( std::size_t k, T d, T* pre, T* skip ) const
+		{
+			if ( d == static_cast< T >( 0 ) )
+			{
+				return;
+			}
+			const std::size_t nh = topo.hidden;
+			const T* col = hidden_cols.data( ) + k * nh;
+			for ( std::size_t h = 0; h < nh; ++h )
+			{
+				pre[h] += col[h] * d;
+			}
+			if ( !skip_cols.empty( ) )
+			{
+				const std::size_t ny = topo.outputs;
+				const T* scol = skip_cols.data( ) + k * ny;
+				for ( std::size_t o = 0; o < ny; ++o )
+				{
+					skip[o] += scol[o] * d;
+				}
+			}
+		}
+
+		// hidden-layer transfer function and output layer from cached sums
+		T* evaluate_state( T* result, const T* pre, const T* skip )
+		{
+			const std::size_t nh = topo.hidden;
+			const std::size_t ny = topo.outputs;
+			T* hidden_out = scratch.data( ) + nh + ny;
+			T* linout = hidden_out + nh;
+			for ( std::size_t h = 0; h < nh; ++h )
+			{
+				hidden_out[h] = hiddenop( pre[h] );
+			}
+			for ( std::size_t o = 0; o < ny; ++o )
+			{
+				const T* w = output_wts.data( ) + o * ( 1 + nh );
+				T lo = std::inner_product( w + 1, w + 1 + nh, hidden_out, w[0] );
+				linout[o] = skip_cols.empty( ) ? lo : lo + skip[o];
+			}
+			return _apply_output_mode( linout, ny, topo.mode, result, unaryop );
+		}
+
+		nnet_topology topo;
+		UnaryOp unaryop;
+		HiddenOp hiddenop;
+		std::vector< T > hidden_bias;
+		std::vector< T > hidden_cols;    // hidden-layer weights, input-major
+		std::vector< T > output_wts;     // output blocks without skip weights
+		std::vector< T > skip_cols;      // skip-layer weights, input-major
+		std::vector< T > inputs;         // base row
+		std::vector< T > hidden_pre;     // hidden-layer linear outputs
+		std::vector< T > skip_pre;       // inputs' contributions to outputs
+		std::vector< T > scratch;
+	};
+}
+
+#endif
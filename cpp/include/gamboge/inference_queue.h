@@ -0,0 +1,229 @@
+//! @file gamboge/inference_queue.h
+//! gamboge neural network request queue with dynamic micro-batching
+
+#ifndef _GAMBOGE_INFERENCE_QUEUE_H
+#define _GAMBOGE_INFERENCE_QUEUE_H 1
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gamboge
+{
+	//! single-row request queue evaluated in micro-batches
+	//!
+	//! @tparam Network  network type providing inputs, outputs and
+	//!                  evaluate_batch with a workspace argument, e.g.
+	//!                  neural_network or packed_neural_network
+	//!
+	//! Requests for one input row each, from any number of threads, are
+	//! queued with a copy of the row. A dispatcher thread waits for the
+	//! first queued request, then for either @a max_batch requests or the
+	//! first request's deadline, @a max_wait after it was queued, and
+	//! evaluates up to @a max_batch rows with one evaluate_batch call.
+	//! Each request is then completed with its outputs, in request order:
+	//! by a callback, called on the dispatcher thread, or through a future.
+	//!
+	//! Under light load a request waits up to @a max_wait for company;
+	//! under heavy load batches fill before the deadline and the per-row
+	//! cost falls to that of batched evaluation.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+	//! 	const nnet_type nnet( in_count, hidden_count, out_count, wts );
+	//! 	gamboge::inference_queue< nnet_type > queue( nnet, 64,
+	//! 		std::chrono::microseconds( 200 ) );
+	//!
+	//! 	// on each request thread
+	//! 	std::future< std::vector< float > > outputs = queue.submit( &(row[0]) );
+	//! 	float p = outputs.get( )[0];
+	//! }
+	//! @endcode
+	template< typename Network >
+	class inference_queue
+	{
+	public:
+		typedef typename Network::value_type value_type;
+		typedef typename Network::workspace_type workspace_type;
+
+		//! called with the start of a request's outputs, or 0 if the
+		//! evaluation failed for want of workspace; the outputs are valid
+		//! only for the duration of the call
+		typedef std::function< void( const value_type* ) > completion;
+
+		//! constructor, starts the dispatcher thread
+		//!
+		//! @param nnet       network to evaluate, must outlive the queue
+		//! @param max_batch  most rows evaluated in one batch
+		//! @param max_wait   longest time a request waits for a batch to fill
+		inference_queue( const Network& nnet, std::size_t max_batch = 64,
+			std::chrono::microseconds max_wait = std::chrono::microseconds( 200 ) )
+		: nnet( nnet ),
+		  nx( nnet.inputs( ) ),
+		  ny( nnet.outputs( ) ),
+		  max_batch( std::max( std::size_t( 1 ), max_batch ) ),
+		  max_wait( max_wait ),
+		  stopping( false ),
+		  batch_count( 0 ),
+		  request_count( 0 )
+		{
+			dispatcher = std::thread( &inference_queue::dispatch_loop, this );
+		}
+
+		//! destructor, completes queued requests and stops the dispatcher
+		~inference_queue( )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				stopping = true;
+			}
+			ready_cv.notify_one( );
+			dispatcher.join( );
+		}
+
+		//! Queue a request completed by a callback
+		//!
+		//! @param values   start of input value sequence, copied before return
+		//! @param done     completion, called on the dispatcher thread
+		template< typename InIter >
+		void submit( InIter values, completion done )
+		{
+			bool wake;
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				for ( std::size_t k = 0; k < nx; ++k, ++values )
+				{
+					pending_rows.push_back( *values );
+				}
+				pending.push_back( request( std::move( done ), std::chrono::steady_clock::now( ) ) );
+				// the dispatcher waits for a first request, then for a full batch
+				wake = ( pending.size( ) == 1 || pending.size( ) == max_batch );
+			}
+			if ( wake )
+			{
+				ready_cv.notify_one( );
+			}
+		}
+
+		//! Queue a request completed through a future
+		//!
+		//! @param values   start of input value sequence, copied before return
+		//! @return future outputs, empty if the evaluation failed
+		template< typename InIter >
+		std::future< std::vector< value_type > > submit( InIter values )
+		{
+			std::shared_ptr< std::promise< std::vector< value_type > > > promise(
+				new std::promise< std::vector< value_type > >( ) );
+			std::future< std::vector< value_type > > result = promise->get_future( );
+			const std::size_t n = ny;
+			submit( values, [promise, n]( const value_type* outputs )
+				{
+					promise->set_value( outputs != 0
+						? std::vector< value_type >( outputs, outputs + n )
+						: std::vector< value_type >( ) );
+				} );
+			return result;
+		}
+
+		//! @return count of batches dispatched
+		std::size_t batches( ) const
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			return batch_count;
+		}
+
+		//! @return count of requests dispatched in batches
+		std::size_t requests( ) const
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			return request_count;
+		}
+
+	private:
+		struct request
+		{
+			request( completion done, std::chrono::steady_clock::time_point queued )
+			: done( std::move( done ) ),
+			  queued( queued )
+			{
+			}
+
+			completion done;
+			std::chrono::steady_clock::time_point queued;
+		};
+
+		void dispatch_loop( )
+		{
+			workspace_type ws;
+			std::vector< value_type > rows;
+			std::vector< value_type > outputs( max_batch * ny );
+			std::vector< completion > batch;
+			for ( ;; )
+			{
+				std::size_t n;
+				{
+					std::unique_lock< std::mutex > lock( mutex );
+					ready_cv.wait( lock, [this] { return stopping || !pending.empty( ); } );
+					if ( pending.empty( ) )
+					{
+						return;
+					}
+					const std::chrono::steady_clock::time_point deadline =
+						pending.front( ).queued + max_wait;
+					ready_cv.wait_until( lock, deadline,
+						[this] { return stopping || pending.size( ) >= max_batch; } );
+
+					n = std::min( pending.size( ), max_batch );
+					rows.assign( pending_rows.begin( ), pending_rows.begin( ) + n * nx );
+					pending_rows.erase( pending_rows.begin( ), pending_rows.begin( ) + n * nx );
+					for ( std::size_t k = 0; k < n; ++k )
+					{
+						batch.push_back( std::move( pending.front( ).done ) );
+						pending.pop_front( );
+					}
+					++batch_count;
+					request_count += n;
+				}
+
+				const value_type* first = rows.empty( ) ? 0 : &(rows[0]);
+				value_type* last = nnet.evaluate_batch( &(outputs[0]), first, n, nx, ws );
+				const bool ok = ( last == &(outputs[0]) + n * ny );
+				for ( std::size_t k = 0; k < n; ++k )
+				{
+					batch[k]( ok ? &(outputs[k*ny]) : 0 );
+				}
+				batch.clear( );
+			}
+		}
+
+		// not copyable
+		inference_queue( const inference_queue& );
+		inference_queue& operator=( const inference_queue& );
+
+		const Network& nnet;
+		const std::size_t nx;
+		const std::size_t ny;
+		const std::size_t max_batch;
+		const std::chrono::microseconds max_wait;
+		mutable std::mutex mutex;
+		std::condition_variable ready_cv;
+		std::deque< value_type > pending_rows;
+		std::deque< request > pending;
+		bool stopping;
+		std::size_t batch_count;
+		std::size_t request_count;
+		std::thread dispatcher;
+	};
+}
+
+#endif
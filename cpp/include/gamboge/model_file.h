@@ -0,0 +1,495 @@
+//! @file gamboge/model_file.h
+//! gamboge neural network binary model file format
+
+#ifndef _GAMBOGE_MODEL_FILE_H
+#define _GAMBOGE_MODEL_FILE_H 1
+
+#include "gamboge/nnet.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define GAMBOGE_NNET_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <vector>
+#endif
+
+namespace gamboge
+{
+	//! model file format version written by this library
+	const uint16_t model_file_version = 1;
+
+	//! alignment of the weights within a model file
+	const uint32_t model_file_alignment = 64;
+
+	//! model file weight element types
+	enum model_element_type
+	{
+		model_element_float = 1,    //!< IEEE 754 binary32
+		model_element_double = 2    //!< IEEE 754 binary64
+	};
+
+	//! model file output transforms
+	enum model_output_transform
+	{
+		model_output_logistic = 0,  //!< logistic output units
+		model_output_linear = 1,    //!< linear output units
+		model_output_softmax = 2    //!< softmax over output units
+	};
+
+	//! model file header flags
+	enum model_file_flags
+	{
+		model_flag_skip_layer = 1   //!< skip-layer connections from the inputs
+		                            //!< to the output units, see nnet_topology
+	};
+
+	//! model file status codes
+	enum model_status
+	{
+		model_ok = 0,               //!< success
+		model_open_failed,          //!< file could not be opened or mapped
+		model_write_failed,         //!< file could not be written
+		model_bad_magic,            //!< not a model file
+		model_bad_version,          //!< unsupported format version
+		model_bad_header,           //!< inconsistent topology or layout
+		model_truncated,            //!< file ends before the weights
+		model_bad_checksum          //!< weights do not match the checksum
+	};
+
+	//! model file header
+	//!
+	//! A model file is this 64 byte header followed, at @a weights_offset,
+	//! by @a weight_count weights in the evaluate_neural_network order (the
+	//! order of R nnet$wts). All values are little-endian.
+	struct model_file_header
+	{
+		char magic[4];              //!< "GNNM"
+		uint16_t version;           //!< format version, model_file_version
+		uint16_t header_size;       //!< bytes in the header, 64
+		uint8_t element_type;       //!< model_element_type of the weights
+		uint8_t output_transform;   //!< model_output_transform
+		uint16_t flags;             //!< model_file_flags
+		uint32_t input_count;       //!< nx
+		uint32_t hidden_count;      //!< nh
+		uint32_t output_count;      //!< ny
+		uint32_t weight_count;      //!< number of weights
+		uint32_t checksum;          //!< Adler-32 of the weight bytes
+		uint32_t weights_offset;    //!< weights position in the file, a
+		                            //!< multiple of model_file_alignment
+		uint8_t reserved[28];       //!< reserved, 0
+	};
+
+	static_assert( sizeof( model_file_header ) == 64, "model file header layout" );
+
+	//! @cond
+	inline uint32_t
+	_adler32( const unsigned char* p, std::size_t n )
+	{
+		const uint32_t mod = 65521;
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while ( n > 0 )
+		{
+			// largest block before b can overflow 32 bits
+			std::size_t block = ( n < 5552 ) ? n : 5552;
+			n -= block;
+			while ( block-- > 0 )
+			{
+				a += *p++;
+				b += a;
+			}
+			a %= mod;
+			b %= mod;
+		}
+		return ( b << 16 ) | a;
+	}
+
+	inline bool
+	_host_little_endian( )
+	{
+		const uint16_t probe = 1;
+		return *reinterpret_cast< const unsigned char* >( &probe ) == 1;
+	}
+
+	template< typename T >
+	struct _model_element;
+
+	template< >
+	struct _model_element< float >
+	{
+		static const uint8_t type = model_element_float;
+	};
+
+	template< >
+	struct _model_element< double >
+	{
+		static const uint8_t type = model_element_double;
+	};
+
+	//! weight count of a topology, as nnet_topology::weight_count, computed
+	//! in 64 bits; false if the topology has no inputs or no outputs or
+	//! the count does not fit the header's 32 bits
+	inline bool
+	_model_weight_count( uint32_t nx, uint32_t nh, uint32_t ny, bool skip, uint32_t& count )
+	{
+		if ( nx == 0 || ny == 0 )
+		{
+			return false;
+		}
+		const uint64_t limit = 0xFFFFFFFFULL;
+		const uint64_t hidden_wts = static_cast< uint64_t >( nh ) * ( 1 + static_cast< uint64_t >( nx ) );
+		const uint64_t fan_in = 1 + static_cast< uint64_t >( nh )
+			+ ( ( skip || nh == 0 ) ? static_cast< uint64_t >( nx ) : 0 );
+		if ( hidden_wts > limit || fan_in > ( limit - hidden_wts ) / ny )
+		{
+			return false;
+		}
+		count = static_cast< uint32_t >( hidden_wts + ny * fan_in );
+		return true;
+	}
+
+	inline output_mode
+	_model_output_mode( uint8_t transform )
+	{
+		return ( transform == model_output_linear ) ? output_linear
+			: ( transform == model_output_softmax ) ? output_softmax : output_logistic;
+	}
+
+	inline model_output_transform
+	_model_output_transform( const nnet_topology& topo )
+	{
+		return ( topo.mode == output_linear ) ? model_output_linear
+			: ( topo.mode == output_softmax || ( topo.mode == output_default && topo.outputs > 1 ) )
+				? model_output_softmax : model_output_logistic;
+	}
+	//! @endcond
+
+	//! Write a model file
+	//!
+	//! @param path       file name
+	//! @param nx         input count
+	//! @param nh         hidden-layer count
+	//! @param ny         output count
+	//! @param wts        start of weights, see evaluate_neural_network
+	//! @param transform  output transform
+	//! @return model_ok or model_write_failed
+	template< typename T >
+	model_status
+	write_model_file( const char* path, uint32_t nx, uint32_t nh, uint32_t ny,
+		const T* wts, model_output_transform transform = model_output_logistic )
+	{
+		return write_model_file( path,
+			nnet_topology( nx, nh, ny, _model_output_mode( transform ) ), wts );
+	}
+
+	//! Write a model file for a topology
+	//!
+	//! @param path       file name
+	//! @param topo       network topology, including skip-layer connections
+	//!                   and the output transform
+	//! @param wts        start of weights, R nnet$wts
+	//! @return model_ok or model_write_failed; a topology without inputs
+	//!         or outputs is not written
+	template< typename T >
+	model_status
+	write_model_file( const char* path, const nnet_topology& topo, const T* wts )
+	{
+		if ( !_host_little_endian( ) )
+		{
+			return model_write_failed;
+		}
+		const uint32_t nx = static_cast< uint32_t >( topo.inputs );
+		const uint32_t nh = static_cast< uint32_t >( topo.hidden );
+		const uint32_t ny = static_cast< uint32_t >( topo.outputs );
+		const bool skip = topo.skip && nh > 0;
+		uint32_t nw = 0;
+		if ( !_model_weight_count( nx, nh, ny, skip, nw ) )
+		{
+			return model_write_failed;
+		}
+
+		model_file_header hdr;
+		std::memset( &hdr, 0, sizeof( hdr ) );
+		std::memcpy( hdr.magic, "GNNM", 4 );
+		hdr.version = model_file_version;
+		hdr.header_size = sizeof( hdr );
+		hdr.element_type = _model_element< T >::type;
+		hdr.output_transform = static_cast< uint8_t >( _model_output_transform( topo ) );
+		hdr.flags = skip ? model_flag_skip_layer : 0;
+		hdr.input_count = nx;
+		hdr.hidden_count = nh;
+		hdr.output_count = ny;
+		hdr.weight_count = nw;
+		hdr.checksum = _adler32( reinterpret_cast< const unsigned char* >( wts ), nw * sizeof( T ) );
+		hdr.weights_offset = model_file_alignment;
+
+		std::FILE* f = std::fopen( path, "wb" );
+		if ( f == 0 )
+		{
+			return model_write_failed;
+		}
+		const char padding[ model_file_alignment ] = { 0 };
+		bool ok = std::fwrite( &hdr, sizeof( hdr ), 1, f ) == 1
+			&& std::fwrite( padding, 1, hdr.weights_offset - sizeof( hdr ), f )
+				== hdr.weights_offset - sizeof( hdr )
+			&& std::fwrite( wts, sizeof( T ), nw, f ) == nw;
+		ok = ( std::fclose( f ) == 0 ) && ok;
+		return ok ? model_ok : model_write_failed;
+	}
+
+	//! model file mapped into memory
+	//!
+	//! The weights of an opened model are used in place, from the mapped
+	//! file, so loading a model does not parse or copy the weights. The
+	//! networks obtained from a mapped_model refer to the mapping and must
+	//! not be used after it is closed or destroyed.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	gamboge::mapped_model model;
+	//! 	if ( model.open( "iris.gnnm" ) == gamboge::model_ok )
+	//! 	{
+	//! 		gamboge::neural_network< const float*, const float*, float*, unsigned >
+	//! 			nnet = model.network< float >( );
+	//! 		nnet.evaluate( nn_out, nn_in );
+	//! 	}
+	//! }
+	//! @endcode
+	class mapped_model
+	{
+	public:
+		mapped_model( )
+		: base( 0 ),
+		  length( 0 )
+		{
+			std::memset( &hdr, 0, sizeof( hdr ) );
+		}
+
+		~mapped_model( )
+		{
+			close( );
+		}
+
+		//! Open and validate a model file
+		//!
+		//! @param path             file name
+		//! @param verify_checksum  verify the weights against the checksum,
+		//!                         reading every weight once
+		//! @return model_ok, or the reason the file was rejected
+		model_status open( const char* path, bool verify_checksum = true )
+		{
+			close( );
+			if ( !_host_little_endian( ) || !map( path ) )
+			{
+				return model_open_failed;
+			}
+			model_status status = validate( verify_checksum );
+			if ( status != model_ok )
+			{
+				close( );
+			}
+			return status;
+		}
+
+		//! Release the mapping
+		void close( )
+		{
+			if ( base != 0 )
+			{
+#ifdef GAMBOGE_NNET_MMAP
+				munmap( base, length );
+#endif
+				base = 0;
+				length = 0;
+			}
+#ifndef GAMBOGE_NNET_MMAP
+			std::vector< char >( ).swap( contents );
+#endif
+			std::memset( &hdr, 0, sizeof( hdr ) );
+		}
+
+		//! @return whether a model is open
+		bool is_open( ) const
+		{
+			return base != 0;
+		}
+
+		//! @return header of the open model
+		const model_file_header& header( ) const
+		{
+			return hdr;
+		}
+
+		//! @return start of the weights, or 0 if no model is open or its
+		//!         element type is not @p T
+		template< typename T >
+		const T* weights( ) const
+		{
+			if ( base == 0 || hdr.element_type != _model_element< T >::type )
+			{
+				return 0;
+			}
+			return reinterpret_cast< const T* >(
+				static_cast< const char* >( base ) + hdr.weights_offset );
+		}
+
+		//! @return topology of the open model, with the skip-layer
+		//!         connections and output transform recorded in the file
+		nnet_topology topology( ) const
+		{
+			return nnet_topology( hdr.input_count, hdr.hidden_count, hdr.output_count,
+				_model_output_mode( hdr.output_transform ),
+				( hdr.flags & model_flag_skip_layer ) != 0 );
+		}
+
+		//! @return network evaluating the open model in place, with the
+		//!         model's topology()
+		//!
+		//! The model must be open with weights of type @p T, see weights();
+		//! otherwise the network would read through a null pointer, which
+		//! is asserted. Use the checked overload when the element type of
+		//! the file is not known.
+		template< typename T >
+		neural_network< const T*, const T*, T*, unsigned > network( ) const
+		{
+			assert( weights< T >() != 0 );
+			return neural_network< const T*, const T*, T*, unsigned >( topology( ),
+				weights< T >() );
+		}
+
+		//! Build a network evaluating the open model in place
+		//!
+		//! @param nnet     receives the network, with the model's topology()
+		//! @return false, leaving @p nnet unchanged, unless a model is open
+		//!         with weights of type @p T
+		template< typename T >
+		bool network( neural_network< const T*, const T*, T*, unsigned >& nnet ) const
+		{
+			if ( weights< T >() == 0 )
+			{
+				return false;
+			}
+			nnet = neural_network< const T*, const T*, T*, unsigned >( topology( ), weights< T >() );
+			return true;
+		}
+
+	private:
+		// not copyable
+		mapped_model( const mapped_model& );
+		mapped_model& operator=( const mapped_model& );
+
+		bool map( const char* path )
+		{
+#ifdef GAMBOGE_NNET_MMAP
+			int fd = ::open( path, O_RDONLY );
+			if ( fd < 0 )
+			{
+				return false;
+			}
+			struct stat st;
+			if ( fstat( fd, &st ) != 0 || st.st_size <= 0 )
+			{
+				::close( fd );
+				return false;
+			}
+			length = static_cast< std::size_t >( st.st_size );
+			void* p = mmap( 0, length, PROT_READ, MAP_SHARED, fd, 0 );
+			::close( fd );
+			if ( p == MAP_FAILED )
+			{
+				length = 0;
+				return false;
+			}
+			base = p;
+			return true;
+#else
+			std::FILE* f = std::fopen( path, "rb" );
+			if ( f == 0 )
+			{
+				return false;
+			}
+			char chunk[ 65536 ];
+			std::size_t n;
+			while ( ( n = std::fread( chunk, 1, sizeof( chunk ), f ) ) > 0 )
+			{
+				contents.insert( contents.end( ), chunk, chunk + n );
+			}
+			std::fclose( f );
+			if ( contents.empty( ) )
+			{
+				return false;
+			}
+			base = &(contents[0]);
+			length = contents.size( );
+			return true;
+#endif
+		}
+
+		model_status validate( bool verify_checksum )
+		{
+			if ( length < sizeof( hdr ) )
+			{
+				return model_truncated;
+			}
+			std::memcpy( &hdr, base, sizeof( hdr ) );
+			if ( std::memcmp( hdr.magic, "GNNM", 4 ) != 0 )
+			{
+				return model_bad_magic;
+			}
+			if ( hdr.version != model_file_version )
+			{
+				return model_bad_version;
+			}
+			uint32_t weight_count = 0;
+			const bool count_fits = _model_weight_count( hdr.input_count, hdr.hidden_count,
+				hdr.output_count, ( hdr.flags & model_flag_skip_layer ) != 0, weight_count );
+			std::size_t elem_size = 0;
+			if ( hdr.element_type == model_element_float )
+			{
+				elem_size = sizeof( float );
+			}
+			else if ( hdr.element_type == model_element_double )
+			{
+				elem_size = sizeof( double );
+			}
+			if ( elem_size == 0 || hdr.header_size < sizeof( hdr )
+				|| hdr.output_transform > model_output_softmax
+				|| ( hdr.flags & ~model_flag_skip_layer ) != 0
+				|| hdr.weights_offset < hdr.header_size
+				|| hdr.weights_offset % model_file_alignment != 0
+				|| !count_fits || hdr.weight_count != weight_count )
+			{
+				return model_bad_header;
+			}
+			const uint64_t weight_bytes = static_cast< uint64_t >( hdr.weight_count ) * elem_size;
+			if ( length < hdr.weights_offset || length - hdr.weights_offset < weight_bytes )
+			{
+				return model_truncated;
+			}
+			if ( verify_checksum && _adler32( static_cast< const unsigned char* >( base )
+				+ hdr.weights_offset, static_cast< std::size_t >( weight_bytes ) ) != hdr.checksum )
+			{
+				return model_bad_checksum;
+			}
+			return model_ok;
+		}
+
+		void* base;
+		std::size_t length;
+		model_file_header hdr;
+#ifndef GAMBOGE_NNET_MMAP
+		std::vector< char > contents;
+#endif
+	};
+}
+
+#endif
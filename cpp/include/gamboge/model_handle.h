@@ -0,0 +1,418 @@
+//! @file gamboge/model_handle.h
+//! gamboge neural network replaceable under concurrent evaluation
+
+#ifndef _GAMBOGE_MODEL_HANDLE_H
+#define _GAMBOGE_MODEL_HANDLE_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+
+namespace gamboge
+{
+	//! network published as immutable snapshots, replaceable while other
+	//! threads evaluate it
+	//!
+	//! @tparam Network  copyable network type providing value_type,
+	//!                  evaluate and evaluate_batch, e.g. neural_network
+	//!
+	//! A snapshot is a network together with an optional owner of the
+	//! storage it reads, e.g. the weights vector or the mapped_model. The
+	//! current snapshot is held by an atomic pointer. publish() swaps in a
+	//! new snapshot and retires the old one, which is destroyed, with its
+	//! owner, once no evaluation that may have started on it is still in
+	//! flight.
+	//!
+	//! Reclamation is epoch based. An evaluating thread claims a reader
+	//! record, announces the current epoch in it and then loads the
+	//! snapshot pointer; publish() advances the epoch after the swap and
+	//! tags the retired snapshot with the new epoch, which may be freed
+	//! when every announced epoch has reached the tag. Readers never lock
+	//! or wait; a reader record is allocated only when more threads than
+	//! ever before evaluate at once. Publishers are serialized by a mutex
+	//! and free what they can, reclaim() frees the rest later.
+	//!
+	//! Example, weights replaced after retraining
+	//! @code
+	//! {
+	//! 	typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+	//! 	gamboge::model_handle< nnet_type > model;
+	//!
+	//! 	std::unique_ptr< gamboge::mapped_model > file( new gamboge::mapped_model );
+	//! 	if ( file->open( "iris.gnnm" ) == gamboge::model_ok )
+	//! 	{
+	//! 		nnet_type nnet = file->network< float >( );
+	//! 		model.publish( nnet, std::move( file ) );
+	//! 	}
+	//!
+	//! 	// on each scoring thread
+	//! 	model.evaluate( &(nn_out[0]), &(nn_in[0]) );
+	//! }
+	//! @endcode
+	template< typename Network >
+	class model_handle
+	{
+		struct snapshot;
+		struct reader_record;
+
+	public:
+		typedef typename Network::value_type value_type;
+
+		//! evaluation access to one snapshot, which is not freed while the
+		//! pin exists; movable, not copyable
+		class pin
+		{
+		public:
+			pin( pin&& other )
+			: record( other.record ),
+			  snap( other.snap )
+			{
+				other.record = 0;
+				other.snap = 0;
+			}
+
+			~pin( )
+			{
+				if ( record != 0 )
+				{
+					record->epoch.store( 0 );
+					record->claimed.store( false, std::memory_order_release );
+				}
+			}
+
+			//! @return whether a snapshot has been published
+			explicit operator bool( ) const
+			{
+				return snap != 0;
+			}
+
+			const Network& operator*( ) const
+			{
+				return snap->nnet;
+			}
+
+			const Network* operator->( ) const
+			{
+				return &(snap->nnet);
+			}
+
+			//! @return publication number of the snapshot, counting from 1;
+			//!         0 if none has been published
+			uint64_t version( ) const
+			{
+				return snap != 0 ? snap->version : 0;
+			}
+
+		private:
+			friend class model_handle;
+
+			pin( reader_record* record, const snapshot* snap )
+			: record( record ),
+			  snap( snap )
+			{
+			}
+
+			pin( const pin& );
+			pin& operator=( const pin& );
+
+			reader_record* record;
+			const snapshot* snap;
+		};
+
+		//! constructor, no snapshot published
+		model_handle( )
+		: current( 0 ),
+		  epoch( 1 ),
+		  readers( 0 ),
+		  retired( 0 ),
+		  retired_count( 0 ),
+		  published( 0 )
+		{
+		}
+
+		//! destructor, frees every snapshot; no evaluation may be in flight
+		~model_handle( )
+		{
+			delete current.load( );
+			while ( retired != 0 )
+			{
+				snapshot* s = retired;
+				retired = s->next;
+				delete s;
+			}
+			reader_record* r = readers.load( );
+			while ( r != 0 )
+			{
+				reader_record* next = r->next;
+				delete r;
+				r = next;
+			}
+		}
+
+		//! Replace the current snapshot
+		//!
+		//! @param nnet     network
+		//! @param owner    storage read by @p nnet, destroyed with the snapshot
+		//! @return false if the snapshot could not be allocated, the current
+		//!         snapshot is unchanged and @p owner is destroyed
+		template< typename Owner >
+		bool publish( const Network& nnet, std::unique_ptr< Owner > owner )
+		{
+			snapshot* s = new (std::nothrow) snapshot( nnet );
+			if ( s == 0 )
+			{
+				return false;
+			}
+			if ( owner )
+			{
+				s->owner = new (std::nothrow) holder< Owner >( std::move( owner ) );
+				if ( s->owner == 0 )
+				{
+					delete s;
+					return false;
+				}
+			}
+			std::lock_guard< std::mutex > lock( publish_mutex );
+			s->version = ++published;
+			snapshot* old = current.exchange( s );
+			if ( old != 0 )
+			{
+				old->retired_epoch = epoch.fetch_add( 1 ) + 1;
+				old->next = retired;
+				retired = old;
+				++retired_count;
+			}
+			reclaim_locked( );
+			return true;
+		}
+
+		//! Replace the current snapshot with a network whose storage the
+		//! caller keeps alive until reclaim() no longer reports it retired
+		//!
+		//! @param nnet     network
+		//! @return false if the snapshot could not be allocated
+		bool publish( const Network& nnet )
+		{
+			return publish( nnet, std::unique_ptr< Network >( ) );
+		}
+
+		//! Free retired snapshots no longer in use
+		//!
+		//! @return count of retired snapshots still in use
+		std::size_t reclaim( )
+		{
+			std::lock_guard< std::mutex > lock( publish_mutex );
+			reclaim_locked( );
+			return retired_count;
+		}
+
+		//! Pin the current snapshot for evaluation; does not lock or wait
+		//!
+		//! @return pin, empty if nothing has been published
+		pin acquire( ) const
+		{
+			reader_record* r = claim_record( );
+			r->epoch.store( epoch.load( ) );
+			return pin( r, current.load( ) );
+		}
+
+		//! Evaluate artificial neural network outputs with the current
+		//! snapshot
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return as Network::evaluate, or @p result if nothing has been
+		//!         published
+		template< typename OutIter, typename InIter >
+		OutIter evaluate( OutIter result, InIter values ) const
+		{
+			pin p = acquire( );
+			return p ? p->evaluate( result, values ) : result;
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//! with the current snapshot
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    row count
+		//! @return as Network::evaluate_batch, or @p result if nothing has
+		//!         been published
+		template< typename OutIter, typename InIter, typename Size >
+		OutIter evaluate_batch( OutIter result, InIter values, Size nrows ) const
+		{
+			pin p = acquire( );
+			return p ? p->evaluate_batch( result, values, nrows ) : result;
+		}
+
+		//! @return publication number of the current snapshot, 0 if none
+		uint64_t version( ) const
+		{
+			return acquire( ).version( );
+		}
+
+	private:
+		struct holder_base
+		{
+			virtual ~holder_base( )
+			{
+			}
+		};
+
+		template< typename Owner >
+		struct holder : holder_base
+		{
+			holder( std::unique_ptr< Owner > owner )
+			: owner( std::move( owner ) )
+			{
+			}
+
+			std::unique_ptr< Owner > owner;
+		};
+
+		struct snapshot
+		{
+			snapshot( const Network& nnet )
+			: nnet( nnet ),
+			  owner( 0 ),
+			  version( 0 ),
+			  retired_epoch( 0 ),
+			  next( 0 )
+			{
+			}
+
+			~snapshot( )
+			{
+				delete owner;
+			}
+
+			const Network nnet;
+			holder_base* owner;
+			uint64_t version;
+			uint64_t retired_epoch;
+			snapshot* next;         // retired list link
+		};
+
+		// claimed by one evaluation at a time; epoch is the epoch announced
+		// by the evaluation, 0 when quiescent; one per cache line
+		struct alignas( 64 ) reader_record
+		{
+			reader_record( )
+			: claimed( true ),
+			  epoch( 0 ),
+			  next( 0 )
+			{
+			}
+
+			// new before C++17 does not honor the alignment: over-allocate
+			// and keep the allocated address just below the record
+			static void* operator new( std::size_t n, const std::nothrow_t& ) throw( )
+			{
+				const std::size_t align = alignof( reader_record );
+				char* raw = static_cast< char* >( ::operator new( n + align + sizeof( void* ),
+					std::nothrow ) );
+				if ( raw == 0 )
+				{
+					return 0;
+				}
+				const std::size_t start = reinterpret_cast< std::size_t >( raw ) + sizeof( void* );
+				void** p = reinterpret_cast< void** >( start + ( align - start % align ) % align );
+				p[-1] = raw;
+				return p;
+			}
+
+			static void operator delete( void* p, const std::nothrow_t& ) throw( )
+			{
+				operator delete( p );
+			}
+
+			static void operator delete( void* p )
+			{
+				if ( p != 0 )
+				{
+					::operator delete( static_cast< void** >( p )[-1] );
+				}
+			}
+
+			std::atomic< bool > claimed;
+			std::atomic< uint64_t > epoch;
+			reader_record* next;
+		};
+
+		// claim a free reader record, adding one if all are claimed
+		reader_record* claim_record( ) const
+		{
+			for ( ;; )
+			{
+				for ( reader_record* r = readers.load( std::memory_order_acquire ); r != 0; r = r->next )
+				{
+					bool expected = false;
+					if ( !r->claimed.load( std::memory_order_relaxed )
+						&& r->claimed.compare_exchange_strong( expected, true, std::memory_order_acquire ) )
+					{
+						return r;
+					}
+				}
+				reader_record* r = new (std::nothrow) reader_record( );
+				if ( r != 0 )
+				{
+					r->next = readers.load( std::memory_order_relaxed );
+					while ( !readers.compare_exchange_weak( r->next, r, std::memory_order_release ) )
+					{
+					}
+					return r;
+				}
+				// out of memory; a claimed record is released when its
+				// evaluation completes
+			}
+		}
+
+		// free retired snapshots tagged with an epoch every reader has
+		// reached; a reader announcing an earlier epoch may have loaded
+		// the pointer before it was swapped out
+		void reclaim_locked( )
+		{
+			uint64_t oldest = epoch.load( );
+			for ( reader_record* r = readers.load( ); r != 0; r = r->next )
+			{
+				const uint64_t e = r->epoch.load( );
+				if ( e != 0 && e < oldest )
+				{
+					oldest = e;
+				}
+			}
+			snapshot** link = &retired;
+			while ( *link != 0 )
+			{
+				snapshot* s = *link;
+				if ( s->retired_epoch <= oldest )
+				{
+					*link = s->next;
+					delete s;
+					--retired_count;
+				}
+				else
+				{
+					link = &(s->next);
+				}
+			}
+		}
+
+		// not copyable
+		model_handle( const model_handle& );
+		model_handle& operator=( const model_handle& );
+
+		std::atomic< snapshot* > current;
+		std::atomic< uint64_t > epoch;
+		mutable std::atomic< reader_record* > readers;
+		std::mutex publish_mutex;
+		snapshot* retired;
+		std::size_t retired_count;
+		uint64_t published;
+	};
+}
+
+#endif
@@ -9,10 +9,29 @@
 #include <iterator>
 #include <numeric>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <new>
+#include <stdint.h>
+
+#ifdef GAMBOGE_NNET_STATS
+#include "gamboge/nnet_stats.h"
+#define _GAMBOGE_NNET_STATS_TIMER( entry, rows ) \
+	gamboge::_stats_timer _gamboge_stats_timer( gamboge::_stats_current( entry ), rows )
+#define _GAMBOGE_NNET_STATS_ALLOC_FAILURE( entry ) \
+	gamboge::_stats_current( entry ).record_alloc_failure( )
+#define _GAMBOGE_NNET_STATS_MODEL( stats ) \
+	gamboge::_stats_model_scope _gamboge_stats_model( stats )
+#else
+#define _GAMBOGE_NNET_STATS_TIMER( entry, rows )
+#define _GAMBOGE_NNET_STATS_ALLOC_FAILURE( entry )
+#define _GAMBOGE_NNET_STATS_MODEL( stats )
+#endif
 
 namespace gamboge
 {
+	class nnet_stats;
+
 	//! linear transfer functor
 	//!
 	//! @par the identity function:
@@ -41,6 +60,151 @@ namespace gamboge
 		}
 	};
 
+	//! @cond
+	//! exponent bits and polynomial for _fast_exp
+	template< typename T >
+	struct _fast_exp_traits;
+
+	template< >
+	struct _fast_exp_traits< float >
+	{
+		// arguments are clamped so that 2^n is a normal number
+		static float lower( ) { return -87.0F; }
+		static float upper( ) { return 88.0F; }
+		// adding and subtracting 1.5 * 2^23 rounds to an integer
+		static float round_bias( ) { return 12582912.0F; }
+
+		static float pow2( int n )
+		{
+			uint32_t bits = static_cast< uint32_t >( n + 127 ) << 23;
+			float v;
+			std::memcpy( &v, &bits, sizeof( v ) );
+			return v;
+		}
+
+		// Taylor polynomial of degree 6 for e^r, |r| <= ln(2)/2
+		static float poly( float r )
+		{
+			return 1.0F + r * ( 1.0F + r * ( 0.5F + r * ( 1.6666667e-1F + r * ( 4.1666668e-2F
+				+ r * ( 8.3333338e-3F + r * 1.3888889e-3F ) ) ) ) );
+		}
+	};
+
+	template< >
+	struct _fast_exp_traits< double >
+	{
+		static double lower( ) { return -708.0; }
+		static double upper( ) { return 709.0; }
+		static double round_bias( ) { return 6755399441055744.0; }
+
+		static double pow2( int n )
+		{
+			uint64_t bits = static_cast< uint64_t >( n + 1023 ) << 52;
+			double v;
+			std::memcpy( &v, &bits, sizeof( v ) );
+			return v;
+		}
+
+		// Taylor polynomial of degree 13 for e^r, |r| <= ln(2)/2
+		static double poly( double r )
+		{
+			return 1.0 + r * ( 1.0 + r * ( 0.5 + r * ( 1.0 / 6 + r * ( 1.0 / 24 + r * ( 1.0 / 120
+				+ r * ( 1.0 / 720 + r * ( 1.0 / 5040 + r * ( 1.0 / 40320 + r * ( 1.0 / 362880
+				+ r * ( 1.0 / 3628800 + r * ( 1.0 / 39916800 + r * ( 1.0 / 479001600
+				+ r * ( 1.0 / 6227020800.0 ) ) ) ) ) ) ) ) ) ) ) ) );
+		}
+	};
+
+	//! e^x by range reduction, x = n ln(2) + r, and a polynomial for e^r;
+	//! arguments outside the range of normal results are clamped
+	template< typename T >
+	T
+	_fast_exp( T x )
+	{
+		typedef _fast_exp_traits< T > traits;
+		// branch-free clamp and round to nearest, so loops of calls vectorize
+		x = ( x < traits::lower( ) ) ? traits::lower( ) : x;
+		x = ( x > traits::upper( ) ) ? traits::upper( ) : x;
+		T fn = ( x * static_cast< T >( 1.4426950408889634 ) + traits::round_bias( ) )
+			- traits::round_bias( );
+		int n = static_cast< int >( fn );
+		// ln(2) split so that fn * ln2_hi is exact
+		T r = x - fn * static_cast< T >( 0.693145751953125 );
+		r -= fn * static_cast< T >( 1.428606820309417e-06 );
+		return traits::poly( r ) * traits::pow2( n );
+	}
+
+	//! logistic function sampled at 64 points per unit over [ -16, 16 ]
+	template< typename T >
+	const T*
+	_logistic_table( )
+	{
+		struct table
+		{
+			table( )
+			{
+				for ( int k = 0; k <= 2048; ++k )
+				{
+					values[k] = static_cast< T >( 1.0 / ( 1.0 + std::exp( 16.0 - k / 64.0 ) ) );
+				}
+			}
+			T values[ 2049 ];
+		};
+		static const table t;
+		return t.values;
+	}
+	//! @endcond
+
+	//! approximate logistic transfer functor, polynomial exponential
+	//!
+	//! @par the logistic function:
+	//! @f$ y = \frac{1}{1 + e^{-x}} @f$
+	//!
+	//! @f$ e^{-x} @f$ is computed by range reduction and a Taylor
+	//! polynomial, without calling std::exp. The maximum absolute error
+	//! relative to logistic_output over all finite x is 1.2E-7 for float
+	//! and 3E-16 for double.
+	//!
+	template< class T >
+	struct fast_logistic_output : public std::unary_function<T,T>
+	{
+		T operator()( const T& x ) const
+		{
+			return static_cast<T>( 1 ) / ( static_cast<T>( 1 ) + _fast_exp( -x ) );
+		}
+	};
+
+	//! approximate logistic transfer functor, interpolated lookup table
+	//!
+	//! @par the logistic function:
+	//! @f$ y = \frac{1}{1 + e^{-x}} @f$
+	//!
+	//! Linear interpolation in a table of 2049 values over [ -16, 16 ];
+	//! outside that range the value at the nearest end is returned. The
+	//! maximum absolute error relative to logistic_output over all finite
+	//! x is 3.1E-6. The table is built on first use.
+	//!
+	template< class T >
+	struct table_logistic_output : public std::unary_function<T,T>
+	{
+		T operator()( const T& x ) const
+		{
+			const T* table = _logistic_table< T >();
+			T pos = ( x + static_cast<T>( 16 ) ) * static_cast<T>( 64 );
+			if ( !( pos > static_cast<T>( 0 ) ) )
+			{
+				return table[0];
+			}
+			if ( pos >= static_cast<T>( 2048 ) )
+			{
+				return table[2048];
+			}
+			int k = static_cast<int>( pos );
+			T frac = pos - static_cast<T>( k );
+			return table[k] + frac * ( table[k+1] - table[k] );
+		}
+	};
+
 	template< typename T, typename T2 >
 	struct normexp_op : public std::unary_function< T, T2 >
 	{
@@ -69,26 +233,229 @@ namespace gamboge
 		FwdIter2 result_last = std::transform( first, last, result,
 			normexp_op< VT, VT2 >(*maxin_p) );
 
-		VT denom = std::accumulate( first, last, static_cast<VT>(0) );
+		// the denominator is the sum of the exponentials just written
+		VT2 denom = std::accumulate( result, result_last, static_cast<VT2>(0) );
 
 		std::transform( result, result_last, result, std::bind2nd( std::divides< VT2 >(), denom ) );
 		return result_last;
 	}
 
+	//! output-layer transforms of a network topology
+	enum output_mode
+	{
+		output_default,             //!< unaryop for a single output unit, the
+		                            //!< softmax operator for multiple units
+		output_logistic,            //!< unaryop, logistic_output unless another
+		                            //!< transform is given, for each unit
+		output_linear,              //!< linear output units, R nnet linout
+		output_softmax              //!< softmax over the units, R nnet softmax
+	};
+
+	//! neural network topology
+	//!
+	//! Describes the units and connections of a network in the form R
+	//! nnet fits them: @a inputs inputs, @a hidden hidden-layer units and
+	//! @a outputs output units, optional skip-layer connections from the
+	//! inputs to the output units (R nnet skip) and the output transform.
+	//!
+	//! With skip-layer connections each output-layer weight block holds
+	//! 1 + @a hidden + @a inputs values, in the order of R nnet$wts: the
+	//! bias, the weights for the hidden-layer unit outputs, then the
+	//! weights for the network inputs. Hidden-layer blocks are as
+	//! described for evaluate_neural_network. Without hidden-layer units
+	//! the inputs always feed the output units and @a skip has no effect.
+	//!
+	//! Example, the topology of nnet( ..., size=2, skip=TRUE, linout=TRUE )
+	//! for 4 inputs and 3 outputs
+	//! @code
+	//! {
+	//! 	gamboge::nnet_topology topo( 4, 2, 3, gamboge::output_linear, true );
+	//! 	gamboge::evaluate_neural_network( nn_in, &(wts[0]), nn_out, topo );
+	//! }
+	//! @endcode
+	struct nnet_topology
+	{
+		//! constructor, network topology
+		//!
+		//! @param nx       input count
+		//! @param nh       hidden-layer count
+		//! @param ny       output count
+		//! @param mode     output transform
+		//! @param skip     whether the inputs also feed the output units
+		nnet_topology( std::size_t nx, std::size_t nh, std::size_t ny,
+			output_mode mode = output_default, bool skip = false )
+		: inputs( nx ),
+		  hidden( nh ),
+		  outputs( ny ),
+		  mode( mode ),
+		  skip( skip )
+		{
+		}
+
+		//! @return whether the inputs feed the output units
+		bool skip_layer( ) const
+		{
+			return skip || hidden == 0;
+		}
+
+		//! @return number of weights, the length of R nnet$wts
+		std::size_t weight_count( ) const
+		{
+			return hidden * ( 1 + inputs )
+				+ outputs * ( 1 + hidden + ( skip_layer( ) ? inputs : 0 ) );
+		}
+
+		std::size_t inputs;
+		std::size_t hidden;
+		std::size_t outputs;
+		output_mode mode;
+		bool skip;
+	};
+
+	//! @cond
+	//! transform the linear outputs [ lo, lo + ny ) in place and copy them
+	//! to result
+	template< typename VT, typename Size, typename OutIter, typename UnaryOp >
+	OutIter
+	_apply_output_mode( VT* lo, Size ny, output_mode mode, OutIter result, UnaryOp unaryop )
+	{
+		if ( mode == output_softmax || ( mode == output_default && ny > 1 ) )
+		{
+			_softmax( lo, lo + ny, lo );
+			return std::copy( lo, lo + ny, result );
+		}
+		else if ( mode == output_linear )
+		{
+			return std::copy( lo, lo + ny, result );
+		}
+		return std::transform( lo, lo + ny, result, unaryop );
+	}
+	//! @endcond
+
+	//! scratch storage for neural network evaluation
+	//!
+	//! A workspace holds the input, hidden-layer and output-layer buffers
+	//! used while evaluating a network. The storage grows on demand and is
+	//! kept for reuse, so once a workspace is large enough for a network
+	//! evaluations using it do not allocate. A workspace may be used by
+	//! one thread at a time.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	gamboge::nnet_workspace< double > ws( in_count, hidden_count, out_count );
+	//! 	for ( unsigned k = 0; k < row_count; ++k )
+	//! 	{
+	//! 		gamboge::evaluate_neural_network( &(values[k*in_count]), wts,
+	//! 			&(outputs[k*out_count]), in_count, hidden_count, out_count, ws );
+	//! 	}
+	//! }
+	//! @endcode
+	template< typename T >
+	class nnet_workspace
+	{
+	public:
+		typedef T value_type;
+
+		//! constructor, empty workspace
+		nnet_workspace( )
+		: buffer( 0 ),
+		  capacity( 0 )
+		{
+		}
+
+		//! constructor, workspace sized for single row evaluation
+		//!
+		//! @param nx       input count
+		//! @param nh       hidden-layer count
+		//! @param ny       output count
+		nnet_workspace( std::size_t nx, std::size_t nh, std::size_t ny )
+		: buffer( 0 ),
+		  capacity( 0 )
+		{
+			reserve( nx + nh + ny );
+		}
+
+		~nnet_workspace( )
+		{
+			delete[] buffer;
+		}
+
+		//! Obtain scratch storage
+		//!
+		//! @param n        required element count
+		//! @return start of at least @p n elements, or 0 if storage could not
+		//!         be allocated
+		//!
+		//! Contents of the storage are not preserved when it grows.
+		T* reserve( std::size_t n )
+		{
+			if ( n > capacity )
+			{
+				T* grown = new (std::nothrow) T[ n ];
+				if ( grown == 0 )
+				{
+					return 0;
+				}
+				delete[] buffer;
+				buffer = grown;
+				capacity = n;
+			}
+			return buffer;
+		}
+
+		//! @return element count available without allocating
+		std::size_t size( ) const
+		{
+			return capacity;
+		}
+
+	private:
+		// not copyable
+		nnet_workspace( const nnet_workspace& );
+		nnet_workspace& operator=( const nnet_workspace& );
+
+		T* buffer;
+		std::size_t capacity;
+	};
+
 	//! @cond
+	//! per-thread workspace used when the caller does not supply one
+	template< typename T >
+	nnet_workspace< T >&
+	_thread_workspace( )
+	{
+		static thread_local nnet_workspace< T > ws;
+		return ws;
+	}
+
+	// definitions that record to nnet_stats when GAMBOGE_NNET_STATS is
+	// defined; the inline namespace differs with the macro, so translation
+	// units compiled with and without it do not share these symbols
+#ifdef GAMBOGE_NNET_STATS
+	inline namespace _stats_on
+#else
+	inline namespace _stats_off
+#endif
+	{
+
 	//! implementation, target template code for functional dispatch
-	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp >
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
 	OutIter
 	_evaluate_neural_network( InIter1 rbegin, InIter2 wtbegin, OutIter result,
-		Size nx, Size nh, Size ny, UnaryOp unaryop )
+		Size nx, Size nh, Size ny, bool skip, output_mode mode, UnaryOp unaryop, HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
 	{
 		InIter2 itw = wtbegin;
 		typedef typename std::iterator_traits<OutIter>::value_type VT;
-		// create a buffer for input values, hidden-layer unit outputs and
+		// obtain a buffer for input values, hidden-layer unit outputs and
 		// output-layer unit linear outputs
-		VT* unitsbuf = new (std::nothrow) VT[ nx + nh + ny ];
+		_GAMBOGE_NNET_STATS_TIMER( _stats_single, 1 );
+		VT* unitsbuf = ws.reserve( nx + nh + ny );
 		if ( unitsbuf == 0 )
 		{
+			_GAMBOGE_NNET_STATS_ALLOC_FAILURE( _stats_single );
 			return result;
 		}
 		VT* inbuf = &(unitsbuf[0]);
@@ -113,17 +480,25 @@ namespace gamboge
 				InIter2 itw_end = itw + nx;
 				VT oh = std::inner_product( itw, itw_end, inbuf, bias );
 				itw = itw_end;
-				hidden_out[ hk ] = logistic_output< VT >()( oh );
+				hidden_out[ hk ] = hiddenop( oh );
 			}
 
-			// feed the hidden layer outputs into the output layer units
+			// feed the hidden layer outputs, and with skip-layer
+			// connections the network inputs, into the output layer units
 			for ( int ok = 0; ok < ny; ++ok )
 			{
 				VT bias = *itw;
 				++itw;
 				InIter2 itw_end = itw + nh;
-				linout[ok] = std::inner_product( itw, itw_end, &(hidden_out[0]), bias );
+				VT o = std::inner_product( itw, itw_end, &(hidden_out[0]), bias );
 				itw = itw_end;
+				if ( skip )
+				{
+					itw_end = itw + nx;
+					o = std::inner_product( itw, itw_end, inbuf, o );
+					itw = itw_end;
+				}
+				linout[ok] = o;
 			}
 		}
 		else  // nh is 0
@@ -139,164 +514,1252 @@ namespace gamboge
 			}
 		}
 
-		if ( ny > 1 )
-		{
-			_softmax( linout, &(linout[ny]), linout );
-			std::copy( linout, &(linout[ny]), result );
-		}
-		else
-		{
-			std::transform( linout, &(linout[ny]), result, unaryop );
-		}
-
-		delete[] unitsbuf;
+		_apply_output_mode( linout, ny, mode, result, unaryop );
 
 		return result;
 	}
-	//! @endcond
 
-	//! Evaluate artificial neural network outputs
-	//!
-	//! @param firstx   start of input value range
-	//! @param firstw   start of weights input range
-	//! @param result   start of output range
-	//! @param nx       input count
-	//! @param nh       hidden-layer count
-	//! @param ny       output count
-	//! @return iterator marking end of result sequence
-	//!
-	//! Computes feed-forward artificial neural network outputs. The network
-	//! has @p nx inputs, @p nh hidden-layer units and @p ny output units.
-	//! Network input values are read from the range
-	//! [ @p firstx, @p firstx + @p nx ).
-	//! Network output values are written to the range
-	//! [ @p result, @p result + @p ny ).
-	//! Bias and input weights for the hidden-layer and output-layer units
-	//! are read from the range [ @p firstw, @p firstw + @a v ), where the
-	//! number of weights @a v varies based upon @p nx, @p nh and @p ny.
-	//! @p the logistics_output function is applied at the output of each
-	//! hidden-layer. If there is a single output-layer unit then the
-	/// logistics_output function is applied at the output of  the output-layer
-	/// unit. If there are multiple output-layer units then the softmax operator
-	/// is applied to the output-layer units' linear outputs and the result is
-	/// the output for the the network.
-	//!
-	//! @par a hidden-layer neural unit output is:
-	//!    @a y = @b L( @a bias + &lang; @a x, @a w &rang; ) @n
-	//! The logistics operator @b L applied to the sum of the unit's bias and
-	//! the inner product of the unit's inputs and weights.
-	//!
-	//! <em>If @p nh is greater than 0</em>, the network inputs feed the
-	//! hidden-layer units and the hidden-layer units feed the output-layer units.
-	//! In this case the weights sequence starts
-	//! with blocks for each of the hidden-layer units followed by blocks for
-	//! each of the output-layer units.
-	//! Each hidden-layer block consists of 1 + @p nx values; the first value
-	//! is the bias for the unit and the remainder are weights for each of the
-	//! network inputs.
-	//! Each output-layer block consists of 1 + @p nh values; the first value
-	//! is the bias for the unit and the remainder are weights for each of the
-	//! hidden-layer unit outputs.
-	//! The number of weights is: @n
-	//! @a v = @p nh * ( 1 + @p nx ) + @p ny * ( 1 + @p nh ).
-	//!
-	//! <em>If @a nh equals 0</em>, there are no hidden-layer units and the network
-	//! inputs directly feed the output-layer units.
-	//! In this case the weights sequence consists of blocks for the output-layer
-	//! units.
-	//! Each output-layer block consists of 1 + @p nx values; the first value
-	//! is the bias for the unit and the remainder are weights for each of the
-	//! network inputs.
-	//! The number of weights is: @n
-	//! @a v = @p ny * ( 1 + @p nx ).
-	//!
-	template< typename InIter1, typename InIter2, typename OutIter, typename Size >
-	OutIter
-	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
-		Size nx, Size nh, Size ny )
+	//! slope of a transfer function given its output y: 1 for
+	//! linear_output, otherwise y ( 1 - y ), the slope of the logistic
+	//! function, which the fast and table approximations also follow
+	template< typename Op, typename T >
+	T
+	_transfer_slope( const Op&, T y )
 	{
-		typedef typename std::iterator_traits<OutIter>::value_type VT;
-		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, logistic_output< VT >() );
+		return y * ( static_cast< T >( 1 ) - y );
 	}
 
-	//! Evaluate artificial neural network outputs
-	//!
-	//! @param firstx   start of input value sequence
-	//! @param firstw   start of weights sequence
-	//! @param result   start of output sequence
-	//! @param nx       input count
-	//! @param nh       hidden-layer count
-	//! @param ny       output count
-	//! @param unaryop  output transform for units
-	//! @return iterator marking end of result sequence
-	//!
-	//! Computes feed-forward artificial neural network outputs. The network
-	//! has @p nx inputs, @p nh hidden-layer units and @p ny output units.
-	//! Network input values are read from the range
-	//! [ @p firstx, @p firstx + @p nx ).
-	//! Network output values are written to the range
-	//! [ @p result, @p result + @p ny ).
-	//! Bias and input weights for the hidden-layer and output-layer units
-	//! are read from the range [ @p firstw, @p firstw + @a v ), where the
-	//! number of weights @a v varies based upon @p nx, @p nh and @p ny.
-	//! @p the logistics_output function is applied at the output of each
-	//! hidden-layer unit. If there is a single output-layer unit then
-	/// @p unaryop is applied at the output of  the output-layer
-	/// unit. If there are multiple output-layer units then the softmax operator
-	/// is applied to the output-layer units' linear outputs and the result is
-	/// the output for the the network.
-	//!
-	//! @par a hidden-layer neural unit output is:
-	//!    @a y = @b L( @a bias + &lang; @a x, @a w &rang; ) @n
-	//! The logistics operator @b L applied to the sum of the unit's bias and
-	//! the inner product of the unit's inputs and weights.
-	//!
-	//! <em>If @p nh is greater than 0</em>, the network inputs feed the
-	//! hidden-layer units and the hidden-layer units feed the output-layer units.
-	//! In this case the weights sequence starts
-	//! with blocks for each of the hidden-layer units followed by blocks for
-	//! each of the output-layer units.
-	//! Each hidden-layer block consists of 1 + @p nx values; the first value
-	//! is the bias for the unit and the remainder are weights for each of the
-	//! network inputs.
-	//! Each output-layer block consists of 1 + @p nh values; the first value
-	//! is the bias for the unit and the remainder are weights for each of the
-	//! hidden-layer unit outputs.
-	//! The number of weights is: @n
-	//! @a v = @p nh * ( 1 + @p nx ) + @p ny * ( 1 + @p nh ).
-	//!
-	//! <em>If @a nh equals 0</em>, there are no hidden-layer units and the network
-	//! inputs directly feed the output-layer units.
-	//! In this case the weights sequence consists of blocks for the output-layer
-	//! units.
-	//! Each output-layer block consists of 1 + @p nx values; the first value
-	//! is the bias for the unit and the remainder are weights for each of the
-	//! network inputs.
-	//! The number of weights is: @n
-	//! @a v = @p ny * ( 1 + @p nx ).
-	//!
-	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp >
-	OutIter
-	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
-		Size nx, Size nh, Size ny, UnaryOp unaryop )
+	template< typename T >
+	T
+	_transfer_slope( const linear_output< T >&, T )
 	{
-		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, unaryop );
+		return static_cast< T >( 1 );
 	}
 
-	//! artificial neural network
-	template < typename InIter, typename InIterWt, typename OutIter, typename Size >
-	class neural_network
+	//! implementation, outputs and Jacobian of one row; the backward pass
+	//! reuses the forward buffers: the hidden-layer outputs are replaced by
+	//! their slopes and, for the softmax transform, the inputs by the
+	//! output-weighted column sums of the linear outputs' Jacobian
+	template< typename InIter1, typename RandIter2, typename OutIter, typename OutIter2,
+		typename Size, typename UnaryOp, typename HiddenOp >
+	bool
+	_evaluate_with_jacobian( InIter1 rbegin, RandIter2 wtbegin, OutIter result,
+		OutIter2 jacobian, Size nx, Size nh, Size ny, bool skip, output_mode mode,
+		UnaryOp unaryop, HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
 	{
-	public:
-		// typedef typename std::iterator_traits<OutIter>::value_type value_type;
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		_GAMBOGE_NNET_STATS_TIMER( _stats_single, 1 );
+		VT* unitsbuf = ws.reserve( nx + nh + ny );
+		if ( unitsbuf == 0 )
+		{
+			_GAMBOGE_NNET_STATS_ALLOC_FAILURE( _stats_single );
+			return false;
+		}
+		VT* inbuf = &(unitsbuf[0]);
+		VT* hidden_out = &(unitsbuf[nx]);
+		VT* out = &(unitsbuf[nx+nh]);
+		for ( Size k = 0; k < nx; ++k, ++rbegin )
+		{
+			inbuf[k] = *rbegin;
+		}
+
+		// forward pass
+		const Size hblock = 1 + nx;
+		const Size oblock = 1 + nh + ( skip || nh == 0 ? nx : 0 );
+		RandIter2 owts = wtbegin + nh * hblock;
+		for ( Size h = 0; h < nh; ++h )
+		{
+			RandIter2 w = wtbegin + h * hblock;
+			hidden_out[h] = hiddenop( std::inner_product( w + 1, w + hblock, inbuf, VT( *w ) ) );
+		}
+		for ( Size o = 0; o < ny; ++o )
+		{
+			RandIter2 w = owts + o * oblock;
+			VT lo = std::inner_product( w + 1, w + 1 + nh, hidden_out, VT( *w ) );
+			out[o] = std::inner_product( w + 1 + nh, w + oblock, inbuf, lo );
+		}
+		_apply_output_mode( out, ny, mode, out, unaryop );
+		std::copy( out, out + ny, result );
+
+		// backward pass: row o of the linear outputs' Jacobian is the
+		// skip-layer weights plus, over the hidden units, the output
+		// weight times the unit's slope times its input weights
+		for ( Size h = 0; h < nh; ++h )
+		{
+			hidden_out[h] = _transfer_slope( hiddenop, hidden_out[h] );
+		}
+		OutIter2 jrow = jacobian;
+		for ( Size o = 0; o < ny; ++o, jrow += nx )
+		{
+			RandIter2 w = owts + o * oblock;
+			if ( oblock > 1 + nh )
+			{
+				std::copy( w + 1 + nh, w + oblock, jrow );
+			}
+			else
+			{
+				std::fill( jrow, jrow + nx, static_cast< VT >( 0 ) );
+			}
+			for ( Size h = 0; h < nh; ++h )
+			{
+				const VT c = VT( w[ 1 + h ] ) * hidden_out[h];
+				RandIter2 wh = wtbegin + h * hblock + 1;
+				for ( Size k = 0; k < nx; ++k )
+				{
+					jrow[k] += c * VT( wh[k] );
+				}
+			}
+		}
+
+		// output transform
+		if ( mode == output_softmax || ( mode == output_default && ny > 1 ) )
+		{
+			// dy_o/dx_k = y_o ( L_ok - sum_p y_p L_pk )
+			std::fill( inbuf, inbuf + nx, static_cast< VT >( 0 ) );
+			jrow = jacobian;
+			for ( Size o = 0; o < ny; ++o, jrow += nx )
+			{
+				for ( Size k = 0; k < nx; ++k )
+				{
+					inbuf[k] += out[o] * jrow[k];
+				}
+			}
+			jrow = jacobian;
+			for ( Size o = 0; o < ny; ++o, jrow += nx )
+			{
+				for ( Size k = 0; k < nx; ++k )
+				{
+					jrow[k] = out[o] * ( jrow[k] - inbuf[k] );
+				}
+			}
+		}
+		else if ( mode != output_linear )
+		{
+			jrow = jacobian;
+			for ( Size o = 0; o < ny; ++o, jrow += nx )
+			{
+				const VT d = _transfer_slope( unaryop, out[o] );
+				for ( Size k = 0; k < nx; ++k )
+				{
+					jrow[k] *= d;
+				}
+			}
+		}
+		return true;
+	}
+
+	//! input rows per block for batched evaluation; a block of buffered
+	//! input rows together with the unit outputs computed from them is
+	//! sized to remain in L1 data cache while each unit's weights are
+	//! applied to every row of the block
+	template< typename VT, typename Size >
+	Size
+	_batch_block_rows( Size nx, Size nh, Size ny )
+	{
+		const std::size_t cache_bytes = 32768;
+		const std::size_t max_rows = 256;
+		std::size_t row_bytes = ( nx + nh + ny ) * sizeof( VT );
+		std::size_t rows = ( row_bytes > 0 ) ? cache_bytes / row_bytes : max_rows;
+		rows = std::min( std::max( rows, std::size_t( 1 ) ), max_rows );
+		return static_cast< Size >( rows );
+	}
+
+	//! compute one layer of units for a block of rows, a cache-blocked
+	//! matrix-matrix product; the weights of a unit are read once per block
+	//! and remain in cache while they are applied to each of the rows
+	template< typename InIter, typename VT, typename Size, typename UnaryOp >
+	InIter
+	_evaluate_layer_block( InIter itw, const VT* in, Size nin, Size nunits,
+		Size rows, VT* out, UnaryOp unaryop )
+	{
+		for ( Size uk = 0; uk < nunits; ++uk )
+		{
+			VT bias = *itw;
+			++itw;
+			InIter itw_end = itw + nin;
+			for ( Size r = 0; r < rows; ++r )
+			{
+				VT o = std::inner_product( itw, itw_end, &(in[r*nin]), bias );
+				out[ r*nunits + uk ] = unaryop( o );
+			}
+			itw = itw_end;
+		}
+		return itw;
+	}
+
+	//! compute the output-layer linear outputs for a block of rows of a
+	//! network with skip-layer connections; each unit's hidden-layer and
+	//! input weights are applied in the same pass over the unit's weight
+	//! block, hidden-layer weights first as in R nnet$wts
+	template< typename InIter, typename VT, typename Size >
+	InIter
+	_evaluate_skip_layer_block( InIter itw, const VT* hidden, Size nh, const VT* in, Size nx,
+		Size nunits, Size rows, VT* out )
+	{
+		for ( Size uk = 0; uk < nunits; ++uk )
+		{
+			VT bias = *itw;
+			++itw;
+			InIter itw_mid = itw + nh;
+			InIter itw_end = itw_mid + nx;
+			for ( Size r = 0; r < rows; ++r )
+			{
+				VT o = std::inner_product( itw, itw_mid, &(hidden[r*nh]), bias );
+				out[ r*nunits + uk ] = std::inner_product( itw_mid, itw_end, &(in[r*nx]), o );
+			}
+			itw = itw_end;
+		}
+		return itw;
+	}
+
+	//! compute the output-layer linear outputs for many input rows, in
+	//! blocks, and pass each row's outputs to @p rowop in row order;
+	//! returns false if the workspace could not be obtained
+	template< typename RandIter1, typename InIter2, typename Size, typename VT, typename HiddenOp,
+		typename RowOp >
+	bool
+	_evaluate_linear_batch( RandIter1 firstx, Size xstride, InIter2 wtbegin,
+		Size nrows, Size nx, Size nh, Size ny, bool skip, HiddenOp hiddenop,
+		nnet_workspace< VT >& ws, RowOp& rowop )
+	{
+		_GAMBOGE_NNET_STATS_TIMER( _stats_batch, nrows );
+		Size nb = std::min( nrows, _batch_block_rows< VT >( nx, nh, ny ) );
+		if ( nb == 0 )
+		{
+			return true;
+		}
+
+		// obtain a buffer for a block of input rows, hidden-layer unit
+		// outputs and output-layer unit linear outputs
+		VT* unitsbuf = ws.reserve( nb * ( nx + nh + ny ) );
+		if ( unitsbuf == 0 )
+		{
+			_GAMBOGE_NNET_STATS_ALLOC_FAILURE( _stats_batch );
+			return false;
+		}
+		VT* inbuf = &(unitsbuf[0]);
+		VT* hidden_out = &(unitsbuf[nb*nx]);
+		VT* linout = &(unitsbuf[nb*(nx+nh)]);
+
+		for ( Size r0 = 0; r0 < nrows; r0 += nb )
+		{
+			Size rows = std::min( nb, nrows - r0 );
+
+			// gather the block of input rows, applying the row stride
+			for ( Size r = 0; r < rows; ++r )
+			{
+				RandIter1 itx = firstx + ( r0 + r ) * xstride;
+				for ( Size k = 0; k < nx; ++k )
+				{
+					inbuf[ r*nx + k ] = *itx++;
+				}
+			}
+
+			if ( nh > 0 )
+			{
+				InIter2 itw = _evaluate_layer_block( wtbegin, inbuf, nx, nh,
+					rows, hidden_out, hiddenop );
+				if ( skip )
+				{
+					_evaluate_skip_layer_block( itw, hidden_out, nh, inbuf, nx, ny,
+						rows, linout );
+				}
+				else
+				{
+					_evaluate_layer_block( itw, hidden_out, nh, ny,
+						rows, linout, linear_output< VT >() );
+				}
+			}
+			else  // nh is 0
+			{
+				_evaluate_layer_block( wtbegin, inbuf, nx, ny,
+					rows, linout, linear_output< VT >() );
+			}
+
+			for ( Size r = 0; r < rows; ++r )
+			{
+				rowop( &(linout[r*ny]) );
+			}
+		}
+		return true;
+	}
+
+	//! row operation writing network outputs transformed as the output
+	//! mode specifies
+	template< typename OutIter, typename Size, typename UnaryOp >
+	struct _output_rows
+	{
+		_output_rows( OutIter result, Size ny, output_mode mode, UnaryOp unaryop )
+		: result( result ),
+		  ny( ny ),
+		  mode( mode ),
+		  unaryop( unaryop )
+		{
+		}
+
+		template< typename VT >
+		void operator()( VT* lo )
+		{
+			result = _apply_output_mode( lo, ny, mode, result, unaryop );
+		}
+
+		OutIter result;
+		Size ny;
+		output_mode mode;
+		UnaryOp unaryop;
+	};
+
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	_evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 wtbegin,
+		OutIter result, Size nrows, Size nx, Size nh, Size ny, bool skip, output_mode mode,
+		UnaryOp unaryop, HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		_output_rows< OutIter, Size, UnaryOp > rowop( result, ny, mode, unaryop );
+		_evaluate_linear_batch( firstx, xstride, wtbegin, nrows, nx, nh, ny, skip, hiddenop,
+			ws, rowop );
+		return rowop.result;
+	}
+
+	//! column access for an array of column iterators
+	template< typename ColIter >
+	struct _column_pointers
+	{
+		typedef typename std::iterator_traits< ColIter >::value_type iterator;
+
+		explicit _column_pointers( ColIter columns )
+		: columns( columns )
+		{
+		}
+
+		template< typename Size >
+		iterator operator()( Size k ) const
+		{
+			return columns[k];
+		}
+
+		ColIter columns;
+	};
+
+	//! column access for a column-major matrix
+	template< typename RandIter, typename Size >
+	struct _column_major
+	{
+		typedef RandIter iterator;
+
+		_column_major( RandIter first, Size stride )
+		: first( first ),
+		  stride( stride )
+		{
+		}
+
+		iterator operator()( Size k ) const
+		{
+			return first + k * stride;
+		}
+
+		RandIter first;
+		Size stride;
+	};
+
+	//! compute the output-layer linear outputs for many input rows held as
+	//! columns, in blocks, and pass each row's outputs to @p rowop in row
+	//! order; each layer is accumulated unit by unit across the block's
+	//! rows, one axpy update per weight, reading each input column
+	//! contiguously; returns false if the workspace could not be obtained
+	template< typename Columns, typename RandIter2, typename Size, typename VT,
+		typename HiddenOp, typename RowOp >
+	bool
+	_evaluate_columns_batch( Columns columns, RandIter2 wtbegin, Size nrows, Size nx,
+		Size nh, Size ny, bool skip, HiddenOp hiddenop, nnet_workspace< VT >& ws,
+		RowOp& rowop )
+	{
+		_GAMBOGE_NNET_STATS_TIMER( _stats_batch, nrows );
+		Size nb = std::min( nrows, _batch_block_rows< VT >( Size( 1 ), nh, ny ) );
+		if ( nb == 0 )
+		{
+			return true;
+		}
+
+		// obtain a buffer for a block of hidden-layer and output-layer
+		// units, unit-major, and one row of linear outputs
+		VT* unitsbuf = ws.reserve( nb * ( nh + ny ) + ny );
+		if ( unitsbuf == 0 )
+		{
+			_GAMBOGE_NNET_STATS_ALLOC_FAILURE( _stats_batch );
+			return false;
+		}
+		VT* hidden_out = &(unitsbuf[0]);
+		VT* linout = &(unitsbuf[nb*nh]);
+		VT* rowbuf = &(unitsbuf[nb*(nh+ny)]);
+
+		const Size hblock = 1 + nx;
+		const bool inputs_feed = skip || nh == 0;
+		const Size oblock = 1 + nh + ( inputs_feed ? nx : 0 );
+		const RandIter2 owts = wtbegin + nh * hblock;
+		for ( Size r0 = 0; r0 < nrows; r0 += nb )
+		{
+			const Size rows = std::min( nb, nrows - r0 );
+
+			// hidden-layer units: the bias, then weight times column for
+			// each input
+			for ( Size h = 0; h < nh; ++h )
+			{
+				std::fill( hidden_out + h * nb, hidden_out + h * nb + rows,
+					static_cast< VT >( wtbegin[ h * hblock ] ) );
+			}
+			for ( Size k = 0; k < nx; ++k )
+			{
+				const typename Columns::iterator col = columns( k ) + r0;
+				for ( Size h = 0; h < nh; ++h )
+				{
+					const VT w = wtbegin[ h * hblock + 1 + k ];
+					VT* acc = hidden_out + h * nb;
+					for ( Size r = 0; r < rows; ++r )
+					{
+						acc[r] += w * col[r];
+					}
+				}
+			}
+			for ( Size h = 0; h < nh; ++h )
+			{
+				VT* acc = hidden_out + h * nb;
+				for ( Size r = 0; r < rows; ++r )
+				{
+					acc[r] = hiddenop( acc[r] );
+				}
+			}
+
+			// output-layer units from the hidden-layer units and, with
+			// skip-layer connections, the input columns
+			for ( Size o = 0; o < ny; ++o )
+			{
+				const RandIter2 w = owts + o * oblock;
+				VT* acc = linout + o * nb;
+				std::fill( acc, acc + rows, static_cast< VT >( w[0] ) );
+				for ( Size h = 0; h < nh; ++h )
+				{
+					const VT v = w[ 1 + h ];
+					const VT* hid = hidden_out + h * nb;
+					for ( Size r = 0; r < rows; ++r )
+					{
+						acc[r] += v * hid[r];
+					}
+				}
+				for ( Size k = 0; inputs_feed && k < nx; ++k )
+				{
+					const VT v = w[ 1 + nh + k ];
+					const typename Columns::iterator col = columns( k ) + r0;
+					for ( Size r = 0; r < rows; ++r )
+					{
+						acc[r] += v * col[r];
+					}
+				}
+			}
+
+			for ( Size r = 0; r < rows; ++r )
+			{
+				for ( Size o = 0; o < ny; ++o )
+				{
+					rowbuf[o] = linout[ o * nb + r ];
+				}
+				rowop( rowbuf );
+			}
+		}
+		return true;
+	}
+
+	//! row operation writing class indices from linear outputs: the
+	//! largest output for multiple outputs, otherwise the comparison of
+	//! the single output with a threshold logit
+	template< typename OutIter, typename Size, typename VT >
+	struct _class_rows
+	{
+		_class_rows( OutIter result, Size ny, VT threshold_logit )
+		: result( result ),
+		  ny( ny ),
+		  threshold_logit( threshold_logit )
+		{
+		}
+
+		void operator()( const VT* lo )
+		{
+			*result = ( ny > 1 ) ? static_cast< Size >( std::max_element( lo, lo + ny ) - lo )
+				: static_cast< Size >( lo[0] > threshold_logit ? 1 : 0 );
+			++result;
+		}
+
+		OutIter result;
+		Size ny;
+		VT threshold_logit;
+	};
+
+	//! row operation writing the k classes with the largest linear
+	//! outputs, best first; equal outputs are ordered by class index. A
+	//! single output is treated as two classes with linear outputs 0 and
+	//! the logit.
+	template< typename OutIter, typename Size >
+	struct _top_k_rows
+	{
+		_top_k_rows( OutIter result, Size ny, Size k )
+		: result( result ),
+		  ny( ny ),
+		  k( k )
+		{
+		}
+
+		template< typename VT >
+		void operator()( const VT* lo )
+		{
+			if ( ny == 1 )
+			{
+				VT two_class[ 2 ] = { static_cast< VT >( 0 ), lo[0] };
+				select( two_class, 2 );
+			}
+			else
+			{
+				select( lo, ny );
+			}
+		}
+
+		// repeatedly select the best class ranked after the previous one,
+		// so no index buffer is needed
+		template< typename VT >
+		void select( const VT* lo, Size n )
+		{
+			Size prev = 0;
+			for ( Size j = 0; j < k && j < n; ++j )
+			{
+				Size best = n;
+				for ( Size c = 0; c < n; ++c )
+				{
+					bool after_prev = ( j == 0 ) || lo[c] < lo[prev]
+						|| ( lo[c] == lo[prev] && c > prev );
+					if ( after_prev && ( best == n || lo[c] > lo[best] ) )
+					{
+						best = c;
+					}
+				}
+				*result = best;
+				++result;
+				prev = best;
+			}
+		}
+
+		OutIter result;
+		Size ny;
+		Size k;
+	};
+	//! @endcond
+
+	//! Evaluate artificial neural network outputs
+	//!
+	//! @param firstx   start of input value range
+	//! @param firstw   start of weights input range
+	//! @param result   start of output range
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @return iterator marking end of result sequence
+	//!
+	//! Computes feed-forward artificial neural network outputs. The network
+	//! has @p nx inputs, @p nh hidden-layer units and @p ny output units.
+	//! Network input values are read from the range
+	//! [ @p firstx, @p firstx + @p nx ).
+	//! Network output values are written to the range
+	//! [ @p result, @p result + @p ny ).
+	//! Bias and input weights for the hidden-layer and output-layer units
+	//! are read from the range [ @p firstw, @p firstw + @a v ), where the
+	//! number of weights @a v varies based upon @p nx, @p nh and @p ny.
+	//! @p the logistics_output function is applied at the output of each
+	//! hidden-layer. If there is a single output-layer unit then the
+	/// logistics_output function is applied at the output of  the output-layer
+	/// unit. If there are multiple output-layer units then the softmax operator
+	/// is applied to the output-layer units' linear outputs and the result is
+	/// the output for the the network.
+	//!
+	//! @par a hidden-layer neural unit output is:
+	//!    @a y = @b L( @a bias + &lang; @a x, @a w &rang; ) @n
+	//! The logistics operator @b L applied to the sum of the unit's bias and
+	//! the inner product of the unit's inputs and weights.
+	//!
+	//! <em>If @p nh is greater than 0</em>, the network inputs feed the
+	//! hidden-layer units and the hidden-layer units feed the output-layer units.
+	//! In this case the weights sequence starts
+	//! with blocks for each of the hidden-layer units followed by blocks for
+	//! each of the output-layer units.
+	//! Each hidden-layer block consists of 1 + @p nx values; the first value
+	//! is the bias for the unit and the remainder are weights for each of the
+	//! network inputs.
+	//! Each output-layer block consists of 1 + @p nh values; the first value
+	//! is the bias for the unit and the remainder are weights for each of the
+	//! hidden-layer unit outputs.
+	//! The number of weights is: @n
+	//! @a v = @p nh * ( 1 + @p nx ) + @p ny * ( 1 + @p nh ).
+	//!
+	//! <em>If @a nh equals 0</em>, there are no hidden-layer units and the network
+	//! inputs directly feed the output-layer units.
+	//! In this case the weights sequence consists of blocks for the output-layer
+	//! units.
+	//! Each output-layer block consists of 1 + @p nx values; the first value
+	//! is the bias for the unit and the remainder are weights for each of the
+	//! network inputs.
+	//! The number of weights is: @n
+	//! @a v = @p ny * ( 1 + @p nx ).
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		Size nx, Size nh, Size ny )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, false, output_default,
+			logistic_output< VT >(), logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output sequence
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @return iterator marking end of result sequence
+	//!
+	//! Computes feed-forward artificial neural network outputs. The network
+	//! has @p nx inputs, @p nh hidden-layer units and @p ny output units.
+	//! Network input values are read from the range
+	//! [ @p firstx, @p firstx + @p nx ).
+	//! Network output values are written to the range
+	//! [ @p result, @p result + @p ny ).
+	//! Bias and input weights for the hidden-layer and output-layer units
+	//! are read from the range [ @p firstw, @p firstw + @a v ), where the
+	//! number of weights @a v varies based upon @p nx, @p nh and @p ny.
+	//! @p the logistics_output function is applied at the output of each
+	//! hidden-layer unit. If there is a single output-layer unit then
+	/// @p unaryop is applied at the output of  the output-layer
+	/// unit. If there are multiple output-layer units then the softmax operator
+	/// is applied to the output-layer units' linear outputs and the result is
+	/// the output for the the network.
+	//!
+	//! @par a hidden-layer neural unit output is:
+	//!    @a y = @b L( @a bias + &lang; @a x, @a w &rang; ) @n
+	//! The logistics operator @b L applied to the sum of the unit's bias and
+	//! the inner product of the unit's inputs and weights.
+	//!
+	//! <em>If @p nh is greater than 0</em>, the network inputs feed the
+	//! hidden-layer units and the hidden-layer units feed the output-layer units.
+	//! In this case the weights sequence starts
+	//! with blocks for each of the hidden-layer units followed by blocks for
+	//! each of the output-layer units.
+	//! Each hidden-layer block consists of 1 + @p nx values; the first value
+	//! is the bias for the unit and the remainder are weights for each of the
+	//! network inputs.
+	//! Each output-layer block consists of 1 + @p nh values; the first value
+	//! is the bias for the unit and the remainder are weights for each of the
+	//! hidden-layer unit outputs.
+	//! The number of weights is: @n
+	//! @a v = @p nh * ( 1 + @p nx ) + @p ny * ( 1 + @p nh ).
+	//!
+	//! <em>If @a nh equals 0</em>, there are no hidden-layer units and the network
+	//! inputs directly feed the output-layer units.
+	//! In this case the weights sequence consists of blocks for the output-layer
+	//! units.
+	//! Each output-layer block consists of 1 + @p nx values; the first value
+	//! is the bias for the unit and the remainder are weights for each of the
+	//! network inputs.
+	//! The number of weights is: @n
+	//! @a v = @p ny * ( 1 + @p nx ).
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		Size nx, Size nh, Size ny, UnaryOp unaryop )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, false, output_default,
+			unaryop, logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs using a workspace
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output sequence
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above, with buffers taken from @p ws.
+	//! The evaluation does not allocate once @p ws holds at least
+	//! @p nx + @p nh + @p ny elements.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		Size nx, Size nh, Size ny,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, false, output_default,
+			logistic_output< VT >(), logistic_output< VT >(), ws );
+	}
+
+	//! Evaluate artificial neural network outputs using a workspace
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output sequence
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above, with buffers taken from @p ws.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		Size nx, Size nh, Size ny, UnaryOp unaryop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, false, output_default,
+			unaryop, logistic_output< VT >(), ws );
+	}
+
+	//! Evaluate artificial neural network outputs with a hidden-layer
+	//! transfer function
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output sequence
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @param hiddenop transfer function applied at the output of each
+	//!                 hidden-layer unit in place of logistic_output,
+	//!                 e.g. fast_logistic_output
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		Size nx, Size nh, Size ny, UnaryOp unaryop, HiddenOp hiddenop )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, false, output_default,
+			unaryop, hiddenop, _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs with a hidden-layer
+	//! transfer function using a workspace
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output sequence
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above, with buffers taken from @p ws.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		Size nx, Size nh, Size ny, UnaryOp unaryop, HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		return _evaluate_neural_network( firstx, firstw, result, nx, nh, ny, false, output_default,
+			unaryop, hiddenop, ws );
+	}
+
+	//! Evaluate artificial neural network outputs for a topology
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output sequence
+	//! @param topo     network topology
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above, for the units, skip-layer
+	//! connections and output transform described by @p topo; see
+	//! nnet_topology for the weights layout. The skip-layer contribution
+	//! of the inputs to an output unit is accumulated in the same inner
+	//! product pass as the hidden-layer contribution. The logistic_output
+	//! function is applied at the output of each hidden-layer unit and, in
+	//! the output_default and output_logistic modes, of output units.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		const nnet_topology& topo )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, topo.inputs, topo.hidden,
+			topo.outputs, topo.skip && topo.hidden > 0, topo.mode, logistic_output< VT >(),
+			logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for a topology
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output sequence
+	//! @param topo     network topology
+	//! @param unaryop  output transform for units in the output_default
+	//!                 and output_logistic modes
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename UnaryOp >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		const nnet_topology& topo, UnaryOp unaryop )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network( firstx, firstw, result, topo.inputs, topo.hidden,
+			topo.outputs, topo.skip && topo.hidden > 0, topo.mode, unaryop,
+			logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for a topology with a
+	//! hidden-layer transfer function using a workspace
+	//!
+	//! @param firstx   start of input value sequence
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output sequence
+	//! @param topo     network topology
+	//! @param unaryop  output transform for units in the output_default
+	//!                 and output_logistic modes
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network above, with buffers taken from @p ws.
+	//!
+	template< typename InIter1, typename InIter2, typename OutIter, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	evaluate_neural_network( InIter1 firstx, InIter2 firstw, OutIter result,
+		const nnet_topology& topo, UnaryOp unaryop, HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		return _evaluate_neural_network( firstx, firstw, result, topo.inputs, topo.hidden,
+			topo.outputs, topo.skip && topo.hidden > 0, topo.mode, unaryop, hiddenop, ws );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @return iterator marking end of result sequence
+	//!
+	//! Computes the same outputs as evaluate_neural_network for each of
+	//! @p nrows input rows. Input row @a r is read from the range
+	//! [ @p firstx + @a r * @p xstride, @p firstx + @a r * @p xstride + @p nx ).
+	//! The outputs for row @a r are written to the range
+	//! [ @p result + @a r * @p ny, @p result + ( @a r + 1 ) * @p ny ).
+	//! The weights sequence has the same layout as for evaluate_neural_network.
+	//!
+	//! Rows are evaluated in blocks: each layer is computed as a matrix-matrix
+	//! product of the block's rows and the layer's weights, so the weights
+	//! of a unit are read once per block rather than once per row.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, Size nx, Size nh, Size ny )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result,
+			nrows, nx, nh, ny, false, output_default, logistic_output< VT >(),
+			logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_batch above, with @p unaryop applied at the
+	//! output of a single output-layer unit.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, Size nx, Size nh, Size ny, UnaryOp unaryop )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result,
+			nrows, nx, nh, ny, false, output_default, unaryop, logistic_output< VT >(),
+			_thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! using a workspace
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_batch above, with buffers taken from @p ws.
+	//! The storage required depends on the row block size; after the first
+	//! call for a network the workspace does not grow further.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, Size nx, Size nh, Size ny,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result,
+			nrows, nx, nh, ny, false, output_default, logistic_output< VT >(),
+			logistic_output< VT >(), ws );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! with a hidden-layer transfer function
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_batch above.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, Size nx, Size nh, Size ny, UnaryOp unaryop,
+		HiddenOp hiddenop )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result,
+			nrows, nx, nh, ny, false, output_default, unaryop, hiddenop,
+			_thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! with a hidden-layer transfer function using a workspace
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for units
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_batch above, with buffers taken from @p ws.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, Size nx, Size nh, Size ny, UnaryOp unaryop,
+		HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result,
+			nrows, nx, nh, ny, false, output_default, unaryop, hiddenop, ws );
+	}
+
+	//! Evaluate artificial neural network outputs for a topology for many
+	//! input rows
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param topo     network topology
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_batch above, for the units, skip-layer
+	//! connections and output transform described by @p topo. The
+	//! skip-layer weights of each output unit are applied to the block's
+	//! buffered input rows in the same pass as its hidden-layer weights.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, const nnet_topology& topo )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result, nrows,
+			static_cast< Size >( topo.inputs ), static_cast< Size >( topo.hidden ),
+			static_cast< Size >( topo.outputs ), topo.skip && topo.hidden > 0, topo.mode,
+			logistic_output< VT >(), logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for a topology for many
+	//! input rows with a hidden-layer transfer function using a workspace
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param topo     network topology
+	//! @param unaryop  output transform for units in the output_default
+	//!                 and output_logistic modes
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_batch above, with buffers taken from @p ws.
+	//!
+	template< typename RandIter1, typename InIter2, typename OutIter, typename Size, typename UnaryOp,
+		typename HiddenOp >
+	OutIter
+	evaluate_neural_network_batch( RandIter1 firstx, Size xstride, InIter2 firstw,
+		OutIter result, Size nrows, const nnet_topology& topo, UnaryOp unaryop,
+		HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		return _evaluate_neural_network_batch( firstx, xstride, firstw, result, nrows,
+			static_cast< Size >( topo.inputs ), static_cast< Size >( topo.hidden ),
+			static_cast< Size >( topo.outputs ), topo.skip && topo.hidden > 0, topo.mode,
+			unaryop, hiddenop, ws );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! held as columns
+	//!
+	//! @param columns  start of a sequence of @a nx column iterators,
+	//!                 column @a k holding input @a k of each row
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param topo     network topology
+	//! @return iterator marking end of result sequence
+	//!
+	//! Computes the outputs of evaluate_neural_network_batch for inputs
+	//! stored column by column, as a structure of arrays, without
+	//! gathering them into rows: row @a r's input @a k is
+	//! @p columns [ @a k ][ @a r ]. The outputs for each row are written
+	//! consecutively. Rows are evaluated in blocks; each unit's linear
+	//! outputs for a block are accumulated as axpy updates, adding a
+	//! weight times the block's segment of an input column (or of a
+	//! hidden-layer unit's outputs) to the unit's accumulators. The
+	//! weights iterator must be random access.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	const float* columns[ 4 ] = { &(sepal_length[0]), &(sepal_width[0]),
+	//! 		&(petal_length[0]), &(petal_width[0]) };
+	//! 	gamboge::evaluate_neural_network_columns( columns, &(wts[0]), &(outputs[0]),
+	//! 		row_count, gamboge::nnet_topology( 4, 2, 3 ) );
+	//! }
+	//! @endcode
+	template< typename ColIter, typename RandIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network_columns( ColIter columns, RandIter2 firstw, OutIter result,
+		Size nrows, const nnet_topology& topo )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return evaluate_neural_network_columns( columns, firstw, result, nrows, topo,
+			logistic_output< VT >(), logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! held as columns with a hidden-layer transfer function using a
+	//! workspace
+	//!
+	//! @param columns  start of a sequence of @a nx column iterators
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param topo     network topology
+	//! @param unaryop  output transform for units in the output_default
+	//!                 and output_logistic modes
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	template< typename ColIter, typename RandIter2, typename OutIter, typename Size,
+		typename UnaryOp, typename HiddenOp >
+	OutIter
+	evaluate_neural_network_columns( ColIter columns, RandIter2 firstw, OutIter result,
+		Size nrows, const nnet_topology& topo, UnaryOp unaryop, HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		_output_rows< OutIter, Size, UnaryOp > rowop( result,
+			static_cast< Size >( topo.outputs ), topo.mode, unaryop );
+		_evaluate_columns_batch( _column_pointers< ColIter >( columns ), firstw, nrows,
+			static_cast< Size >( topo.inputs ), static_cast< Size >( topo.hidden ),
+			static_cast< Size >( topo.outputs ), topo.skip && topo.hidden > 0, hiddenop,
+			ws, rowop );
+		return rowop.result;
+	}
+
+	//! Evaluate artificial neural network outputs for a column-major input
+	//! matrix
+	//!
+	//! @param firstx   start of input matrix
+	//! @param colstride distance between the starts of consecutive input
+	//!                 columns
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param topo     network topology
+	//! @return iterator marking end of result sequence
+	//!
+	//! As evaluate_neural_network_columns, row @a r's input @a k read from
+	//! @p firstx [ @a k * @p colstride + @a r ], the layout of an R matrix
+	//! or data frame of numeric columns.
+	template< typename RandIter1, typename RandIter2, typename OutIter, typename Size >
+	OutIter
+	evaluate_neural_network_column_major( RandIter1 firstx, Size colstride, RandIter2 firstw,
+		OutIter result, Size nrows, const nnet_topology& topo )
+	{
+		typedef typename std::iterator_traits<OutIter>::value_type VT;
+		return evaluate_neural_network_column_major( firstx, colstride, firstw, result, nrows,
+			topo, logistic_output< VT >(), logistic_output< VT >(), _thread_workspace< VT >() );
+	}
+
+	//! Evaluate artificial neural network outputs for a column-major input
+	//! matrix with a hidden-layer transfer function using a workspace
+	//!
+	//! @param firstx   start of input matrix
+	//! @param colstride distance between the starts of consecutive input
+	//!                 columns
+	//! @param firstw   start of weights sequence, R nnet$wts
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param topo     network topology
+	//! @param unaryop  output transform for units in the output_default
+	//!                 and output_logistic modes
+	//! @param hiddenop transfer function for hidden-layer units
+	//! @param ws       scratch storage for the evaluation
+	//! @return iterator marking end of result sequence
+	template< typename RandIter1, typename RandIter2, typename OutIter, typename Size,
+		typename UnaryOp, typename HiddenOp >
+	OutIter
+	evaluate_neural_network_column_major( RandIter1 firstx, Size colstride, RandIter2 firstw,
+		OutIter result, Size nrows, const nnet_topology& topo, UnaryOp unaryop,
+		HiddenOp hiddenop,
+		nnet_workspace< typename std::iterator_traits<OutIter>::value_type >& ws )
+	{
+		_output_rows< OutIter, Size, UnaryOp > rowop( result,
+			static_cast< Size >( topo.outputs ), topo.mode, unaryop );
+		_evaluate_columns_batch( _column_major< RandIter1, Size >( firstx, colstride ), firstw,
+			nrows, static_cast< Size >( topo.inputs ), static_cast< Size >( topo.hidden ),
+			static_cast< Size >( topo.outputs ), topo.skip && topo.hidden > 0, hiddenop,
+			ws, rowop );
+		return rowop.result;
+	}
+
+	//! artificial neural network
+	//!
+	//! @tparam UnaryOp   output transform for a single output-layer unit,
+	//!                   or for each unit in the output_logistic mode
+	//! @tparam HiddenOp  transfer function for hidden-layer units, e.g.
+	//!                   fast_logistic_output
+	template < typename InIter, typename InIterWt, typename OutIter, typename Size,
+		typename UnaryOp = logistic_output< typename std::iterator_traits<OutIter>::value_type >,
+		typename HiddenOp = logistic_output< typename std::iterator_traits<OutIter>::value_type > >
+	class neural_network
+	{
+	public:
+		typedef typename std::iterator_traits<OutIter>::value_type value_type;
+		typedef nnet_workspace< value_type > workspace_type;
 
 		//! constructor, artificial neural network
 		//!
-		neural_network( int n, int m, int k, InIterWt wts )
+		neural_network( int n, int m, int k, InIterWt wts, UnaryOp unaryop = UnaryOp(),
+			HiddenOp hiddenop = HiddenOp() )
 		: input_count( n ),
 		  hidden_count( m ),
 		  output_count( k ),
-		  weights( wts )
+		  skip_layer( false ),
+		  mode( output_default ),
+		  weights( wts ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop ),
+		  stats( 0 )
+		{
+		}
+
+		//! constructor, artificial neural network with a topology
+		//!
+		//! @param topo     units, skip-layer connections and output transform
+		//! @param wts      start of weights sequence, R nnet$wts
+		//!
+		//! Example, a model fitted by nnet( ..., skip=TRUE, linout=TRUE )
+		//! @code
+		//! {
+		//! 	nnet_type nnet( gamboge::nnet_topology( nn$n[1], nn$n[2], nn$n[3],
+		//! 		gamboge::output_linear, true ), &(wts[0]) );
+		//! 	nnet.evaluate( nn_out, nn_in );
+		//! }
+		//! @endcode
+		neural_network( const nnet_topology& topo, InIterWt wts, UnaryOp unaryop = UnaryOp(),
+			HiddenOp hiddenop = HiddenOp() )
+		: input_count( static_cast< Size >( topo.inputs ) ),
+		  hidden_count( static_cast< Size >( topo.hidden ) ),
+		  output_count( static_cast< Size >( topo.outputs ) ),
+		  skip_layer( topo.skip && topo.hidden > 0 ),
+		  mode( topo.mode ),
+		  weights( wts ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop ),
+		  stats( 0 )
 		{
 		}
 
@@ -327,16 +1790,371 @@ namespace gamboge
 		//! @endcode
 		OutIter evaluate( OutIter result, InIter values ) const
 		{
-			return evaluate_neural_network( values, weights, result,
-				input_count, hidden_count, output_count );
+			return evaluate( result, values, _thread_workspace< value_type >() );
+		}
+
+		//! Evaluate artificial neural network outputs using a workspace
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @param ws       scratch storage for the evaluation
+		//! @return iterator marking end of result sequence
+		//!
+		//! Without a workspace argument evaluate uses storage owned by the
+		//! calling thread; either way repeated evaluations do not allocate.
+		OutIter evaluate( OutIter result, InIter values, workspace_type& ws ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			return _evaluate_neural_network( values, weights, result, input_count,
+				hidden_count, output_count, skip_layer, mode, unaryop, hiddenop, ws );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @return iterator marking end of result sequence
+		//!
+		//! The outputs for each row are written consecutively,
+		//! see evaluate_neural_network_batch.
+		OutIter evaluate_batch( OutIter result, InIter values, Size nrows, Size stride ) const
+		{
+			return evaluate_batch( result, values, nrows, stride,
+				_thread_workspace< value_type >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return iterator marking end of result sequence
+		OutIter evaluate_batch( OutIter result, InIter values, Size nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, input_count );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//! using a workspace
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return iterator marking end of result sequence
+		OutIter evaluate_batch( OutIter result, InIter values, Size nrows, Size stride,
+			workspace_type& ws ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			return _evaluate_neural_network_batch( values, stride, weights, result, nrows,
+				input_count, hidden_count, output_count, skip_layer, mode, unaryop, hiddenop, ws );
+		}
+
+		//! Evaluate artificial neural network outputs and their
+		//! derivatives with respect to the inputs
+		//!
+		//! @param result   start of output sequence
+		//! @param jacobian start of Jacobian matrix, @a ny rows of @a nx
+		//!                 values, row @a o holding d( output @a o ) / d( input @a k )
+		//! @param values   start of input value sequence
+		//! @return iterator marking end of result sequence
+		//!
+		//! A forward pass followed by an analytic backward pass through the
+		//! hidden layer and the output transform: logistic, linear or
+		//! softmax. The hidden-layer transfer function and a single-unit
+		//! output transform are differentiated as the logistic function
+		//! unless they are linear_output; the fast and table
+		//! approximations of the logistic function use its slope. The
+		//! weights iterator must be random access.
+		//!
+		//! Example
+		//! @code
+		//! {
+		//! 	double nn_out[ out_count ];
+		//! 	double jac[ out_count * in_count ];
+		//! 	example_nnet.evaluate_with_jacobian( nn_out, jac, nn_in );
+		//! }
+		//! @endcode
+		template< typename OutIter2 >
+		OutIter evaluate_with_jacobian( OutIter result, OutIter2 jacobian, InIter values ) const
+		{
+			return evaluate_with_jacobian( result, jacobian, values,
+				_thread_workspace< value_type >() );
+		}
+
+		//! Evaluate artificial neural network outputs and their
+		//! derivatives with respect to the inputs using a workspace
+		//!
+		//! @param result   start of output sequence
+		//! @param jacobian start of Jacobian matrix, see above
+		//! @param values   start of input value sequence
+		//! @param ws       scratch storage for the evaluation
+		//! @return iterator marking end of result sequence, or @p result
+		//!         if the workspace could not be reserved
+		//!
+		//! The backward pass uses no storage beyond the workspace used
+		//! by evaluate and the caller's Jacobian.
+		template< typename OutIter2 >
+		OutIter evaluate_with_jacobian( OutIter result, OutIter2 jacobian, InIter values,
+			workspace_type& ws ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			if ( !_evaluate_with_jacobian( values, weights, result, jacobian, input_count,
+				hidden_count, output_count, skip_layer, mode, unaryop, hiddenop, ws ) )
+			{
+				return result;
+			}
+			return result + output_count;
+		}
+
+		//! Evaluate artificial neural network outputs and Jacobians for
+		//! many input rows using a workspace
+		//!
+		//! @param result   start of output matrix
+		//! @param jacobian start of Jacobian sequence, @a ny * @a nx values
+		//!                 per row
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return iterator marking end of result sequence; if the
+		//!         workspace could not be reserved, the start of the first
+		//!         row not evaluated
+		template< typename OutIter2 >
+		OutIter evaluate_batch_with_jacobian( OutIter result, OutIter2 jacobian, InIter values,
+			Size nrows, Size stride, workspace_type& ws ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			const Size nj = output_count * input_count;
+			for ( Size r = 0; r < nrows; ++r, values += stride, result += output_count,
+				jacobian += nj )
+			{
+				if ( !_evaluate_with_jacobian( values, weights, result, jacobian, input_count,
+					hidden_count, output_count, skip_layer, mode, unaryop, hiddenop, ws ) )
+				{
+					break;
+				}
+			}
+			return result;
+		}
+
+		//! Evaluate artificial neural network outputs and Jacobians for
+		//! many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param jacobian start of Jacobian sequence, @a ny * @a nx values
+		//!                 per row
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return iterator marking end of result sequence
+		template< typename OutIter2 >
+		OutIter evaluate_batch_with_jacobian( OutIter result, OutIter2 jacobian, InIter values,
+			Size nrows ) const
+		{
+			return evaluate_batch_with_jacobian( result, jacobian, values, nrows, input_count,
+				_thread_workspace< value_type >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//! held as columns
+		//!
+		//! @param result   start of output matrix
+		//! @param columns  start of a sequence of column iterators, one
+		//!                 per input
+		//! @param nrows    input row count
+		//! @return iterator marking end of result sequence
+		//!
+		//! See evaluate_neural_network_columns.
+		template< typename ColIter >
+		OutIter evaluate_columns( OutIter result, ColIter columns, Size nrows ) const
+		{
+			return evaluate_columns( result, columns, nrows, _thread_workspace< value_type >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//! held as columns using a workspace
+		//!
+		//! @param result   start of output matrix
+		//! @param columns  start of a sequence of column iterators, one
+		//!                 per input
+		//! @param nrows    input row count
+		//! @param ws       scratch storage for the evaluation
+		//! @return iterator marking end of result sequence
+		template< typename ColIter >
+		OutIter evaluate_columns( OutIter result, ColIter columns, Size nrows,
+			workspace_type& ws ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			return evaluate_neural_network_columns( columns, weights, result, nrows,
+				topology( ), unaryop, hiddenop, ws );
+		}
+
+		//! Evaluate artificial neural network outputs for a column-major
+		//! input matrix
+		//!
+		//! @param result    start of output matrix
+		//! @param values    start of input matrix
+		//! @param nrows     input row count
+		//! @param colstride distance between the starts of consecutive
+		//!                  input columns
+		//! @return iterator marking end of result sequence
+		//!
+		//! See evaluate_neural_network_column_major.
+		OutIter evaluate_column_major( OutIter result, InIter values, Size nrows,
+			Size colstride ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			return evaluate_neural_network_column_major( values, colstride, weights, result,
+				nrows, topology( ), unaryop, hiddenop, _thread_workspace< value_type >() );
+		}
+
+		//! Classify an input row
+		//!
+		//! @param values     start of input value sequence
+		//! @param threshold  output above which a single-output network
+		//!                   chooses class 1
+		//! @return class index
+		//!
+		//! See classify_batch.
+		Size classify( InIter values, value_type threshold = static_cast< value_type >( 0.5 ) ) const
+		{
+			Size c = 0;
+			classify_batch( &c, values, 1, input_count, _thread_workspace< value_type >(),
+				threshold );
+			return c;
+		}
+
+		//! Classify many input rows
+		//!
+		//! @param result     start of class index sequence, one per row
+		//! @param values     start of input matrix, rows stored consecutively
+		//! @param nrows      input row count
+		//! @param threshold  output above which a single-output network
+		//!                   chooses class 1
+		//! @return iterator marking end of result sequence
+		//!
+		//! See classify_batch below.
+		template< typename OutIdxIter >
+		OutIdxIter classify_batch( OutIdxIter result, InIter values, Size nrows,
+			value_type threshold = static_cast< value_type >( 0.5 ) ) const
+		{
+			return classify_batch( result, values, nrows, input_count,
+				_thread_workspace< value_type >(), threshold );
+		}
+
+		//! Classify many input rows using a workspace
+		//!
+		//! @param result     start of class index sequence, one per row
+		//! @param values     start of input matrix
+		//! @param nrows      input row count
+		//! @param stride     distance between the starts of consecutive input rows
+		//! @param ws         scratch storage for the evaluation
+		//! @param threshold  output above which a single-output network
+		//!                   chooses class 1
+		//! @return iterator marking end of result sequence
+		//!
+		//! Class indices are taken from the output-layer linear outputs,
+		//! without normalizing them. For multiple outputs the class is the
+		//! index of the largest output, the one the softmax operator would
+		//! give the largest probability; the lowest such index when several
+		//! are equal. For a single output the class is 1 if the linear
+		//! output exceeds the logit of @p threshold, otherwise 0, the same
+		//! decision as comparing the logistic_output of the unit with
+		//! @p threshold; no exponential is computed. The single-output
+		//! decision assumes the logistic output transform, except in the
+		//! output_linear mode, where the output is compared with
+		//! @p threshold itself.
+		template< typename OutIdxIter >
+		OutIdxIter classify_batch( OutIdxIter result, InIter values, Size nrows, Size stride,
+			workspace_type& ws, value_type threshold = static_cast< value_type >( 0.5 ) ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			const value_type threshold_logit = ( mode == output_linear ) ? threshold
+				: std::log( threshold ) - std::log( static_cast< value_type >( 1 ) - threshold );
+			_class_rows< OutIdxIter, Size, value_type > rowop( result, output_count,
+				threshold_logit );
+			_evaluate_linear_batch( values, stride, weights, nrows, input_count,
+				hidden_count, output_count, skip_layer, hiddenop, ws, rowop );
+			return rowop.result;
+		}
+
+		//! Rank the classes of many input rows
+		//!
+		//! @param result   start of class index matrix, min( @p k, @a c )
+		//!                 indices per row
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @param k        classes to report for each row
+		//! @return iterator marking end of result sequence
+		//!
+		//! Writes, for each row, the indices of the @p k classes with the
+		//! largest output-layer linear outputs, best first, where @a c is
+		//! the class count: the output count, or 2 for a single-output
+		//! network, whose classes 0 and 1 are ordered by the sign of the
+		//! logit. Classes with equal outputs are ordered by index. The
+		//! outputs are not normalized.
+		template< typename OutIdxIter >
+		OutIdxIter classify_top_k( OutIdxIter result, InIter values, Size nrows, Size k ) const
+		{
+			_GAMBOGE_NNET_STATS_MODEL( stats );
+			_top_k_rows< OutIdxIter, Size > rowop( result, output_count, k );
+			_evaluate_linear_batch( values, input_count, weights, nrows, input_count,
+				hidden_count, output_count, skip_layer, hiddenop, _thread_workspace< value_type >(),
+				rowop );
+			return rowop.result;
+		}
+
+		//! @return input count
+		Size inputs( ) const
+		{
+			return input_count;
+		}
+
+		//! @return hidden-layer unit count
+		Size hidden( ) const
+		{
+			return hidden_count;
+		}
+
+		//! @return output count
+		Size outputs( ) const
+		{
+			return output_count;
+		}
+
+		//! @return network topology
+		nnet_topology topology( ) const
+		{
+			return nnet_topology( input_count, hidden_count, output_count, mode, skip_layer );
+		}
+
+		//! Record this network's evaluations to counters
+		//!
+		//! @param counters counters for this model, or 0 to record to those
+		//!                 of the free evaluation functions
+		//!
+		//! Evaluations in translation units compiled without
+		//! GAMBOGE_NNET_STATS record nothing, see gamboge/nnet_stats.h.
+		void set_stats( nnet_stats* counters )
+		{
+			stats = counters;
 		}
 
 	private:
 		Size input_count;
 		Size hidden_count;
 		Size output_count;
+		bool skip_layer;
+		output_mode mode;
 		InIterWt weights;
+		UnaryOp unaryop;
+		HiddenOp hiddenop;
+		nnet_stats* stats;
 	};
+	}   // inline namespace
 }
 
 #endif
@@ -0,0 +1,134 @@
+/*! @file gamboge/nnet_c.h
+ *  gamboge neural network C interface, exported by libgamboge_nnet
+ *
+ *  A stable C ABI to the header-only C++ library for callers in other
+ *  languages, such as the .NET NativeNeuralNetwork class. Networks hold
+ *  float weights and are opaque handles. Functions return
+ *  GAMBOGE_NNET_OK or a negative gamboge_nnet_status code and do not
+ *  throw. A network may be evaluated by several threads at once; each
+ *  thread uses its own workspace.
+ *
+ *  Example
+ *  @code
+ *  {
+ *  	gamboge_nnet* nnet = 0;
+ *  	if ( gamboge_nnet_load( "iris.gnnm", &nnet ) == GAMBOGE_NNET_OK )
+ *  	{
+ *  		gamboge_nnet_evaluate_batch( nnet, values, row_count * 4, row_count,
+ *  			outputs, row_count * 3 );
+ *  		gamboge_nnet_free( nnet );
+ *  	}
+ *  }
+ *  @endcode
+ */
+
+#ifndef _GAMBOGE_NNET_C_H
+#define _GAMBOGE_NNET_C_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined( _WIN32 )
+#define GAMBOGE_NNET_API __declspec( dllexport )
+#elif defined( __GNUC__ )
+#define GAMBOGE_NNET_API __attribute__(( visibility( "default" ) ))
+#else
+#define GAMBOGE_NNET_API
+#endif
+
+/*! version of the interface; incremented when a function's signature or
+ *  behavior changes incompatibly */
+#define GAMBOGE_NNET_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! neural network handle */
+typedef struct gamboge_nnet gamboge_nnet;
+
+/*! status codes */
+enum gamboge_nnet_status
+{
+	GAMBOGE_NNET_OK = 0,                    /*!< success */
+	GAMBOGE_NNET_INVALID_ARGUMENT = -1,     /*!< null pointer, bad topology or short buffer */
+	GAMBOGE_NNET_OUT_OF_MEMORY = -2,        /*!< storage could not be allocated */
+	GAMBOGE_NNET_OPEN_FAILED = -3,          /*!< model file could not be opened */
+	GAMBOGE_NNET_BAD_MODEL = -4             /*!< model file rejected, see mapped_model::open */
+};
+
+/*! output-layer transforms, as gamboge::output_mode */
+enum gamboge_nnet_output
+{
+	GAMBOGE_NNET_OUTPUT_DEFAULT = 0,        /*!< logistic for one unit, softmax for several */
+	GAMBOGE_NNET_OUTPUT_LOGISTIC = 1,       /*!< logistic for each unit */
+	GAMBOGE_NNET_OUTPUT_LINEAR = 2,         /*!< linear output units */
+	GAMBOGE_NNET_OUTPUT_SOFTMAX = 3         /*!< softmax over the units */
+};
+
+/*! @return GAMBOGE_NNET_ABI_VERSION of the library */
+GAMBOGE_NNET_API uint32_t gamboge_nnet_abi_version( void );
+
+/*! Create a network from weights
+ *
+ *  @param nx        input count
+ *  @param nh        hidden-layer count
+ *  @param ny        output count
+ *  @param output    output transform, a gamboge_nnet_output value
+ *  @param skip      nonzero for skip-layer connections
+ *  @param wts       weights, R nnet$wts order, copied
+ *  @param wts_count weights count, see gamboge::nnet_topology::weight_count
+ *  @param nnet      receives the new network
+ *  @return status */
+GAMBOGE_NNET_API int gamboge_nnet_create( int32_t nx, int32_t nh, int32_t ny, int32_t output,
+	int32_t skip, const float* wts, size_t wts_count, gamboge_nnet** nnet );
+
+/*! Create a network from a model file, see gamboge/model_file.h
+ *
+ *  @param path      file name
+ *  @param nnet      receives the new network
+ *  @return status; double-precision weights are converted to float */
+GAMBOGE_NNET_API int gamboge_nnet_load( const char* path, gamboge_nnet** nnet );
+
+/*! Destroy a network; a null handle is ignored */
+GAMBOGE_NNET_API void gamboge_nnet_free( gamboge_nnet* nnet );
+
+/*! @return input count, or 0 for a null handle */
+GAMBOGE_NNET_API int32_t gamboge_nnet_inputs( const gamboge_nnet* nnet );
+
+/*! @return hidden-layer count, or 0 for a null handle */
+GAMBOGE_NNET_API int32_t gamboge_nnet_hidden( const gamboge_nnet* nnet );
+
+/*! @return output count, or 0 for a null handle */
+GAMBOGE_NNET_API int32_t gamboge_nnet_outputs( const gamboge_nnet* nnet );
+
+/*! Evaluate one input row
+ *
+ *  @param nnet         network
+ *  @param values       input row
+ *  @param values_count length of @p values, at least the input count
+ *  @param result       receives the outputs
+ *  @param result_count length of @p result, at least the output count
+ *  @return status */
+GAMBOGE_NNET_API int gamboge_nnet_evaluate( const gamboge_nnet* nnet, const float* values,
+	size_t values_count, float* result, size_t result_count );
+
+/*! Evaluate many input rows, see gamboge::evaluate_neural_network_batch
+ *
+ *  @param nnet         network
+ *  @param values       input rows stored consecutively
+ *  @param values_count length of @p values, at least @p nrows times the
+ *                      input count
+ *  @param nrows        row count
+ *  @param result       receives the outputs, rows stored consecutively
+ *  @param result_count length of @p result, at least @p nrows times the
+ *                      output count
+ *  @return status */
+GAMBOGE_NNET_API int gamboge_nnet_evaluate_batch( const gamboge_nnet* nnet, const float* values,
+	size_t values_count, size_t nrows, float* result, size_t result_count );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1165 @@
+//! @file gamboge/nnet_simd.h
+//! gamboge neural network vectorized kernels with run-time CPU dispatch
+
+#ifndef _GAMBOGE_NNET_SIMD_H
+#define _GAMBOGE_NNET_SIMD_H 1
+
+#include "gamboge/nnet.h"
+#include <cstddef>
+#include <numeric>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define GAMBOGE_NNET_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace gamboge
+{
+	//! instruction set levels for vectorized kernels, in increasing order
+	enum simd_level
+	{
+		simd_scalar = 0,   //!< portable scalar code
+		simd_sse2,         //!< SSE2, 128-bit vectors
+		simd_avx2,         //!< AVX2 and FMA, 256-bit vectors
+		simd_avx512        //!< AVX-512F, 512-bit vectors
+	};
+
+	//! kernel dispatch table for one value type
+	//!
+	//! @par layer
+	//! computes @a nunits unit linear outputs
+	//! @a out[u] = @a bias + &lang; @a x, @a w &rang; where the weights of
+	//! unit @a u are the block [ @a w + @a u * ( 1 + @a nin ),
+	//! @a w + ( @a u + 1 ) * ( 1 + @a nin ) ) holding the unit's bias followed
+	//! by @a nin input weights, the layout of evaluate_neural_network.
+	//! Several units are computed together so each input vector load is
+	//! shared by their dot products.
+	//!
+	//! @par logistic
+	//! applies the logistic function in place to @a n values.
+	//!
+	//! @par panel_layer
+	//! computes the linear outputs of @a npanels panels of
+	//! simd_panel_width units each, from weights packed by unit panel:
+	//! the panel weights are @a nin groups, group @a k holding the weights
+	//! of input @a k for each unit of the panel. @a bias holds one bias for
+	//! each unit of each panel. An input value is broadcast and multiplied
+	//! into all units of a panel at once, so the units are vectorized
+	//! rather than the inputs.
+	template< typename T >
+	struct simd_kernels
+	{
+		void (*layer)( const T* w, const T* x, std::size_t nin, std::size_t nunits, T* out );
+		void (*logistic)( T* y, std::size_t n );
+		void (*panel_layer)( const T* pw, const T* bias, const T* x, std::size_t nin,
+			std::size_t npanels, T* out );
+		simd_level level;
+	};
+
+	//! bytes in a panel of packed unit weights, the width of the widest
+	//! vector kernels
+	const std::size_t simd_panel_bytes = 64;
+
+	//! units in a panel of packed unit weights
+	template< typename T >
+	struct simd_panel_width
+	{
+		static const std::size_t value = simd_panel_bytes / sizeof( T );
+	};
+
+	//! @cond
+	//! portable kernels
+	template< typename T >
+	void
+	_layer_scalar( const T* w, const T* x, std::size_t nin, std::size_t nunits, T* out )
+	{
+		for ( std::size_t u = 0; u < nunits; ++u )
+		{
+			out[u] = std::inner_product( w + 1, w + 1 + nin, x, w[0] );
+			w += 1 + nin;
+		}
+	}
+
+	template< typename T >
+	void
+	_logistic_scalar( T* y, std::size_t n )
+	{
+		for ( std::size_t k = 0; k < n; ++k )
+		{
+			y[k] = logistic_output< T >()( y[k] );
+		}
+	}
+
+	template< typename T >
+	void
+	_panel_layer_scalar( const T* pw, const T* bias, const T* x, std::size_t nin,
+		std::size_t npanels, T* out )
+	{
+		const std::size_t pwidth = simd_panel_width< T >::value;
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			T acc[ simd_panel_width< T >::value ];
+			std::copy( bias, bias + pwidth, acc );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				const T xk = x[k];
+				for ( std::size_t j = 0; j < pwidth; ++j )
+				{
+					acc[j] += xk * pw[j];
+				}
+				pw += pwidth;
+			}
+			out = std::copy( acc, acc + pwidth, out );
+			bias += pwidth;
+		}
+	}
+
+#ifdef GAMBOGE_NNET_X86_SIMD
+	// The vectorized exponential reduces x = n ln2 + r with |r| <= ln2 / 2,
+	// evaluates a Taylor polynomial for exp( r ) and scales by 2^n through
+	// the exponent bits. Degree 7 (float) and 13 (double) polynomials keep
+	// the truncation error below the type's rounding error. Arguments are
+	// clamped to the range where 2^n is a normal number.
+
+	//! SSE2 kernels
+
+	__attribute__(( target( "sse2" ) ))
+	inline __m128
+	_exp_sse2( __m128 x )
+	{
+		static const float c[] = { 1.0F / 5040, 1.0F / 720, 1.0F / 120, 1.0F / 24,
+			1.0F / 6, 1.0F / 2, 1.0F, 1.0F };
+		x = _mm_min_ps( _mm_max_ps( x, _mm_set1_ps( -87.0F ) ), _mm_set1_ps( 88.0F ) );
+		__m128i n = _mm_cvtps_epi32( _mm_mul_ps( x, _mm_set1_ps( 1.44269504F ) ) );
+		__m128 fn = _mm_cvtepi32_ps( n );
+		__m128 r = _mm_sub_ps( x, _mm_mul_ps( fn, _mm_set1_ps( 0.693359375F ) ) );
+		r = _mm_sub_ps( r, _mm_mul_ps( fn, _mm_set1_ps( -2.12194440E-4F ) ) );
+		__m128 p = _mm_set1_ps( c[0] );
+		for ( int i = 1; i < 8; ++i )
+		{
+			p = _mm_add_ps( _mm_mul_ps( p, r ), _mm_set1_ps( c[i] ) );
+		}
+		__m128i e = _mm_slli_epi32( _mm_add_epi32( n, _mm_set1_epi32( 127 ) ), 23 );
+		return _mm_mul_ps( p, _mm_castsi128_ps( e ) );
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline __m128d
+	_exp_sse2( __m128d x )
+	{
+		static const double c[] = { 1.0 / 6227020800.0, 1.0 / 479001600.0,
+			1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+			1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0,
+			1.0 / 2.0, 1.0, 1.0 };
+		x = _mm_min_pd( _mm_max_pd( x, _mm_set1_pd( -708.0 ) ), _mm_set1_pd( 709.0 ) );
+		__m128i n = _mm_cvtpd_epi32( _mm_mul_pd( x, _mm_set1_pd( 1.4426950408889634 ) ) );
+		__m128d fn = _mm_cvtepi32_pd( n );
+		__m128d r = _mm_sub_pd( x, _mm_mul_pd( fn, _mm_set1_pd( 6.93145751953125E-1 ) ) );
+		r = _mm_sub_pd( r, _mm_mul_pd( fn, _mm_set1_pd( 1.42860682030941723212E-6 ) ) );
+		__m128d p = _mm_set1_pd( c[0] );
+		for ( int i = 1; i < 14; ++i )
+		{
+			p = _mm_add_pd( _mm_mul_pd( p, r ), _mm_set1_pd( c[i] ) );
+		}
+		__m128i e = _mm_unpacklo_epi32( _mm_add_epi32( n, _mm_set1_epi32( 1023 ) ),
+			_mm_setzero_si128( ) );
+		return _mm_mul_pd( p, _mm_castsi128_pd( _mm_slli_epi64( e, 52 ) ) );
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline float
+	_hsum_sse2( __m128 v )
+	{
+		v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+		v = _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+		return _mm_cvtss_f32( v );
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline double
+	_hsum_sse2( __m128d v )
+	{
+		return _mm_cvtsd_f64( _mm_add_sd( v, _mm_unpackhi_pd( v, v ) ) );
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline void
+	_layer_sse2( const float* w, const float* x, std::size_t nin, std::size_t nunits, float* out )
+	{
+		const std::size_t ws = 1 + nin;
+		std::size_t u = 0;
+		for ( ; u + 4 <= nunits; u += 4 )
+		{
+			const float* w0 = w + u * ws + 1;
+			const float* w1 = w0 + ws;
+			const float* w2 = w1 + ws;
+			const float* w3 = w2 + ws;
+			__m128 a0 = _mm_setzero_ps( ), a1 = a0, a2 = a0, a3 = a0;
+			std::size_t k = 0;
+			for ( ; k + 4 <= nin; k += 4 )
+			{
+				__m128 xv = _mm_loadu_ps( x + k );
+				a0 = _mm_add_ps( a0, _mm_mul_ps( _mm_loadu_ps( w0 + k ), xv ) );
+				a1 = _mm_add_ps( a1, _mm_mul_ps( _mm_loadu_ps( w1 + k ), xv ) );
+				a2 = _mm_add_ps( a2, _mm_mul_ps( _mm_loadu_ps( w2 + k ), xv ) );
+				a3 = _mm_add_ps( a3, _mm_mul_ps( _mm_loadu_ps( w3 + k ), xv ) );
+			}
+			float s0 = w0[-1] + _hsum_sse2( a0 ), s1 = w1[-1] + _hsum_sse2( a1 );
+			float s2 = w2[-1] + _hsum_sse2( a2 ), s3 = w3[-1] + _hsum_sse2( a3 );
+			for ( ; k < nin; ++k )
+			{
+				s0 += w0[k] * x[k];
+				s1 += w1[k] * x[k];
+				s2 += w2[k] * x[k];
+				s3 += w3[k] * x[k];
+			}
+			out[u] = s0;
+			out[u+1] = s1;
+			out[u+2] = s2;
+			out[u+3] = s3;
+		}
+		for ( ; u < nunits; ++u )
+		{
+			const float* wu = w + u * ws + 1;
+			__m128 a = _mm_setzero_ps( );
+			std::size_t k = 0;
+			for ( ; k + 4 <= nin; k += 4 )
+			{
+				a = _mm_add_ps( a, _mm_mul_ps( _mm_loadu_ps( wu + k ), _mm_loadu_ps( x + k ) ) );
+			}
+			float s = wu[-1] + _hsum_sse2( a );
+			for ( ; k < nin; ++k )
+			{
+				s += wu[k] * x[k];
+			}
+			out[u] = s;
+		}
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline void
+	_layer_sse2( const double* w, const double* x, std::size_t nin, std::size_t nunits, double* out )
+	{
+		const std::size_t ws = 1 + nin;
+		std::size_t u = 0;
+		for ( ; u + 4 <= nunits; u += 4 )
+		{
+			const double* w0 = w + u * ws + 1;
+			const double* w1 = w0 + ws;
+			const double* w2 = w1 + ws;
+			const double* w3 = w2 + ws;
+			__m128d a0 = _mm_setzero_pd( ), a1 = a0, a2 = a0, a3 = a0;
+			std::size_t k = 0;
+			for ( ; k + 2 <= nin; k += 2 )
+			{
+				__m128d xv = _mm_loadu_pd( x + k );
+				a0 = _mm_add_pd( a0, _mm_mul_pd( _mm_loadu_pd( w0 + k ), xv ) );
+				a1 = _mm_add_pd( a1, _mm_mul_pd( _mm_loadu_pd( w1 + k ), xv ) );
+				a2 = _mm_add_pd( a2, _mm_mul_pd( _mm_loadu_pd( w2 + k ), xv ) );
+				a3 = _mm_add_pd( a3, _mm_mul_pd( _mm_loadu_pd( w3 + k ), xv ) );
+			}
+			double s0 = w0[-1] + _hsum_sse2( a0 ), s1 = w1[-1] + _hsum_sse2( a1 );
+			double s2 = w2[-1] + _hsum_sse2( a2 ), s3 = w3[-1] + _hsum_sse2( a3 );
+			for ( ; k < nin; ++k )
+			{
+				s0 += w0[k] * x[k];
+				s1 += w1[k] * x[k];
+				s2 += w2[k] * x[k];
+				s3 += w3[k] * x[k];
+			}
+			out[u] = s0;
+			out[u+1] = s1;
+			out[u+2] = s2;
+			out[u+3] = s3;
+		}
+		for ( ; u < nunits; ++u )
+		{
+			const double* wu = w + u * ws + 1;
+			__m128d a = _mm_setzero_pd( );
+			std::size_t k = 0;
+			for ( ; k + 2 <= nin; k += 2 )
+			{
+				a = _mm_add_pd( a, _mm_mul_pd( _mm_loadu_pd( wu + k ), _mm_loadu_pd( x + k ) ) );
+			}
+			double s = wu[-1] + _hsum_sse2( a );
+			for ( ; k < nin; ++k )
+			{
+				s += wu[k] * x[k];
+			}
+			out[u] = s;
+		}
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline void
+	_logistic_sse2( float* y, std::size_t n )
+	{
+		const __m128 one = _mm_set1_ps( 1.0F );
+		std::size_t k = 0;
+		for ( ; k + 4 <= n; k += 4 )
+		{
+			__m128 e = _exp_sse2( _mm_sub_ps( _mm_setzero_ps( ), _mm_loadu_ps( y + k ) ) );
+			_mm_storeu_ps( y + k, _mm_div_ps( one, _mm_add_ps( one, e ) ) );
+		}
+		if ( k < n )
+		{
+			float tail[4] = { 0.0F, 0.0F, 0.0F, 0.0F };
+			std::copy( y + k, y + n, tail );
+			__m128 e = _exp_sse2( _mm_sub_ps( _mm_setzero_ps( ), _mm_loadu_ps( tail ) ) );
+			_mm_storeu_ps( tail, _mm_div_ps( one, _mm_add_ps( one, e ) ) );
+			std::copy( tail, tail + ( n - k ), y + k );
+		}
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline void
+	_logistic_sse2( double* y, std::size_t n )
+	{
+		const __m128d one = _mm_set1_pd( 1.0 );
+		std::size_t k = 0;
+		for ( ; k + 2 <= n; k += 2 )
+		{
+			__m128d e = _exp_sse2( _mm_sub_pd( _mm_setzero_pd( ), _mm_loadu_pd( y + k ) ) );
+			_mm_storeu_pd( y + k, _mm_div_pd( one, _mm_add_pd( one, e ) ) );
+		}
+		if ( k < n )
+		{
+			__m128d e = _exp_sse2( _mm_sub_pd( _mm_setzero_pd( ), _mm_load_sd( y + k ) ) );
+			_mm_store_sd( y + k, _mm_div_pd( one, _mm_add_pd( one, e ) ) );
+		}
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline void
+	_panel_layer_sse2( const float* pw, const float* bias, const float* x, std::size_t nin,
+		std::size_t npanels, float* out )
+	{
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			__m128 a0 = _mm_loadu_ps( bias );
+			__m128 a1 = _mm_loadu_ps( bias + 4 );
+			__m128 a2 = _mm_loadu_ps( bias + 8 );
+			__m128 a3 = _mm_loadu_ps( bias + 12 );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				__m128 xv = _mm_set1_ps( x[k] );
+				a0 = _mm_add_ps( a0, _mm_mul_ps( xv, _mm_loadu_ps( pw ) ) );
+				a1 = _mm_add_ps( a1, _mm_mul_ps( xv, _mm_loadu_ps( pw + 4 ) ) );
+				a2 = _mm_add_ps( a2, _mm_mul_ps( xv, _mm_loadu_ps( pw + 8 ) ) );
+				a3 = _mm_add_ps( a3, _mm_mul_ps( xv, _mm_loadu_ps( pw + 12 ) ) );
+				pw += 16;
+			}
+			_mm_storeu_ps( out, a0 );
+			_mm_storeu_ps( out + 4, a1 );
+			_mm_storeu_ps( out + 8, a2 );
+			_mm_storeu_ps( out + 12, a3 );
+			bias += 16;
+			out += 16;
+		}
+	}
+
+	__attribute__(( target( "sse2" ) ))
+	inline void
+	_panel_layer_sse2( const double* pw, const double* bias, const double* x, std::size_t nin,
+		std::size_t npanels, double* out )
+	{
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			__m128d a0 = _mm_loadu_pd( bias );
+			__m128d a1 = _mm_loadu_pd( bias + 2 );
+			__m128d a2 = _mm_loadu_pd( bias + 4 );
+			__m128d a3 = _mm_loadu_pd( bias + 6 );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				__m128d xv = _mm_set1_pd( x[k] );
+				a0 = _mm_add_pd( a0, _mm_mul_pd( xv, _mm_loadu_pd( pw ) ) );
+				a1 = _mm_add_pd( a1, _mm_mul_pd( xv, _mm_loadu_pd( pw + 2 ) ) );
+				a2 = _mm_add_pd( a2, _mm_mul_pd( xv, _mm_loadu_pd( pw + 4 ) ) );
+				a3 = _mm_add_pd( a3, _mm_mul_pd( xv, _mm_loadu_pd( pw + 6 ) ) );
+				pw += 8;
+			}
+			_mm_storeu_pd( out, a0 );
+			_mm_storeu_pd( out + 2, a1 );
+			_mm_storeu_pd( out + 4, a2 );
+			_mm_storeu_pd( out + 6, a3 );
+			bias += 8;
+			out += 8;
+		}
+	}
+
+	//! AVX2 and FMA kernels
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline __m256
+	_exp_avx2( __m256 x )
+	{
+		static const float c[] = { 1.0F / 5040, 1.0F / 720, 1.0F / 120, 1.0F / 24,
+			1.0F / 6, 1.0F / 2, 1.0F, 1.0F };
+		x = _mm256_min_ps( _mm256_max_ps( x, _mm256_set1_ps( -87.0F ) ), _mm256_set1_ps( 88.0F ) );
+		__m256 fn = _mm256_round_ps( _mm256_mul_ps( x, _mm256_set1_ps( 1.44269504F ) ),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+		__m256 r = _mm256_fnmadd_ps( fn, _mm256_set1_ps( 0.693359375F ), x );
+		r = _mm256_fnmadd_ps( fn, _mm256_set1_ps( -2.12194440E-4F ), r );
+		__m256 p = _mm256_set1_ps( c[0] );
+		for ( int i = 1; i < 8; ++i )
+		{
+			p = _mm256_fmadd_ps( p, r, _mm256_set1_ps( c[i] ) );
+		}
+		__m256i e = _mm256_slli_epi32( _mm256_add_epi32( _mm256_cvtps_epi32( fn ),
+			_mm256_set1_epi32( 127 ) ), 23 );
+		return _mm256_mul_ps( p, _mm256_castsi256_ps( e ) );
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline __m256d
+	_exp_avx2( __m256d x )
+	{
+		static const double c[] = { 1.0 / 6227020800.0, 1.0 / 479001600.0,
+			1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+			1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0,
+			1.0 / 2.0, 1.0, 1.0 };
+		x = _mm256_min_pd( _mm256_max_pd( x, _mm256_set1_pd( -708.0 ) ), _mm256_set1_pd( 709.0 ) );
+		__m256d fn = _mm256_round_pd( _mm256_mul_pd( x, _mm256_set1_pd( 1.4426950408889634 ) ),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+		__m256d r = _mm256_fnmadd_pd( fn, _mm256_set1_pd( 6.93145751953125E-1 ), x );
+		r = _mm256_fnmadd_pd( fn, _mm256_set1_pd( 1.42860682030941723212E-6 ), r );
+		__m256d p = _mm256_set1_pd( c[0] );
+		for ( int i = 1; i < 14; ++i )
+		{
+			p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( c[i] ) );
+		}
+		__m256i e = _mm256_slli_epi64( _mm256_cvtepi32_epi64( _mm_add_epi32(
+			_mm256_cvtpd_epi32( fn ), _mm_set1_epi32( 1023 ) ) ), 52 );
+		return _mm256_mul_pd( p, _mm256_castsi256_pd( e ) );
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline float
+	_hsum_avx2( __m256 v )
+	{
+		__m128 s = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+		s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+		s = _mm_add_ss( s, _mm_movehdup_ps( s ) );
+		return _mm_cvtss_f32( s );
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline double
+	_hsum_avx2( __m256d v )
+	{
+		__m128d s = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+		return _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline void
+	_layer_avx2( const float* w, const float* x, std::size_t nin, std::size_t nunits, float* out )
+	{
+		const std::size_t ws = 1 + nin;
+		std::size_t u = 0;
+		for ( ; u + 4 <= nunits; u += 4 )
+		{
+			const float* w0 = w + u * ws + 1;
+			const float* w1 = w0 + ws;
+			const float* w2 = w1 + ws;
+			const float* w3 = w2 + ws;
+			__m256 a0 = _mm256_setzero_ps( ), a1 = a0, a2 = a0, a3 = a0;
+			std::size_t k = 0;
+			for ( ; k + 8 <= nin; k += 8 )
+			{
+				__m256 xv = _mm256_loadu_ps( x + k );
+				a0 = _mm256_fmadd_ps( _mm256_loadu_ps( w0 + k ), xv, a0 );
+				a1 = _mm256_fmadd_ps( _mm256_loadu_ps( w1 + k ), xv, a1 );
+				a2 = _mm256_fmadd_ps( _mm256_loadu_ps( w2 + k ), xv, a2 );
+				a3 = _mm256_fmadd_ps( _mm256_loadu_ps( w3 + k ), xv, a3 );
+			}
+			float s0 = w0[-1] + _hsum_avx2( a0 ), s1 = w1[-1] + _hsum_avx2( a1 );
+			float s2 = w2[-1] + _hsum_avx2( a2 ), s3 = w3[-1] + _hsum_avx2( a3 );
+			for ( ; k < nin; ++k )
+			{
+				s0 += w0[k] * x[k];
+				s1 += w1[k] * x[k];
+				s2 += w2[k] * x[k];
+				s3 += w3[k] * x[k];
+			}
+			out[u] = s0;
+			out[u+1] = s1;
+			out[u+2] = s2;
+			out[u+3] = s3;
+		}
+		for ( ; u < nunits; ++u )
+		{
+			const float* wu = w + u * ws + 1;
+			__m256 a = _mm256_setzero_ps( );
+			std::size_t k = 0;
+			for ( ; k + 8 <= nin; k += 8 )
+			{
+				a = _mm256_fmadd_ps( _mm256_loadu_ps( wu + k ), _mm256_loadu_ps( x + k ), a );
+			}
+			float s = wu[-1] + _hsum_avx2( a );
+			for ( ; k < nin; ++k )
+			{
+				s += wu[k] * x[k];
+			}
+			out[u] = s;
+		}
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline void
+	_layer_avx2( const double* w, const double* x, std::size_t nin, std::size_t nunits, double* out )
+	{
+		const std::size_t ws = 1 + nin;
+		std::size_t u = 0;
+		for ( ; u + 4 <= nunits; u += 4 )
+		{
+			const double* w0 = w + u * ws + 1;
+			const double* w1 = w0 + ws;
+			const double* w2 = w1 + ws;
+			const double* w3 = w2 + ws;
+			__m256d a0 = _mm256_setzero_pd( ), a1 = a0, a2 = a0, a3 = a0;
+			std::size_t k = 0;
+			for ( ; k + 4 <= nin; k += 4 )
+			{
+				__m256d xv = _mm256_loadu_pd( x + k );
+				a0 = _mm256_fmadd_pd( _mm256_loadu_pd( w0 + k ), xv, a0 );
+				a1 = _mm256_fmadd_pd( _mm256_loadu_pd( w1 + k ), xv, a1 );
+				a2 = _mm256_fmadd_pd( _mm256_loadu_pd( w2 + k ), xv, a2 );
+				a3 = _mm256_fmadd_pd( _mm256_loadu_pd( w3 + k ), xv, a3 );
+			}
+			double s0 = w0[-1] + _hsum_avx2( a0 ), s1 = w1[-1] + _hsum_avx2( a1 );
+			double s2 = w2[-1] + _hsum_avx2( a2 ), s3 = w3[-1] + _hsum_avx2( a3 );
+			for ( ; k < nin; ++k )
+			{
+				s0 += w0[k] * x[k];
+				s1 += w1[k] * x[k];
+				s2 += w2[k] * x[k];
+				s3 += w3[k] * x[k];
+			}
+			out[u] = s0;
+			out[u+1] = s1;
+			out[u+2] = s2;
+			out[u+3] = s3;
+		}
+		for ( ; u < nunits; ++u )
+		{
+			const double* wu = w + u * ws + 1;
+			__m256d a = _mm256_setzero_pd( );
+			std::size_t k = 0;
+			for ( ; k + 4 <= nin; k += 4 )
+			{
+				a = _mm256_fmadd_pd( _mm256_loadu_pd( wu + k ), _mm256_loadu_pd( x + k ), a );
+			}
+			double s = wu[-1] + _hsum_avx2( a );
+			for ( ; k < nin; ++k )
+			{
+				s += wu[k] * x[k];
+			}
+			out[u] = s;
+		}
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline void
+	_logistic_avx2( float* y, std::size_t n )
+	{
+		const __m256 one = _mm256_set1_ps( 1.0F );
+		std::size_t k = 0;
+		for ( ; k < n; k += 8 )
+		{
+			float tail[8];
+			float* p = y + k;
+			if ( k + 8 > n )
+			{
+				std::fill( tail, tail + 8, 0.0F );
+				std::copy( y + k, y + n, tail );
+				p = tail;
+			}
+			__m256 e = _exp_avx2( _mm256_sub_ps( _mm256_setzero_ps( ), _mm256_loadu_ps( p ) ) );
+			_mm256_storeu_ps( p, _mm256_div_ps( one, _mm256_add_ps( one, e ) ) );
+			if ( p == tail )
+			{
+				std::copy( tail, tail + ( n - k ), y + k );
+			}
+		}
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline void
+	_logistic_avx2( double* y, std::size_t n )
+	{
+		const __m256d one = _mm256_set1_pd( 1.0 );
+		std::size_t k = 0;
+		for ( ; k < n; k += 4 )
+		{
+			double tail[4];
+			double* p = y + k;
+			if ( k + 4 > n )
+			{
+				std::fill( tail, tail + 4, 0.0 );
+				std::copy( y + k, y + n, tail );
+				p = tail;
+			}
+			__m256d e = _exp_avx2( _mm256_sub_pd( _mm256_setzero_pd( ), _mm256_loadu_pd( p ) ) );
+			_mm256_storeu_pd( p, _mm256_div_pd( one, _mm256_add_pd( one, e ) ) );
+			if ( p == tail )
+			{
+				std::copy( tail, tail + ( n - k ), y + k );
+			}
+		}
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline void
+	_panel_layer_avx2( const float* pw, const float* bias, const float* x, std::size_t nin,
+		std::size_t npanels, float* out )
+	{
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			__m256 a0 = _mm256_loadu_ps( bias );
+			__m256 a1 = _mm256_loadu_ps( bias + 8 );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				__m256 xv = _mm256_set1_ps( x[k] );
+				a0 = _mm256_fmadd_ps( xv, _mm256_loadu_ps( pw ), a0 );
+				a1 = _mm256_fmadd_ps( xv, _mm256_loadu_ps( pw + 8 ), a1 );
+				pw += 16;
+			}
+			_mm256_storeu_ps( out, a0 );
+			_mm256_storeu_ps( out + 8, a1 );
+			bias += 16;
+			out += 16;
+		}
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	inline void
+	_panel_layer_avx2( const double* pw, const double* bias, const double* x, std::size_t nin,
+		std::size_t npanels, double* out )
+	{
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			__m256d a0 = _mm256_loadu_pd( bias );
+			__m256d a1 = _mm256_loadu_pd( bias + 4 );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				__m256d xv = _mm256_set1_pd( x[k] );
+				a0 = _mm256_fmadd_pd( xv, _mm256_loadu_pd( pw ), a0 );
+				a1 = _mm256_fmadd_pd( xv, _mm256_loadu_pd( pw + 4 ), a1 );
+				pw += 8;
+			}
+			_mm256_storeu_pd( out, a0 );
+			_mm256_storeu_pd( out + 4, a1 );
+			bias += 8;
+			out += 8;
+		}
+	}
+
+	//! AVX-512 kernels, partial vectors use masked loads and stores
+
+	__attribute__(( target( "avx512f" ) ))
+	inline __m512
+	_exp_avx512( __m512 x )
+	{
+		static const float c[] = { 1.0F / 5040, 1.0F / 720, 1.0F / 120, 1.0F / 24,
+			1.0F / 6, 1.0F / 2, 1.0F, 1.0F };
+		x = _mm512_min_ps( _mm512_max_ps( x, _mm512_set1_ps( -87.0F ) ), _mm512_set1_ps( 88.0F ) );
+		__m512 fn = _mm512_roundscale_ps( _mm512_mul_ps( x, _mm512_set1_ps( 1.44269504F ) ),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+		__m512 r = _mm512_fnmadd_ps( fn, _mm512_set1_ps( 0.693359375F ), x );
+		r = _mm512_fnmadd_ps( fn, _mm512_set1_ps( -2.12194440E-4F ), r );
+		__m512 p = _mm512_set1_ps( c[0] );
+		for ( int i = 1; i < 8; ++i )
+		{
+			p = _mm512_fmadd_ps( p, r, _mm512_set1_ps( c[i] ) );
+		}
+		return _mm512_scalef_ps( p, fn );
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline __m512d
+	_exp_avx512( __m512d x )
+	{
+		static const double c[] = { 1.0 / 6227020800.0, 1.0 / 479001600.0,
+			1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+			1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0,
+			1.0 / 2.0, 1.0, 1.0 };
+		x = _mm512_min_pd( _mm512_max_pd( x, _mm512_set1_pd( -708.0 ) ), _mm512_set1_pd( 709.0 ) );
+		__m512d fn = _mm512_roundscale_pd( _mm512_mul_pd( x, _mm512_set1_pd( 1.4426950408889634 ) ),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+		__m512d r = _mm512_fnmadd_pd( fn, _mm512_set1_pd( 6.93145751953125E-1 ), x );
+		r = _mm512_fnmadd_pd( fn, _mm512_set1_pd( 1.42860682030941723212E-6 ), r );
+		__m512d p = _mm512_set1_pd( c[0] );
+		for ( int i = 1; i < 14; ++i )
+		{
+			p = _mm512_fmadd_pd( p, r, _mm512_set1_pd( c[i] ) );
+		}
+		return _mm512_scalef_pd( p, fn );
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline void
+	_layer_avx512( const float* w, const float* x, std::size_t nin, std::size_t nunits, float* out )
+	{
+		const std::size_t ws = 1 + nin;
+		std::size_t u = 0;
+		for ( ; u + 4 <= nunits; u += 4 )
+		{
+			const float* w0 = w + u * ws + 1;
+			const float* w1 = w0 + ws;
+			const float* w2 = w1 + ws;
+			const float* w3 = w2 + ws;
+			__m512 a0 = _mm512_setzero_ps( ), a1 = a0, a2 = a0, a3 = a0;
+			for ( std::size_t k = 0; k < nin; k += 16 )
+			{
+				__mmask16 m = ( nin - k >= 16 ) ? __mmask16( 0xFFFF )
+					: __mmask16( ( 1U << ( nin - k ) ) - 1 );
+				__m512 xv = _mm512_maskz_loadu_ps( m, x + k );
+				a0 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( m, w0 + k ), xv, a0 );
+				a1 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( m, w1 + k ), xv, a1 );
+				a2 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( m, w2 + k ), xv, a2 );
+				a3 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( m, w3 + k ), xv, a3 );
+			}
+			out[u] = w0[-1] + _mm512_reduce_add_ps( a0 );
+			out[u+1] = w1[-1] + _mm512_reduce_add_ps( a1 );
+			out[u+2] = w2[-1] + _mm512_reduce_add_ps( a2 );
+			out[u+3] = w3[-1] + _mm512_reduce_add_ps( a3 );
+		}
+		for ( ; u < nunits; ++u )
+		{
+			const float* wu = w + u * ws + 1;
+			__m512 a = _mm512_setzero_ps( );
+			for ( std::size_t k = 0; k < nin; k += 16 )
+			{
+				__mmask16 m = ( nin - k >= 16 ) ? __mmask16( 0xFFFF )
+					: __mmask16( ( 1U << ( nin - k ) ) - 1 );
+				a = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( m, wu + k ),
+					_mm512_maskz_loadu_ps( m, x + k ), a );
+			}
+			out[u] = wu[-1] + _mm512_reduce_add_ps( a );
+		}
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline void
+	_layer_avx512( const double* w, const double* x, std::size_t nin, std::size_t nunits, double* out )
+	{
+		const std::size_t ws = 1 + nin;
+		std::size_t u = 0;
+		for ( ; u + 4 <= nunits; u += 4 )
+		{
+			const double* w0 = w + u * ws + 1;
+			const double* w1 = w0 + ws;
+			const double* w2 = w1 + ws;
+			const double* w3 = w2 + ws;
+			__m512d a0 = _mm512_setzero_pd( ), a1 = a0, a2 = a0, a3 = a0;
+			for ( std::size_t k = 0; k < nin; k += 8 )
+			{
+				__mmask8 m = ( nin - k >= 8 ) ? __mmask8( 0xFF )
+					: __mmask8( ( 1U << ( nin - k ) ) - 1 );
+				__m512d xv = _mm512_maskz_loadu_pd( m, x + k );
+				a0 = _mm512_fmadd_pd( _mm512_maskz_loadu_pd( m, w0 + k ), xv, a0 );
+				a1 = _mm512_fmadd_pd( _mm512_maskz_loadu_pd( m, w1 + k ), xv, a1 );
+				a2 = _mm512_fmadd_pd( _mm512_maskz_loadu_pd( m, w2 + k ), xv, a2 );
+				a3 = _mm512_fmadd_pd( _mm512_maskz_loadu_pd( m, w3 + k ), xv, a3 );
+			}
+			out[u] = w0[-1] + _mm512_reduce_add_pd( a0 );
+			out[u+1] = w1[-1] + _mm512_reduce_add_pd( a1 );
+			out[u+2] = w2[-1] + _mm512_reduce_add_pd( a2 );
+			out[u+3] = w3[-1] + _mm512_reduce_add_pd( a3 );
+		}
+		for ( ; u < nunits; ++u )
+		{
+			const double* wu = w + u * ws + 1;
+			__m512d a = _mm512_setzero_pd( );
+			for ( std::size_t k = 0; k < nin; k += 8 )
+			{
+				__mmask8 m = ( nin - k >= 8 ) ? __mmask8( 0xFF )
+					: __mmask8( ( 1U << ( nin - k ) ) - 1 );
+				a = _mm512_fmadd_pd( _mm512_maskz_loadu_pd( m, wu + k ),
+					_mm512_maskz_loadu_pd( m, x + k ), a );
+			}
+			out[u] = wu[-1] + _mm512_reduce_add_pd( a );
+		}
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline void
+	_logistic_avx512( float* y, std::size_t n )
+	{
+		const __m512 one = _mm512_set1_ps( 1.0F );
+		for ( std::size_t k = 0; k < n; k += 16 )
+		{
+			__mmask16 m = ( n - k >= 16 ) ? __mmask16( 0xFFFF )
+				: __mmask16( ( 1U << ( n - k ) ) - 1 );
+			__m512 e = _exp_avx512( _mm512_sub_ps( _mm512_setzero_ps( ),
+				_mm512_maskz_loadu_ps( m, y + k ) ) );
+			_mm512_mask_storeu_ps( y + k, m, _mm512_div_ps( one, _mm512_add_ps( one, e ) ) );
+		}
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline void
+	_logistic_avx512( double* y, std::size_t n )
+	{
+		const __m512d one = _mm512_set1_pd( 1.0 );
+		for ( std::size_t k = 0; k < n; k += 8 )
+		{
+			__mmask8 m = ( n - k >= 8 ) ? __mmask8( 0xFF )
+				: __mmask8( ( 1U << ( n - k ) ) - 1 );
+			__m512d e = _exp_avx512( _mm512_sub_pd( _mm512_setzero_pd( ),
+				_mm512_maskz_loadu_pd( m, y + k ) ) );
+			_mm512_mask_storeu_pd( y + k, m, _mm512_div_pd( one, _mm512_add_pd( one, e ) ) );
+		}
+	}
+	__attribute__(( target( "avx512f" ) ))
+	inline void
+	_panel_layer_avx512( const float* pw, const float* bias, const float* x, std::size_t nin,
+		std::size_t npanels, float* out )
+	{
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			__m512 a = _mm512_loadu_ps( bias );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				a = _mm512_fmadd_ps( _mm512_set1_ps( x[k] ), _mm512_loadu_ps( pw ), a );
+				pw += 16;
+			}
+			_mm512_storeu_ps( out, a );
+			bias += 16;
+			out += 16;
+		}
+	}
+
+	__attribute__(( target( "avx512f" ) ))
+	inline void
+	_panel_layer_avx512( const double* pw, const double* bias, const double* x, std::size_t nin,
+		std::size_t npanels, double* out )
+	{
+		for ( std::size_t p = 0; p < npanels; ++p )
+		{
+			__m512d a = _mm512_loadu_pd( bias );
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				a = _mm512_fmadd_pd( _mm512_set1_pd( x[k] ), _mm512_loadu_pd( pw ), a );
+				pw += 8;
+			}
+			_mm512_storeu_pd( out, a );
+			bias += 8;
+			out += 8;
+		}
+	}
+#endif
+
+	//! kernel table for a level; levels without kernels for the value
+	//! type or platform use the portable kernels
+	template< typename T >
+	simd_kernels< T >
+	_simd_kernels_table( simd_level )
+	{
+		simd_kernels< T > k = { &_layer_scalar< T >, &_logistic_scalar< T >,
+			&_panel_layer_scalar< T >, simd_scalar };
+		return k;
+	}
+
+#ifdef GAMBOGE_NNET_X86_SIMD
+	template< typename T >
+	simd_kernels< T >
+	_simd_kernels_x86( simd_level level )
+	{
+		void (*layer)( const T*, const T*, std::size_t, std::size_t, T* ) = &_layer_sse2;
+		void (*logistic)( T*, std::size_t ) = &_logistic_sse2;
+		void (*panel_layer)( const T*, const T*, const T*, std::size_t, std::size_t, T* ) =
+			&_panel_layer_sse2;
+		if ( level >= simd_avx512 )
+		{
+			layer = &_layer_avx512;
+			logistic = &_logistic_avx512;
+			panel_layer = &_panel_layer_avx512;
+		}
+		else if ( level >= simd_avx2 )
+		{
+			layer = &_layer_avx2;
+			logistic = &_logistic_avx2;
+			panel_layer = &_panel_layer_avx2;
+		}
+		simd_kernels< T > k = { layer, logistic, panel_layer, std::min( level, simd_avx512 ) };
+		return k;
+	}
+
+	template< >
+	inline simd_kernels< float >
+	_simd_kernels_table< float >( simd_level level )
+	{
+		if ( level == simd_scalar )
+		{
+			simd_kernels< float > k = { &_layer_scalar< float >, &_logistic_scalar< float >,
+				&_panel_layer_scalar< float >, simd_scalar };
+			return k;
+		}
+		return _simd_kernels_x86< float >( level );
+	}
+
+	template< >
+	inline simd_kernels< double >
+	_simd_kernels_table< double >( simd_level level )
+	{
+		if ( level == simd_scalar )
+		{
+			simd_kernels< double > k = { &_layer_scalar< double >, &_logistic_scalar< double >,
+				&_panel_layer_scalar< double >, simd_scalar };
+			return k;
+		}
+		return _simd_kernels_x86< double >( level );
+	}
+#endif
+	//! @endcond
+
+	//! Determine the highest kernel level supported by the running CPU
+	//!
+	//! @return level detected through CPUID, including operating system
+	//!         support for the wider register state
+	inline simd_level
+	simd_supported_level( )
+	{
+#ifdef GAMBOGE_NNET_X86_SIMD
+		__builtin_cpu_init( );
+		if ( __builtin_cpu_supports( "avx512f" ) )
+		{
+			return simd_avx512;
+		}
+		if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+		{
+			return simd_avx2;
+		}
+		if ( __builtin_cpu_supports( "sse2" ) )
+		{
+			return simd_sse2;
+		}
+#endif
+		return simd_scalar;
+	}
+
+	//! Obtain the kernels for an instruction set level
+	//!
+	//! @param level    requested level, limited to simd_supported_level
+	//! @return kernel dispatch table
+	template< typename T >
+	simd_kernels< T >
+	simd_select( simd_level level )
+	{
+		return _simd_kernels_table< T >( std::min( level, simd_supported_level( ) ) );
+	}
+
+	//! Obtain the kernels for the running CPU
+	//!
+	//! @return kernel dispatch table, selected on first use
+	template< typename T >
+	const simd_kernels< T >&
+	simd_dispatch( )
+	{
+		static const simd_kernels< T > kernels = simd_select< T >( simd_avx512 );
+		return kernels;
+	}
+
+	//! Evaluate artificial neural network outputs with vectorized kernels
+	//!
+	//! @param firstx   start of input values
+	//! @param firstw   start of weights
+	//! @param result   start of outputs
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for a single output-layer unit
+	//! @param kernels  kernel dispatch table
+	//! @param ws       scratch storage for the evaluation
+	//! @return pointer marking end of outputs
+	//!
+	//! Computes the same outputs as evaluate_neural_network, with the same
+	//! weights layout, using the dot product and logistic kernels of
+	//! @p kernels. Sums are reassociated by the vector kernels, so results
+	//! may differ from evaluate_neural_network in the last bits.
+	//!
+	template< typename T, typename UnaryOp >
+	T*
+	evaluate_neural_network_simd( const T* firstx, const T* firstw, T* result,
+		std::size_t nx, std::size_t nh, std::size_t ny, UnaryOp unaryop,
+		const simd_kernels< T >& kernels, nnet_workspace< T >& ws )
+	{
+		T* unitsbuf = ws.reserve( nh + ny );
+		if ( unitsbuf == 0 )
+		{
+			return result;
+		}
+		T* hidden_out = &(unitsbuf[0]);
+		T* linout = &(unitsbuf[nh]);
+
+		if ( nh > 0 )
+		{
+			kernels.layer( firstw, firstx, nx, nh, hidden_out );
+			kernels.logistic( hidden_out, nh );
+			kernels.layer( firstw + nh * ( 1 + nx ), hidden_out, nh, ny, linout );
+		}
+		else  // nh is 0
+		{
+			kernels.layer( firstw, firstx, nx, ny, linout );
+		}
+
+		if ( ny > 1 )
+		{
+			_softmax( linout, linout + ny, linout );
+			return std::copy( linout, linout + ny, result );
+		}
+		return std::transform( linout, linout + ny, result, unaryop );
+	}
+
+	//! Evaluate artificial neural network outputs with vectorized kernels
+	//!
+	//! @param firstx   start of input values
+	//! @param firstw   start of weights
+	//! @param result   start of outputs
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @return pointer marking end of outputs
+	//!
+	//! As above, using the kernels for the running CPU, the logistic
+	//! output transform and the calling thread's workspace.
+	//!
+	template< typename T >
+	T*
+	evaluate_neural_network_simd( const T* firstx, const T* firstw, T* result,
+		std::size_t nx, std::size_t nh, std::size_t ny )
+	{
+		return evaluate_neural_network_simd( firstx, firstw, result, nx, nh, ny,
+			logistic_output< T >(), simd_dispatch< T >(), _thread_workspace< T >() );
+	}
+
+	//! @cond
+	//! apply the layer kernel to a block of rows; the units are taken in
+	//! tiles whose weights fit in a level 1 data cache, and each tile is
+	//! applied to every row of the block before the next tile is read
+	template< typename T >
+	void
+	_layer_block_simd( const simd_kernels< T >& kernels, const T* w, const T* in,
+		std::size_t instride, std::size_t nin, std::size_t nunits, std::size_t rows, T* out )
+	{
+		const std::size_t tile_bytes = 16384;
+		const std::size_t tile = std::max( std::size_t( 1 ),
+			tile_bytes / ( ( 1 + nin ) * sizeof( T ) ) );
+		for ( std::size_t u0 = 0; u0 < nunits; u0 += tile )
+		{
+			const std::size_t nu = std::min( tile, nunits - u0 );
+			const T* tile_wts = w + u0 * ( 1 + nin );
+			for ( std::size_t r = 0; r < rows; ++r )
+			{
+				kernels.layer( tile_wts, in + r * instride, nin, nu, out + r * nunits + u0 );
+			}
+		}
+	}
+	//! @endcond
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! with vectorized kernels
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @param unaryop  output transform for a single output-layer unit
+	//! @param kernels  kernel dispatch table
+	//! @param ws       scratch storage for the evaluation
+	//! @return pointer marking end of outputs, or @p result if the
+	//!         workspace could not be reserved
+	//!
+	//! See evaluate_neural_network_batch for the matrix layouts. Rows are
+	//! evaluated in blocks sized as by evaluate_neural_network_batch; within
+	//! a block the layer kernel is applied to tiles of units whose weights
+	//! stay in cache across the rows, and the logistic kernel to all of the
+	//! block's hidden-layer outputs at once.
+	//!
+	template< typename T, typename UnaryOp >
+	T*
+	evaluate_neural_network_batch_simd( const T* firstx, std::size_t xstride,
+		const T* firstw, T* result, std::size_t nrows,
+		std::size_t nx, std::size_t nh, std::size_t ny, UnaryOp unaryop,
+		const simd_kernels< T >& kernels, nnet_workspace< T >& ws )
+	{
+		const std::size_t nb = std::min( nrows, _batch_block_rows< T >( nx, nh, ny ) );
+		if ( nb == 0 )
+		{
+			return result;
+		}
+		T* unitsbuf = ws.reserve( nb * ( nh + ny ) );
+		if ( unitsbuf == 0 )
+		{
+			return result;
+		}
+		T* hidden_out = &(unitsbuf[0]);
+		T* linout = &(unitsbuf[nb*nh]);
+		const T* out_wts = firstw + nh * ( 1 + nx );
+
+		for ( std::size_t r0 = 0; r0 < nrows; r0 += nb )
+		{
+			const std::size_t rows = std::min( nb, nrows - r0 );
+			const T* x = firstx + r0 * xstride;
+			if ( nh > 0 )
+			{
+				_layer_block_simd( kernels, firstw, x, xstride, nx, nh, rows, hidden_out );
+				kernels.logistic( hidden_out, rows * nh );
+				_layer_block_simd( kernels, out_wts, hidden_out, nh, nh, ny, rows, linout );
+			}
+			else  // nh is 0
+			{
+				_layer_block_simd( kernels, firstw, x, xstride, nx, ny, rows, linout );
+			}
+
+			for ( std::size_t r = 0; r < rows; ++r )
+			{
+				T* row_linout = linout + r * ny;
+				if ( ny > 1 )
+				{
+					_softmax( row_linout, row_linout + ny, row_linout );
+					result = std::copy( row_linout, row_linout + ny, result );
+				}
+				else
+				{
+					result = std::transform( row_linout, row_linout + ny, result, unaryop );
+				}
+			}
+		}
+		return result;
+	}
+
+	//! Evaluate artificial neural network outputs for many input rows
+	//! with vectorized kernels
+	//!
+	//! @param firstx   start of input matrix
+	//! @param xstride  distance between the starts of consecutive input rows
+	//! @param firstw   start of weights
+	//! @param result   start of output matrix
+	//! @param nrows    input row count
+	//! @param nx       input count
+	//! @param nh       hidden-layer count
+	//! @param ny       output count
+	//! @return pointer marking end of outputs
+	//!
+	//! As above, using the kernels for the running CPU, the logistic
+	//! output transform and the calling thread's workspace.
+	//!
+	template< typename T >
+	T*
+	evaluate_neural_network_batch_simd( const T* firstx, std::size_t xstride,
+		const T* firstw, T* result, std::size_t nrows,
+		std::size_t nx, std::size_t nh, std::size_t ny )
+	{
+		return evaluate_neural_network_batch_simd( firstx, xstride, firstw, result, nrows,
+			nx, nh, ny, logistic_output< T >(), simd_dispatch< T >(), _thread_workspace< T >() );
+	}
+}
+
+#endif
@@ -0,0 +1,473 @@
+//! @file gamboge/nnet_stats.h
+//! gamboge neural network evaluation counters and latency histograms
+//!
+//! Instrumentation is compiled into the evaluation entry points of
+//! gamboge/nnet.h only when GAMBOGE_NNET_STATS is defined before any
+//! gamboge header is included; otherwise the hooks expand to nothing.
+//! The instrumented definitions live in an inline namespace chosen by the
+//! macro, so translation units may differ: each evaluates through its own
+//! copies, and only those compiled with the macro record. This header may
+//! be included either way to read the statistics.
+
+#ifndef _GAMBOGE_NNET_STATS_H
+#define _GAMBOGE_NNET_STATS_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace gamboge
+{
+	//! totals of an nnet_stats object at one moment
+	struct nnet_stats_snapshot
+	{
+		//! latency histogram bucket count; bucket @a b counts calls taking
+		//! at most 2^@a b nanoseconds and more than 2^(@a b - 1), the last
+		//! bucket also counting all longer calls
+		static const std::size_t bucket_count = 32;
+
+		std::string name;
+		uint64_t calls;
+		uint64_t rows;
+		uint64_t alloc_failures;
+		uint64_t latency_ns_sum;
+		uint64_t latency_buckets[ bucket_count ];
+	};
+
+	//! evaluation counters for one model
+	//!
+	//! Counts evaluation calls, rows evaluated, workspace allocation
+	//! failures (calls that wrote no outputs) and a log2 histogram of call
+	//! latencies. Each thread accumulates into one of several cache-line
+	//! sized shards with relaxed atomic additions, so concurrent
+	//! evaluations rarely share a cache line; snapshot() sums the shards.
+	//!
+	//! The object registers itself for stats_snapshot() on construction
+	//! and must outlive evaluations recording to it.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	static gamboge::nnet_stats iris_stats( "iris" );
+	//! 	nnet_type nnet( in_count, hidden_count, out_count, &(wts[0]) );
+	//! 	nnet.set_stats( &iris_stats );
+	//! 	...
+	//! 	std::string text = gamboge::stats_prometheus( );
+	//! }
+	//! @endcode
+	class nnet_stats
+	{
+	public:
+		static const std::size_t bucket_count = nnet_stats_snapshot::bucket_count;
+
+		//! constructor, registered counters
+		//!
+		//! @param name     model name, the model label of exported metrics
+		explicit nnet_stats( const char* name );
+
+		//! destructor, removes the counters from the registry
+		~nnet_stats( );
+
+		//! Record one evaluation call
+		//!
+		//! @param rows     input rows evaluated
+		//! @param ns       call latency in nanoseconds
+		void record( std::size_t rows, uint64_t ns )
+		{
+			shard& s = local_shard( );
+			s.calls.fetch_add( 1, std::memory_order_relaxed );
+			s.rows.fetch_add( rows, std::memory_order_relaxed );
+			s.latency_ns_sum.fetch_add( ns, std::memory_order_relaxed );
+			s.latency_buckets[ bucket( ns ) ].fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		//! Record a failure to obtain evaluation workspace
+		void record_alloc_failure( )
+		{
+			local_shard( ).alloc_failures.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		//! @return totals over all threads
+		nnet_stats_snapshot snapshot( ) const
+		{
+			nnet_stats_snapshot r;
+			r.name = label;
+			r.calls = r.rows = r.alloc_failures = r.latency_ns_sum = 0;
+			std::fill( r.latency_buckets, r.latency_buckets + bucket_count, 0 );
+			for ( std::size_t k = 0; k < shard_count; ++k )
+			{
+				const shard& s = shards[k];
+				r.calls += s.calls.load( std::memory_order_relaxed );
+				r.rows += s.rows.load( std::memory_order_relaxed );
+				r.alloc_failures += s.alloc_failures.load( std::memory_order_relaxed );
+				r.latency_ns_sum += s.latency_ns_sum.load( std::memory_order_relaxed );
+				for ( std::size_t b = 0; b < bucket_count; ++b )
+				{
+					r.latency_buckets[b] += s.latency_buckets[b].load( std::memory_order_relaxed );
+				}
+			}
+			return r;
+		}
+
+		//! @return model name
+		const std::string& name( ) const
+		{
+			return label;
+		}
+
+		//! @return histogram bucket index of a latency in nanoseconds
+		static std::size_t bucket( uint64_t ns )
+		{
+			// the bit length of ns - 1
+			uint64_t v = ( ns > 0 ) ? ns - 1 : 0;
+			std::size_t b = 0;
+			while ( v != 0 && b + 1 < bucket_count )
+			{
+				v >>= 1;
+				++b;
+			}
+			return b;
+		}
+
+	private:
+		static const std::size_t shard_count = 8;
+
+		struct alignas( 64 ) shard
+		{
+			shard( )
+			: calls( 0 ), rows( 0 ), alloc_failures( 0 ), latency_ns_sum( 0 )
+			{
+				for ( std::size_t b = 0; b < bucket_count; ++b )
+				{
+					latency_buckets[b].store( 0, std::memory_order_relaxed );
+				}
+			}
+
+			std::atomic< uint64_t > calls;
+			std::atomic< uint64_t > rows;
+			std::atomic< uint64_t > alloc_failures;
+			std::atomic< uint64_t > latency_ns_sum;
+			std::atomic< uint64_t > latency_buckets[ bucket_count ];
+		};
+
+		// threads are assigned shards round-robin on first use
+		shard& local_shard( )
+		{
+			static std::atomic< unsigned > next_thread( 0 );
+			static thread_local unsigned index =
+				next_thread.fetch_add( 1, std::memory_order_relaxed ) % shard_count;
+			return shards[ index ];
+		}
+
+		nnet_stats( const nnet_stats& );
+		nnet_stats& operator=( const nnet_stats& );
+
+		shard shards[ shard_count ];
+		std::string label;
+	};
+
+	//! @cond
+	struct _stats_registry
+	{
+		std::mutex lock;
+		std::vector< nnet_stats* > models;
+	};
+
+	inline _stats_registry&
+	_registry( )
+	{
+		static _stats_registry registry;
+		return registry;
+	}
+
+	inline
+	nnet_stats::nnet_stats( const char* name )
+	: label( name )
+	{
+		_stats_registry& reg = _registry( );
+		std::lock_guard< std::mutex > guard( reg.lock );
+		reg.models.push_back( this );
+	}
+
+	inline
+	nnet_stats::~nnet_stats( )
+	{
+		_stats_registry& reg = _registry( );
+		std::lock_guard< std::mutex > guard( reg.lock );
+		reg.models.erase( std::remove( reg.models.begin( ), reg.models.end( ), this ),
+			reg.models.end( ) );
+	}
+
+	//! counters for the free evaluate_neural_network functions
+	inline nnet_stats&
+	_stats_single( )
+	{
+		static nnet_stats stats( "evaluate_neural_network" );
+		return stats;
+	}
+
+	//! counters for the free evaluate_neural_network_batch functions
+	inline nnet_stats&
+	_stats_batch( )
+	{
+		static nnet_stats stats( "evaluate_neural_network_batch" );
+		return stats;
+	}
+
+	//! counters of the model being evaluated by the calling thread, or 0
+	inline nnet_stats*&
+	_stats_model( )
+	{
+		static thread_local nnet_stats* model = 0;
+		return model;
+	}
+
+	//! counters to record to: the current model's, else @p entry's
+	inline nnet_stats&
+	_stats_current( nnet_stats& (*entry)( ) )
+	{
+		nnet_stats* model = _stats_model( );
+		return model != 0 ? *model : entry( );
+	}
+
+	//! names @p stats as the current model for the enclosing scope
+	class _stats_model_scope
+	{
+	public:
+		explicit _stats_model_scope( nnet_stats* stats )
+		: saved( _stats_model( ) )
+		{
+			_stats_model( ) = stats;
+		}
+
+		~_stats_model_scope( )
+		{
+			_stats_model( ) = saved;
+		}
+
+	private:
+		nnet_stats* saved;
+	};
+
+	//! records a call, with its latency, when the enclosing scope ends
+	class _stats_timer
+	{
+	public:
+		_stats_timer( nnet_stats& stats, std::size_t rows )
+		: stats( stats ),
+		  rows( rows ),
+		  start( std::chrono::steady_clock::now( ) )
+		{
+		}
+
+		~_stats_timer( )
+		{
+			std::chrono::steady_clock::duration d = std::chrono::steady_clock::now( ) - start;
+			stats.record( rows, static_cast< uint64_t >(
+				std::chrono::duration_cast< std::chrono::nanoseconds >( d ).count( ) ) );
+		}
+
+	private:
+		nnet_stats& stats;
+		std::size_t rows;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	//! append @p s with JSON and Prometheus label escapes
+	inline void
+	_append_escaped( std::string& out, const std::string& s )
+	{
+		for ( std::size_t k = 0; k < s.size( ); ++k )
+		{
+			switch ( s[k] )
+			{
+			case '\\': out += "\\\\"; break;
+			case '"':  out += "\\\""; break;
+			case '\n': out += "\\n"; break;
+			default:   out += s[k]; break;
+			}
+		}
+	}
+
+	inline void
+	_append_uint( std::string& out, uint64_t v )
+	{
+		char buf[ 24 ];
+		std::snprintf( buf, sizeof( buf ), "%llu", static_cast< unsigned long long >( v ) );
+		out += buf;
+	}
+
+	inline void
+	_append_prometheus( std::string& out, const char* metric, const nnet_stats_snapshot& s,
+		const char* le, uint64_t v )
+	{
+		out += metric;
+		out += "{model=\"";
+		_append_escaped( out, s.name );
+		out += '"';
+		if ( le != 0 )
+		{
+			out += ",le=\"";
+			out += le;
+			out += '"';
+		}
+		out += "} ";
+		_append_uint( out, v );
+		out += '\n';
+	}
+	//! @endcond
+
+	//! @return snapshots of all registered counters, in registration order
+	inline std::vector< nnet_stats_snapshot >
+	stats_snapshot( )
+	{
+		std::vector< nnet_stats_snapshot > result;
+		_stats_registry& reg = _registry( );
+		std::lock_guard< std::mutex > guard( reg.lock );
+		result.reserve( reg.models.size( ) );
+		for ( std::size_t k = 0; k < reg.models.size( ); ++k )
+		{
+			result.push_back( reg.models[k]->snapshot( ) );
+		}
+		return result;
+	}
+
+	//! Format counter snapshots as a JSON document
+	//!
+	//! @param stats    counter snapshots, see stats_snapshot
+	//! @return JSON text
+	//!
+	//! The document is an object whose "models" array holds, per model,
+	//! "name", "calls", "rows", "alloc_failures", "latency_ns_sum" and
+	//! "latency_ns_buckets", an array of { "le", "count" } objects with
+	//! non-cumulative counts and upper bounds in nanoseconds, the last
+	//! bound null for an unbounded bucket.
+	inline std::string
+	stats_json( const std::vector< nnet_stats_snapshot >& stats )
+	{
+		std::string out( "{\"models\":[" );
+		for ( std::size_t k = 0; k < stats.size( ); ++k )
+		{
+			const nnet_stats_snapshot& s = stats[k];
+			out += ( k == 0 ) ? "{\"name\":\"" : ",{\"name\":\"";
+			_append_escaped( out, s.name );
+			out += "\",\"calls\":";
+			_append_uint( out, s.calls );
+			out += ",\"rows\":";
+			_append_uint( out, s.rows );
+			out += ",\"alloc_failures\":";
+			_append_uint( out, s.alloc_failures );
+			out += ",\"latency_ns_sum\":";
+			_append_uint( out, s.latency_ns_sum );
+			out += ",\"latency_ns_buckets\":[";
+			for ( std::size_t b = 0; b < nnet_stats_snapshot::bucket_count; ++b )
+			{
+				out += ( b == 0 ) ? "{\"le\":" : ",{\"le\":";
+				if ( b + 1 < nnet_stats_snapshot::bucket_count )
+				{
+					_append_uint( out, static_cast< uint64_t >( 1 ) << b );
+				}
+				else
+				{
+					out += "null";
+				}
+				out += ",\"count\":";
+				_append_uint( out, s.latency_buckets[b] );
+				out += '}';
+			}
+			out += "]}";
+		}
+		out += "]}\n";
+		return out;
+	}
+
+	//! @return all registered counters formatted as a JSON document
+	inline std::string
+	stats_json( )
+	{
+		return stats_json( stats_snapshot( ) );
+	}
+
+	//! Format counter snapshots in the Prometheus text exposition format
+	//!
+	//! @param stats    counter snapshots, see stats_snapshot
+	//! @return metrics text
+	//!
+	//! Exports the counters gamboge_nnet_calls_total,
+	//! gamboge_nnet_rows_total and gamboge_nnet_alloc_failures_total and
+	//! the histogram gamboge_nnet_latency_seconds, each labelled with the
+	//! model name.
+	inline std::string
+	stats_prometheus( const std::vector< nnet_stats_snapshot >& stats )
+	{
+		static const char* const counters[ 3 ][ 2 ] = {
+			{ "gamboge_nnet_calls_total", "Evaluation calls." },
+			{ "gamboge_nnet_rows_total", "Input rows evaluated." },
+			{ "gamboge_nnet_alloc_failures_total",
+				"Evaluations abandoned for want of workspace." }
+			};
+		std::string out;
+		for ( std::size_t c = 0; c < 3; ++c )
+		{
+			out += "# HELP ";
+			out += counters[c][0];
+			out += ' ';
+			out += counters[c][1];
+			out += "\n# TYPE ";
+			out += counters[c][0];
+			out += " counter\n";
+			for ( std::size_t k = 0; k < stats.size( ); ++k )
+			{
+				const nnet_stats_snapshot& s = stats[k];
+				uint64_t v = ( c == 0 ) ? s.calls : ( c == 1 ) ? s.rows : s.alloc_failures;
+				_append_prometheus( out, counters[c][0], s, 0, v );
+			}
+		}
+
+		out += "# HELP gamboge_nnet_latency_seconds Evaluation call latency.\n"
+			"# TYPE gamboge_nnet_latency_seconds histogram\n";
+		for ( std::size_t k = 0; k < stats.size( ); ++k )
+		{
+			const nnet_stats_snapshot& s = stats[k];
+			uint64_t cumulative = 0;
+			for ( std::size_t b = 0; b < nnet_stats_snapshot::bucket_count; ++b )
+			{
+				cumulative += s.latency_buckets[b];
+				char le[ 32 ];
+				if ( b + 1 < nnet_stats_snapshot::bucket_count )
+				{
+					std::snprintf( le, sizeof( le ), "%.9g",
+						static_cast< double >( static_cast< uint64_t >( 1 ) << b ) * 1E-9 );
+				}
+				else
+				{
+					std::snprintf( le, sizeof( le ), "+Inf" );
+				}
+				_append_prometheus( out, "gamboge_nnet_latency_seconds_bucket", s, le, cumulative );
+			}
+			out += "gamboge_nnet_latency_seconds_sum{model=\"";
+			_append_escaped( out, s.name );
+			char sum[ 32 ];
+			std::snprintf( sum, sizeof( sum ), "\"} %.9g\n",
+				static_cast< double >( s.latency_ns_sum ) * 1E-9 );
+			out += sum;
+			_append_prometheus( out, "gamboge_nnet_latency_seconds_count", s, 0, s.calls );
+		}
+		return out;
+	}
+
+	//! @return all registered counters in the Prometheus text format
+	inline std::string
+	stats_prometheus( )
+	{
+		return stats_prometheus( stats_snapshot( ) );
+	}
+}
+
+#endif
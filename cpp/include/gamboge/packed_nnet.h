@@ -0,0 +1,308 @@
+//! @file gamboge/packed_nnet.h
+//! gamboge neural network with weights packed for vectorized evaluation
+
+#ifndef _GAMBOGE_PACKED_NNET_H
+#define _GAMBOGE_PACKED_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include "gamboge/nnet_simd.h"
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace gamboge
+{
+	//! @cond
+	//! allocator of storage aligned to simd_panel_bytes
+	template< typename T >
+	struct _panel_allocator
+	{
+		typedef T value_type;
+
+		_panel_allocator( )
+		{
+		}
+
+		template< typename U >
+		_panel_allocator( const _panel_allocator< U >& )
+		{
+		}
+
+		T* allocate( std::size_t n )
+		{
+			// the start of the underlying allocation is kept just before
+			// the aligned block
+			char* raw = static_cast< char* >( ::operator new(
+				n * sizeof( T ) + simd_panel_bytes + sizeof( void* ) ) );
+			std::size_t offset = simd_panel_bytes -
+				( reinterpret_cast< std::size_t >( raw + sizeof( void* ) ) % simd_panel_bytes );
+			char* aligned = raw + sizeof( void* ) + ( offset % simd_panel_bytes );
+			reinterpret_cast< void** >( aligned )[-1] = raw;
+			return reinterpret_cast< T* >( aligned );
+		}
+
+		void deallocate( T* p, std::size_t )
+		{
+			::operator delete( reinterpret_cast< void** >( p )[-1] );
+		}
+	};
+
+	template< typename T, typename U >
+	bool
+	operator==( const _panel_allocator< T >&, const _panel_allocator< U >& )
+	{
+		return true;
+	}
+
+	template< typename T, typename U >
+	bool
+	operator!=( const _panel_allocator< T >&, const _panel_allocator< U >& )
+	{
+		return false;
+	}
+	//! @endcond
+
+	//! artificial neural network with weights packed for vectorized evaluation
+	//!
+	//! @tparam T        value type of weights, inputs and outputs
+	//! @tparam UnaryOp  output transform for a single output-layer unit
+	//!
+	//! Computes the same outputs as evaluate_neural_network. The weights are
+	//! copied once, at construction, from the evaluate_neural_network layout
+	//! into storage aligned to simd_panel_bytes. Each layer's units are
+	//! grouped into panels of simd_panel_width units, the unit count padded
+	//! with zero weights to a whole number of panels. Within a panel the
+	//! weights are transposed so the weights of one input for all the panel's
+	//! units are contiguous, and biases are held apart from the weights.
+	//! Evaluation broadcasts each input into a panel's units with the
+	//! simd_kernels panel_layer kernel, and applies the logistic kernel to
+	//! whole panels of hidden-layer units.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	const float wts[ ] = { ... };   // R nnet$wts for a 3-2-1 network
+	//! 	const gamboge::packed_neural_network< float > example_nnet( 3, 2, 1, wts );
+	//! 	const float nn_in[ 3 ] = { 1.4F, 6.8F, 4.8F };
+	//! 	float nn_out[ 1 ];
+	//!
+	//! 	example_nnet.evaluate( nn_out, nn_in );
+	//! }
+	//! @endcode
+	template< typename T, typename UnaryOp = logistic_output< T > >
+	class packed_neural_network
+	{
+	public:
+		typedef T value_type;
+		typedef nnet_workspace< T > workspace_type;
+
+		//! constructor, packs the network weights
+		//!
+		//! @param n        input count
+		//! @param m        hidden-layer count
+		//! @param k        output count
+		//! @param wts      start of weights sequence, see evaluate_neural_network
+		//! @param unaryop  output transform for a single output-layer unit
+		//! @param kernels  kernel dispatch table
+		template< typename InIterWt >
+		packed_neural_network( std::size_t n, std::size_t m, std::size_t k, InIterWt wts,
+			UnaryOp unaryop = UnaryOp( ),
+			const simd_kernels< T >& kernels = simd_dispatch< T >( ) )
+		: input_count( n ),
+		  hidden_count( m ),
+		  output_count( k ),
+		  hidden_padded( _padded( m ) ),
+		  output_padded( _padded( k ) ),
+		  unaryop( unaryop ),
+		  kernels( kernels )
+		{
+			std::size_t out_inputs = input_count;
+			if ( hidden_count > 0 )
+			{
+				wts = pack_layer( wts, input_count, hidden_count, hidden_wts, hidden_bias );
+				out_inputs = hidden_count;
+			}
+			pack_layer( wts, out_inputs, output_count, output_wts, output_bias );
+		}
+
+		//! Evaluate artificial neural network outputs
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result, const T* values ) const
+		{
+			return evaluate( result, values, _thread_workspace< T >() );
+		}
+
+		//! Evaluate artificial neural network outputs using a workspace
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result, const T* values, workspace_type& ws ) const
+		{
+			return evaluate_batch( result, values, 1, input_count, ws );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return pointer marking end of result sequence
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, input_count, _thread_workspace< T >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		//!
+		//! Rows are evaluated in blocks; each panel's weights are applied to
+		//! all rows of a block while they are in cache.
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows, std::size_t stride,
+			workspace_type& ws ) const
+		{
+			std::size_t nb = std::min( nrows,
+				_batch_block_rows< T >( input_count, hidden_padded, output_padded ) );
+			if ( nb == 0 )
+			{
+				return result;
+			}
+			T* unitsbuf = ws.reserve( nb * ( hidden_padded + output_padded ) );
+			if ( unitsbuf == 0 )
+			{
+				return result;
+			}
+			T* hidden_out = &(unitsbuf[0]);
+			T* linout = &(unitsbuf[nb*hidden_padded]);
+
+			for ( std::size_t r0 = 0; r0 < nrows; r0 += nb )
+			{
+				std::size_t rows = std::min( nb, nrows - r0 );
+				const T* block = values + r0 * stride;
+
+				if ( hidden_count > 0 )
+				{
+					apply_layer( hidden_wts, hidden_bias, input_count, hidden_padded,
+						block, stride, rows, hidden_out );
+					kernels.logistic( hidden_out, rows * hidden_padded );
+					apply_layer( output_wts, output_bias, hidden_count, output_padded,
+						hidden_out, hidden_padded, rows, linout );
+				}
+				else  // hidden_count is 0
+				{
+					apply_layer( output_wts, output_bias, input_count, output_padded,
+						block, stride, rows, linout );
+				}
+
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					T* lo = &(linout[r*output_padded]);
+					if ( output_count > 1 )
+					{
+						_softmax( lo, lo + output_count, lo );
+						result = std::copy( lo, lo + output_count, result );
+					}
+					else
+					{
+						result = std::transform( lo, lo + output_count, result, unaryop );
+					}
+				}
+			}
+			return result;
+		}
+
+		//! @return input count
+		std::size_t inputs( ) const
+		{
+			return input_count;
+		}
+
+		//! @return hidden-layer unit count
+		std::size_t hidden( ) const
+		{
+			return hidden_count;
+		}
+
+		//! @return output count
+		std::size_t outputs( ) const
+		{
+			return output_count;
+		}
+
+	private:
+		typedef std::vector< T, _panel_allocator< T > > storage_type;
+
+		static std::size_t _padded( std::size_t units )
+		{
+			const std::size_t pwidth = simd_panel_width< T >::value;
+			return ( ( units + pwidth - 1 ) / pwidth ) * pwidth;
+		}
+
+		// read a layer's weight blocks in evaluate_neural_network order and
+		// store them transposed by panel, biases separately
+		template< typename InIterWt >
+		static InIterWt pack_layer( InIterWt itw, std::size_t nin, std::size_t nunits,
+			storage_type& pw, storage_type& bias )
+		{
+			const std::size_t pwidth = simd_panel_width< T >::value;
+			const std::size_t padded = _padded( nunits );
+			pw.assign( padded * nin, static_cast< T >( 0 ) );
+			bias.assign( padded, static_cast< T >( 0 ) );
+			for ( std::size_t u = 0; u < nunits; ++u )
+			{
+				const std::size_t panel = u / pwidth;
+				const std::size_t lane = u % pwidth;
+				bias[u] = *itw;
+				++itw;
+				for ( std::size_t k = 0; k < nin; ++k )
+				{
+					pw[ ( panel * nin + k ) * pwidth + lane ] = *itw;
+					++itw;
+				}
+			}
+			return itw;
+		}
+
+		// apply a packed layer to a block of rows, panel by panel
+		void apply_layer( const storage_type& pw, const storage_type& bias,
+			std::size_t nin, std::size_t padded, const T* in, std::size_t in_stride,
+			std::size_t rows, T* out ) const
+		{
+			const std::size_t pwidth = simd_panel_width< T >::value;
+			for ( std::size_t p = 0; p * pwidth < padded; ++p )
+			{
+				const T* panel_wts = &(pw[p*nin*pwidth]);
+				const T* panel_bias = &(bias[p*pwidth]);
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					kernels.panel_layer( panel_wts, panel_bias, in + r * in_stride, nin, 1,
+						out + r * padded + p * pwidth );
+				}
+			}
+		}
+
+		std::size_t input_count;
+		std::size_t hidden_count;
+		std::size_t output_count;
+		std::size_t hidden_padded;
+		std::size_t output_padded;
+		storage_type hidden_wts;
+		storage_type hidden_bias;
+		storage_type output_wts;
+		storage_type output_bias;
+		UnaryOp unaryop;
+		simd_kernels< T > kernels;
+	};
+}
+
+#endif
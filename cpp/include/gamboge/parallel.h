@@ -0,0 +1,303 @@
+//! @file gamboge/parallel.h
+//! gamboge neural network multithreaded batch evaluation
+
+#ifndef _GAMBOGE_PARALLEL_H
+#define _GAMBOGE_PARALLEL_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace gamboge
+{
+	//! work-stealing thread pool
+	//!
+	//! A job is a number of chunks and a task called once for each chunk.
+	//! The chunks are divided into contiguous ranges, one for each worker
+	//! thread's queue. A worker takes chunks from the front of its own queue
+	//! and, when that is empty, steals from the back of another worker's
+	//! queue, so uneven chunk costs are balanced without a shared queue.
+	class work_stealing_pool
+	{
+	public:
+		//! constructor, starts the worker threads
+		//!
+		//! @param thread_count  worker count; 0 for one per hardware thread
+		//! @param cpus          CPU numbers, worker @a w is pinned to
+		//!                      @p cpus [ @a w % @p cpus.size() ]; empty for
+		//!                      no affinity
+		explicit work_stealing_pool( std::size_t thread_count = 0,
+			const std::vector< int >& cpus = std::vector< int >( ) )
+		: stopping( false ),
+		  generation( 0 ),
+		  pending( 0 )
+		{
+			if ( thread_count == 0 )
+			{
+				thread_count = std::max( 1U, std::thread::hardware_concurrency( ) );
+			}
+			for ( std::size_t w = 0; w < thread_count; ++w )
+			{
+				queues.push_back( std::unique_ptr< worker_queue >( new worker_queue ) );
+			}
+			for ( std::size_t w = 0; w < thread_count; ++w )
+			{
+				workers.push_back( std::thread( &work_stealing_pool::worker_loop, this, w ) );
+				if ( !cpus.empty( ) )
+				{
+					set_affinity( workers.back( ), cpus[ w % cpus.size( ) ] );
+				}
+			}
+		}
+
+		//! destructor, stops and joins the worker threads
+		~work_stealing_pool( )
+		{
+			{
+				std::lock_guard< std::mutex > lock( state_mutex );
+				stopping = true;
+			}
+			start_cv.notify_all( );
+			for ( std::size_t w = 0; w < workers.size( ); ++w )
+			{
+				workers[w].join( );
+			}
+		}
+
+		//! @return worker thread count
+		std::size_t size( ) const
+		{
+			return workers.size( );
+		}
+
+		//! Run a job and wait for it to complete
+		//!
+		//! @param nchunks  chunk count
+		//! @param task     called as @p task ( @a worker, @a chunk ) for each
+		//!                 chunk index in [ 0, @p nchunks ); @a worker is the
+		//!                 index of the worker thread making the call
+		//!
+		//! Jobs from concurrent callers are run one after another.
+		template< typename Task >
+		void run( std::size_t nchunks, Task task )
+		{
+			if ( nchunks == 0 )
+			{
+				return;
+			}
+			std::lock_guard< std::mutex > run_lock( run_mutex );
+			job = task;
+			pending = nchunks;
+
+			// contiguous ranges of chunks for each worker
+			const std::size_t nw = queues.size( );
+			for ( std::size_t w = 0; w < nw; ++w )
+			{
+				std::lock_guard< std::mutex > lock( queues[w]->mutex );
+				for ( std::size_t c = w * nchunks / nw; c < ( w + 1 ) * nchunks / nw; ++c )
+				{
+					queues[w]->chunks.push_back( c );
+				}
+			}
+
+			std::unique_lock< std::mutex > lock( state_mutex );
+			++generation;
+			start_cv.notify_all( );
+			done_cv.wait( lock, [this] { return pending == 0; } );
+			job = nullptr;
+		}
+
+	private:
+		struct worker_queue
+		{
+			std::mutex mutex;
+			std::deque< std::size_t > chunks;
+		};
+
+		static void set_affinity( std::thread& t, int cpu )
+		{
+#if defined( __linux__ )
+			cpu_set_t cpuset;
+			CPU_ZERO( &cpuset );
+			CPU_SET( cpu, &cpuset );
+			pthread_setaffinity_np( t.native_handle( ), sizeof( cpuset ), &cpuset );
+#else
+			(void) t;
+			(void) cpu;
+#endif
+		}
+
+		bool take_local( std::size_t w, std::size_t& chunk )
+		{
+			std::lock_guard< std::mutex > lock( queues[w]->mutex );
+			if ( queues[w]->chunks.empty( ) )
+			{
+				return false;
+			}
+			chunk = queues[w]->chunks.front( );
+			queues[w]->chunks.pop_front( );
+			return true;
+		}
+
+		bool steal( std::size_t w, std::size_t& chunk )
+		{
+			const std::size_t nw = queues.size( );
+			for ( std::size_t i = 1; i < nw; ++i )
+			{
+				worker_queue& victim = *queues[ ( w + i ) % nw ];
+				std::lock_guard< std::mutex > lock( victim.mutex );
+				if ( !victim.chunks.empty( ) )
+				{
+					chunk = victim.chunks.back( );
+					victim.chunks.pop_back( );
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void worker_loop( std::size_t w )
+		{
+			std::size_t seen = 0;
+			for ( ;; )
+			{
+				{
+					std::unique_lock< std::mutex > lock( state_mutex );
+					start_cv.wait( lock, [&] { return stopping || generation != seen; } );
+					if ( stopping )
+					{
+						return;
+					}
+					seen = generation;
+				}
+
+				std::size_t chunk;
+				while ( take_local( w, chunk ) || steal( w, chunk ) )
+				{
+					job( w, chunk );
+					if ( --pending == 0 )
+					{
+						std::lock_guard< std::mutex > lock( state_mutex );
+						done_cv.notify_all( );
+					}
+				}
+			}
+		}
+
+		std::vector< std::unique_ptr< worker_queue > > queues;
+		std::vector< std::thread > workers;
+		std::function< void( std::size_t, std::size_t ) > job;
+		std::mutex run_mutex;
+		std::mutex state_mutex;
+		std::condition_variable start_cv;
+		std::condition_variable done_cv;
+		bool stopping;
+		std::size_t generation;
+		std::atomic< std::size_t > pending;
+	};
+
+	//! multithreaded batch evaluation of a neural network
+	//!
+	//! @tparam Network  network type providing evaluate_batch with a
+	//!                  workspace argument, e.g. neural_network or
+	//!                  packed_neural_network
+	//!
+	//! Splits an input matrix into chunks of rows and evaluates them on a
+	//! work_stealing_pool. Each worker thread has its own workspace, and
+	//! outputs are written directly into the caller's output matrix.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+	//! 	const nnet_type nnet( in_count, hidden_count, out_count, wts );
+	//! 	gamboge::parallel_evaluator< nnet_type > scorer( nnet, 8 );
+	//!
+	//! 	scorer.evaluate( &(outputs[0]), &(values[0]), row_count, in_count );
+	//! }
+	//! @endcode
+	template< typename Network >
+	class parallel_evaluator
+	{
+	public:
+		typedef typename Network::workspace_type workspace_type;
+
+		//! constructor, starts the worker threads
+		//!
+		//! @param nnet          network to evaluate, must outlive the evaluator
+		//! @param thread_count  worker count; 0 for one per hardware thread
+		//! @param cpus          CPU numbers for worker affinity, see
+		//!                      work_stealing_pool; empty for no affinity
+		//! @param chunk_rows    rows per chunk; 0 to choose from the row count
+		parallel_evaluator( const Network& nnet, std::size_t thread_count = 0,
+			const std::vector< int >& cpus = std::vector< int >( ),
+			std::size_t chunk_rows = 0 )
+		: nnet( nnet ),
+		  pool( thread_count, cpus ),
+		  chunk_rows( chunk_rows )
+		{
+			for ( std::size_t w = 0; w < pool.size( ); ++w )
+			{
+				workspaces.push_back( std::unique_ptr< workspace_type >( new workspace_type ) );
+			}
+		}
+
+		//! @return worker thread count
+		std::size_t threads( ) const
+		{
+			return pool.size( );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @return iterator marking end of result sequence
+		//!
+		//! See evaluate_neural_network_batch for the matrix layouts. Both
+		//! iterators must be random access.
+		template< typename OutIter, typename InIter >
+		OutIter evaluate( OutIter result, InIter values, std::size_t nrows, std::size_t stride )
+		{
+			const std::size_t ny = nnet.outputs( );
+			std::size_t chunk = chunk_rows;
+			if ( chunk == 0 )
+			{
+				// several chunks per worker so stealing can balance the load
+				chunk = std::max( std::size_t( 64 ), nrows / ( 8 * pool.size( ) ) );
+			}
+			const std::size_t nchunks = ( nrows + chunk - 1 ) / chunk;
+
+			pool.run( nchunks, [&]( std::size_t w, std::size_t c )
+				{
+					const std::size_t r0 = c * chunk;
+					const std::size_t rows = std::min( chunk, nrows - r0 );
+					nnet.evaluate_batch( result + r0 * ny, values + r0 * stride,
+						rows, stride, *workspaces[w] );
+				} );
+			return result + nrows * ny;
+		}
+
+	private:
+		const Network& nnet;
+		work_stealing_pool pool;
+		std::size_t chunk_rows;
+		std::vector< std::unique_ptr< workspace_type > > workspaces;
+	};
+}
+
+#endif
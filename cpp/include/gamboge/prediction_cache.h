@@ -0,0 +1,358 @@
+//! @file gamboge/prediction_cache.h
+//! gamboge neural network outputs memoized by input row
+
+#ifndef _GAMBOGE_PREDICTION_CACHE_H
+#define _GAMBOGE_PREDICTION_CACHE_H 1
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+namespace gamboge
+{
+	//! prediction_cache counters, see prediction_cache::stats
+	struct prediction_cache_stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		std::size_t size;       //!< rows cached
+		std::size_t capacity;   //!< most rows cached
+	};
+
+	//! network wrapper memoizing outputs by input row
+	//!
+	//! @tparam Network  network type providing inputs, outputs and
+	//!                  evaluate_batch with a workspace argument, e.g.
+	//!                  neural_network
+	//!
+	//! Rows are keyed on their exact values or, with a quantum @a q, on the
+	//! values rounded to the nearest multiple of @a q, so rows differing
+	//! by less than about @a q / 2 in each input share outputs. Keys are
+	//! compared in full, a hash collision is never a hit.
+	//!
+	//! The cache is divided into shards chosen by the row hash, each a
+	//! mutex-protected LRU list with a chained hash index. All storage is
+	//! allocated at construction: a miss evaluates the network outside the
+	//! shard lock, with a per-thread workspace, and then replaces the
+	//! shard's least recently used row in place, so eviction is O(1) and
+	//! does not allocate. A failed evaluation is not cached. A hit costs
+	//! O( @a nx ) to hash and compare the row plus a copy of the outputs.
+	//!
+	//! Example, inputs rounded to a multiple of 0.001
+	//! @code
+	//! {
+	//! 	typedef gamboge::neural_network< const double*, const double*, double*, unsigned > nnet_type;
+	//! 	const nnet_type nnet( in_count, hidden_count, out_count, &(wts[0]) );
+	//! 	gamboge::prediction_cache< nnet_type > cached( nnet, 100000, 16, 0.001 );
+	//!
+	//! 	cached.evaluate( &(outputs[0]), &(row[0]) );
+	//! 	gamboge::prediction_cache_stats s = cached.stats( );
+	//! }
+	//! @endcode
+	template< typename Network >
+	class prediction_cache
+	{
+	public:
+		typedef typename Network::value_type value_type;
+		typedef typename Network::workspace_type workspace_type;
+
+		//! constructor, empty cache
+		//!
+		//! @param nnet      network to evaluate, must outlive the cache
+		//! @param capacity  most rows cached, divided between the shards
+		//! @param shards    shard count, independently locked
+		//! @param quantum   key rounding precision; 0 to key on exact values
+		prediction_cache( const Network& nnet, std::size_t capacity, std::size_t shards = 16,
+			value_type quantum = static_cast< value_type >( 0 ) )
+		: nnet( nnet ),
+		  nx( nnet.inputs( ) ),
+		  ny( nnet.outputs( ) ),
+		  quantum( quantum )
+		{
+			shards = std::max( std::size_t( 1 ), std::min( shards, capacity ) );
+			const std::size_t per_shard = ( std::max( std::size_t( 1 ), capacity ) + shards - 1 ) / shards;
+			for ( std::size_t s = 0; s < shards; ++s )
+			{
+				parts.push_back( std::unique_ptr< shard >( new shard( per_shard, nx, ny ) ) );
+			}
+		}
+
+		//! Evaluate artificial neural network outputs, from the cache when
+		//! the row's key is cached
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return pointer marking end of result sequence, or @p result if
+		//!         the network evaluation failed
+		value_type* evaluate( value_type* result, const value_type* values )
+		{
+			uint64_t* key = key_buffer( );
+			const uint64_t h = make_key( values, key );
+			shard& s = *parts[ ( h >> 32 ) % parts.size( ) ];
+			{
+				std::lock_guard< std::mutex > lock( s.mutex );
+				const uint32_t e = s.find( h, key );
+				if ( e != shard::none )
+				{
+					++s.hits;
+					s.touch( e );
+					const value_type* out = &(s.outputs[ e * ny ]);
+					return std::copy( out, out + ny, result );
+				}
+				++s.misses;
+			}
+
+			if ( nnet.evaluate_batch( result, values, 1, nx, workspace( ) ) != result + ny )
+			{
+				return result;
+			}
+
+			std::lock_guard< std::mutex > lock( s.mutex );
+			uint32_t e = s.find( h, key );
+			if ( e == shard::none )
+			{
+				e = s.insert( h, key );
+			}
+			else
+			{
+				s.touch( e );
+			}
+			std::copy( result, result + ny, &(s.outputs[ e * ny ]) );
+			return result + ny;
+		}
+
+		//! @return counters summed over the shards
+		prediction_cache_stats stats( ) const
+		{
+			prediction_cache_stats r = { 0, 0, 0, 0, 0 };
+			for ( std::size_t k = 0; k < parts.size( ); ++k )
+			{
+				const shard& s = *parts[k];
+				std::lock_guard< std::mutex > lock( s.mutex );
+				r.hits += s.hits;
+				r.misses += s.misses;
+				r.evictions += s.evictions;
+				r.size += s.used;
+				r.capacity += s.capacity;
+			}
+			return r;
+		}
+
+		//! Remove all rows, keeping the counters
+		void clear( )
+		{
+			for ( std::size_t k = 0; k < parts.size( ); ++k )
+			{
+				shard& s = *parts[k];
+				std::lock_guard< std::mutex > lock( s.mutex );
+				s.clear( );
+			}
+		}
+
+		//! @return input count
+		std::size_t inputs( ) const
+		{
+			return nx;
+		}
+
+		//! @return output count
+		std::size_t outputs( ) const
+		{
+			return ny;
+		}
+
+	private:
+		// entries of a shard are slots in fixed arrays: keys, nx words per
+		// slot; outputs, ny values per slot; links of the LRU list, most
+		// recent first, and of the hash bucket chains
+		struct shard
+		{
+			static const uint32_t none = 0xFFFFFFFFU;
+
+			shard( std::size_t capacity, std::size_t nx, std::size_t ny )
+			: capacity( capacity ),
+			  nx( nx ),
+			  keys( capacity * nx ),
+			  outputs( capacity * ny ),
+			  hashes( capacity ),
+			  prev( capacity ),
+			  next( capacity ),
+			  chain( capacity ),
+			  hits( 0 ),
+			  misses( 0 ),
+			  evictions( 0 )
+			{
+				std::size_t nb = 1;
+				while ( nb < 2 * capacity )
+				{
+					nb *= 2;
+				}
+				buckets.resize( nb );
+				clear( );
+			}
+
+			void clear( )
+			{
+				std::fill( buckets.begin( ), buckets.end( ), static_cast< uint32_t >( none ) );
+				head = tail = none;
+				used = 0;
+			}
+
+			uint32_t find( uint64_t h, const uint64_t* key ) const
+			{
+				for ( uint32_t e = buckets[ h & ( buckets.size( ) - 1 ) ]; e != none; e = chain[e] )
+				{
+					if ( hashes[e] == h && std::equal( key, key + nx, &(keys[ e * nx ]) ) )
+					{
+						return e;
+					}
+				}
+				return none;
+			}
+
+			// claim a free slot, or evict the least recently used entry,
+			// and make it the most recent entry for key
+			uint32_t insert( uint64_t h, const uint64_t* key )
+			{
+				uint32_t e;
+				if ( used < capacity )
+				{
+					e = static_cast< uint32_t >( used++ );
+				}
+				else
+				{
+					e = tail;
+					unlink( e );
+					unchain( e );
+					++evictions;
+				}
+				hashes[e] = h;
+				std::copy( key, key + nx, &(keys[ e * nx ]) );
+				uint32_t& bucket = buckets[ h & ( buckets.size( ) - 1 ) ];
+				chain[e] = bucket;
+				bucket = e;
+				push_front( e );
+				return e;
+			}
+
+			void touch( uint32_t e )
+			{
+				if ( e != head )
+				{
+					unlink( e );
+					push_front( e );
+				}
+			}
+
+			void push_front( uint32_t e )
+			{
+				prev[e] = none;
+				next[e] = head;
+				if ( head != none )
+				{
+					prev[head] = e;
+				}
+				head = e;
+				if ( tail == none )
+				{
+					tail = e;
+				}
+			}
+
+			void unlink( uint32_t e )
+			{
+				( prev[e] != none ? next[ prev[e] ] : head ) = next[e];
+				( next[e] != none ? prev[ next[e] ] : tail ) = prev[e];
+			}
+
+			void unchain( uint32_t e )
+			{
+				uint32_t* link = &(buckets[ hashes[e] & ( buckets.size( ) - 1 ) ]);
+				while ( *link != e )
+				{
+					link = &(chain[ *link ]);
+				}
+				*link = chain[e];
+			}
+
+			mutable std::mutex mutex;
+			const std::size_t capacity;
+			const std::size_t nx;
+			std::vector< uint64_t > keys;
+			std::vector< value_type > outputs;
+			std::vector< uint64_t > hashes;
+			std::vector< uint32_t > prev;
+			std::vector< uint32_t > next;
+			std::vector< uint32_t > chain;
+			std::vector< uint32_t > buckets;
+			uint32_t head;
+			uint32_t tail;
+			std::size_t used;
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t evictions;
+		};
+
+		// per-thread key storage, grown to the largest input count used
+		uint64_t* key_buffer( ) const
+		{
+			static thread_local std::vector< uint64_t > buffer;
+			if ( buffer.size( ) < nx )
+			{
+				buffer.resize( nx );
+			}
+			return buffer.data( );
+		}
+
+		// per-thread network evaluation storage
+		static workspace_type& workspace( )
+		{
+			static thread_local workspace_type ws;
+			return ws;
+		}
+
+		// write the row's key words and return their hash
+		uint64_t make_key( const value_type* values, uint64_t* key ) const
+		{
+			uint64_t h = 0xCBF29CE484222325ULL;
+			for ( std::size_t k = 0; k < nx; ++k )
+			{
+				uint64_t w;
+				if ( quantum > static_cast< value_type >( 0 ) )
+				{
+					w = static_cast< uint64_t >( std::llround( values[k] / quantum ) );
+				}
+				else
+				{
+					// +0 and -0 are the same input
+					const value_type v = ( values[k] == static_cast< value_type >( 0 ) )
+						? static_cast< value_type >( 0 ) : values[k];
+					w = 0;
+					std::memcpy( &w, &v, sizeof( v ) < sizeof( w ) ? sizeof( v ) : sizeof( w ) );
+				}
+				key[k] = w;
+				h = ( h ^ w ) * 0x9E3779B97F4A7C15ULL;
+				h ^= h >> 29;
+			}
+			return h;
+		}
+
+		// not copyable
+		prediction_cache( const prediction_cache& );
+		prediction_cache& operator=( const prediction_cache& );
+
+		const Network& nnet;
+		const std::size_t nx;
+		const std::size_t ny;
+		const value_type quantum;
+		std::vector< std::unique_ptr< shard > > parts;
+	};
+}
+
+#endif
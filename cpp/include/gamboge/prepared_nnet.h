@@ -0,0 +1,397 @@
+//! @file gamboge/prepared_nnet.h
+//! gamboge neural network with input transforms folded into its weights
+
+#ifndef _GAMBOGE_PREPARED_NNET_H
+#define _GAMBOGE_PREPARED_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include <cstddef>
+#include <vector>
+
+namespace gamboge
+{
+	//! encoding of a raw input column as network inputs
+	//!
+	//! A numeric column feeds one network input through the affine
+	//! transform @a scale * @a x + @a offset, e.g. the centering and
+	//! scaling of R scale( ) or caret preProcess. A factor column holds a
+	//! level index 0 .. @a levels - 1 and stands for the indicator inputs
+	//! R creates for it: one per level (one-hot), or with treatment
+	//! contrasts ( @a baseline ) one per level but the first.
+	struct input_column
+	{
+		enum kind_type
+		{
+			numeric,                //!< one input, affine transform
+			factor                  //!< indicator inputs, level index
+		};
+
+		//! @return numeric column with the transform @p scale * x + @p offset
+		static input_column affine( double scale, double offset )
+		{
+			input_column c = { numeric, scale, offset, 1, false };
+			return c;
+		}
+
+		//! @return numeric column standardized as ( x - @p center ) / @p spread
+		static input_column standardized( double center, double spread )
+		{
+			return affine( 1.0 / spread, -center / spread );
+		}
+
+		//! @return factor column with an indicator input for each of
+		//!         @p levels levels
+		static input_column one_hot( std::size_t levels )
+		{
+			input_column c = { factor, 1.0, 0.0, levels, false };
+			return c;
+		}
+
+		//! @return factor column with treatment contrasts, an indicator
+		//!         input for each of @p levels levels but level 0
+		static input_column dummy( std::size_t levels )
+		{
+			input_column c = { factor, 1.0, 0.0, levels, true };
+			return c;
+		}
+
+		//! @return network inputs fed by the column
+		std::size_t width( ) const
+		{
+			return ( kind == numeric ) ? 1 : ( baseline ? levels - 1 : levels );
+		}
+
+		kind_type kind;
+		double scale;
+		double offset;
+		std::size_t levels;
+		bool baseline;
+	};
+
+	//! Fold per-input affine transforms into network weights
+	//!
+	//! @param topo     network topology
+	//! @param wts      start of weights sequence, R nnet$wts
+	//! @param scale    start of per-input scale sequence
+	//! @param offset   start of per-input offset sequence
+	//! @param result   start of output weights sequence
+	//! @return iterator marking end of result sequence
+	//!
+	//! Writes the weights of a network of topology @p topo whose outputs
+	//! for raw inputs @a x equal the outputs of the network @p wts for the
+	//! transformed inputs @p scale[k] * @a x[k] + @p offset[k]. Each weight
+	//! @a w applied to input @a k becomes @a w * @p scale[k], and
+	//! @a w * @p offset[k] is added to the unit's bias; this applies to the
+	//! hidden-layer units and to the output units fed by the inputs, with
+	//! skip-layer connections or without hidden-layer units. The folded
+	//! weights can be used with any of the evaluation functions, so raw
+	//! inputs need no preprocessing pass.
+	//!
+	//! Example, a neural_network taking unstandardized inputs
+	//! @code
+	//! {
+	//! 	std::vector< double > folded( topo.weight_count( ) );
+	//! 	gamboge::fold_input_transform( topo, &(wts[0]), &(scale[0]), &(offset[0]),
+	//! 		folded.begin( ) );
+	//! 	nnet_type nnet( topo, &(folded[0]) );
+	//! 	nnet.evaluate( nn_out, raw_in );
+	//! }
+	//! @endcode
+	template< typename InIterWt, typename InIter, typename OutIterWt >
+	OutIterWt
+	fold_input_transform( const nnet_topology& topo, InIterWt wts, InIter scale, InIter offset,
+		OutIterWt result )
+	{
+		typedef typename std::iterator_traits<InIter>::value_type VT;
+		const std::size_t nx = topo.inputs;
+		std::vector< VT > a( nx );
+		std::vector< VT > b( nx );
+		for ( std::size_t k = 0; k < nx; ++k, ++scale, ++offset )
+		{
+			a[k] = *scale;
+			b[k] = *offset;
+		}
+		const std::size_t nh = topo.hidden;
+		const std::size_t nskip = topo.skip_layer( ) ? nx : 0;
+		std::vector< VT > block( 1 + nh + nx );
+		for ( std::size_t u = 0; u < nh + topo.outputs; ++u )
+		{
+			// a unit's block: bias, hidden-layer weights (output units),
+			// then input weights
+			const std::size_t nhw = ( u < nh ) ? 0 : nh;
+			const std::size_t nin = ( u < nh ) ? nx : nskip;
+			const std::size_t n = 1 + nhw + nin;
+			for ( std::size_t j = 0; j < n; ++j, ++wts )
+			{
+				block[j] = *wts;
+			}
+			VT* w = &(block[ 1 + nhw ]);
+			for ( std::size_t k = 0; k < nin; ++k )
+			{
+				block[0] += w[k] * b[k];
+				w[k] *= a[k];
+			}
+			result = std::copy( block.begin( ), block.begin( ) + n, result );
+		}
+		return result;
+	}
+	//! artificial neural network taking raw input columns
+	//!
+	//! @tparam T         value type of weights, inputs and outputs
+	//! @tparam UnaryOp   output transform, see neural_network
+	//! @tparam HiddenOp  transfer function for hidden-layer units
+	//!
+	//! Built from the weights of a network trained on encoded inputs and
+	//! a description of how each raw column was encoded, see
+	//! input_column. The affine transforms of numeric columns are folded
+	//! into the weights as by fold_input_transform. For a factor column the
+	//! weights of its indicator inputs form a table indexed by level, so
+	//! the column contributes a single looked-up weight to each unit rather
+	//! than a multiply-add for every mostly-zero indicator. A raw row holds
+	//! one value per column, factor columns holding the level index; a
+	//! level outside 0 .. @a levels - 1 contributes nothing, as if all the
+	//! column's indicators were 0.
+	//!
+	//! Example, a network trained on standardized Sepal.Length and
+	//! Sepal.Width and a dummy-coded 3 level Species factor
+	//! @code
+	//! {
+	//! 	const gamboge::input_column columns[ ] = {
+	//! 		gamboge::input_column::standardized( 5.843, 0.828 ),
+	//! 		gamboge::input_column::standardized( 3.057, 0.436 ),
+	//! 		gamboge::input_column::dummy( 3 )
+	//! 	};
+	//! 	gamboge::prepared_neural_network< double > pnet(
+	//! 		gamboge::nnet_topology( 4, hidden_count, out_count ), wts, columns, 3 );
+	//! 	const double raw[ ] = { 6.3, 2.9, 2 };
+	//! 	pnet.evaluate( nn_out, raw );
+	//! }
+	//! @endcode
+	template< typename T, typename UnaryOp = logistic_output< T >,
+		typename HiddenOp = logistic_output< T > >
+	class prepared_neural_network
+	{
+	public:
+		typedef T value_type;
+		typedef nnet_workspace< T > workspace_type;
+
+		//! constructor, folds the column encodings into the weights
+		//!
+		//! @param topo       units, skip-layer connections and output
+		//!                   transform of the network on encoded inputs
+		//! @param wts        start of weights sequence, R nnet$wts
+		//! @param columns    start of input_column sequence
+		//! @param ncolumns   raw column count
+		//! @param unaryop    output transform, see neural_network
+		//! @param hiddenop   transfer function for hidden-layer units
+		//!
+		//! If the columns do not feed exactly @a topo.inputs network inputs
+		//! the network is not valid and evaluation writes no outputs.
+		template< typename InIterWt, typename InIterCol >
+		prepared_neural_network( const nnet_topology& topo, InIterWt wts, InIterCol columns,
+			std::size_t ncolumns, UnaryOp unaryop = UnaryOp( ), HiddenOp hiddenop = HiddenOp( ) )
+		: topo( topo ),
+		  cols( columns, columns + ncolumns ),
+		  row_width( 0 ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop )
+		{
+			std::size_t width = 0;
+			for ( std::size_t c = 0; c < cols.size( ); ++c )
+			{
+				width += cols[c].width( );
+				row_width += ( cols[c].kind == input_column::numeric ) ? 1 : cols[c].levels;
+			}
+			if ( width == topo.inputs )
+			{
+				assign( wts );
+			}
+		}
+
+		//! @return whether the columns match the network inputs
+		bool valid( ) const
+		{
+			return !first_wts.empty( );
+		}
+
+		//! Evaluate artificial neural network outputs for a raw row
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of raw column value sequence
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result, const T* values ) const
+		{
+			return evaluate_batch( result, values, 1, cols.size( ), _thread_workspace< T >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many raw rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of raw matrix, rows stored consecutively
+		//! @param nrows    row count
+		//! @return pointer marking end of result sequence
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, cols.size( ), _thread_workspace< T >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many raw rows
+		//! using a workspace
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of raw matrix
+		//! @param nrows    row count
+		//! @param stride   distance between the starts of consecutive rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows, std::size_t stride,
+			workspace_type& ws ) const
+		{
+			const std::size_t nh = topo.hidden;
+			const std::size_t ny = topo.outputs;
+			T* unitsbuf = ws.reserve( nh + ny );
+			if ( unitsbuf == 0 || !valid( ) )
+			{
+				return result;
+			}
+			T* hidden_out = unitsbuf;
+			T* linout = unitsbuf + nh;
+			const std::size_t block = 1 + row_width;
+			const bool skip = topo.skip_layer( );
+			for ( std::size_t r = 0; r < nrows; ++r )
+			{
+				const T* x = values + r * stride;
+				for ( std::size_t h = 0; h < nh; ++h )
+				{
+					hidden_out[h] = hiddenop( gather( &(first_wts[ h * block ]), x ) );
+				}
+				for ( std::size_t o = 0; o < ny; ++o )
+				{
+					const T* w = &(output_wts[ o * ( 1 + nh ) ]);
+					T lo = std::inner_product( w + 1, w + 1 + nh, hidden_out, w[0] );
+					linout[o] = skip ? lo + gather( &(first_wts[ ( nh + o ) * block ]), x ) : lo;
+				}
+				result = _apply_output_mode( linout, ny, topo.mode, result, unaryop );
+			}
+			return result;
+		}
+
+		//! @return raw column count
+		std::size_t columns( ) const
+		{
+			return cols.size( );
+		}
+
+		//! @return network topology on encoded inputs
+		const nnet_topology& topology( ) const
+		{
+			return topo;
+		}
+
+	private:
+		// first-layer linear output of a unit for a raw row; the unit's
+		// block holds its bias and, per column, a weight or a level table
+		T gather( const T* w, const T* x ) const
+		{
+			T acc = w[0];
+			++w;
+			for ( std::size_t c = 0; c < cols.size( ); ++c )
+			{
+				if ( cols[c].kind == input_column::numeric )
+				{
+					acc += *w * x[c];
+					++w;
+				}
+				else
+				{
+					const T level = x[c];
+					if ( level >= static_cast< T >( 0 )
+						&& level < static_cast< T >( cols[c].levels ) )
+					{
+						acc += w[ static_cast< std::size_t >( level ) ];
+					}
+					w += cols[c].levels;
+				}
+			}
+			return acc;
+		}
+
+		// split the weights into first-layer blocks over the raw columns,
+		// for the hidden-layer units then the skip-layer part of the output
+		// units, and output-layer blocks of bias and hidden-layer weights
+		template< typename InIterWt >
+		void assign( InIterWt itw )
+		{
+			const std::size_t nx = topo.inputs;
+			const std::size_t nh = topo.hidden;
+			const std::size_t ny = topo.outputs;
+			const bool skip = topo.skip_layer( );
+			const std::size_t block = 1 + row_width;
+			first_wts.assign( ( nh + ( skip ? ny : 0 ) ) * block, static_cast< T >( 0 ) );
+			output_wts.assign( ny * ( 1 + nh ), static_cast< T >( 0 ) );
+			std::vector< T > in( nx );
+			for ( std::size_t u = 0; u < nh + ny; ++u )
+			{
+				T bias = *itw;
+				++itw;
+				if ( u >= nh )
+				{
+					T* ow = &(output_wts[ ( u - nh ) * ( 1 + nh ) ]);
+					ow[0] = bias;
+					bias = static_cast< T >( 0 );
+					for ( std::size_t j = 0; j < nh; ++j, ++itw )
+					{
+						ow[ 1 + j ] = *itw;
+					}
+					if ( !skip )
+					{
+						continue;
+					}
+				}
+				for ( std::size_t k = 0; k < nx; ++k, ++itw )
+				{
+					in[k] = *itw;
+				}
+				fold_unit( &(in[0]), bias, &(first_wts[ u * block ]) );
+			}
+		}
+
+		// fold a unit's bias and input weights into a block over the columns
+		void fold_unit( const T* in, T bias, T* w ) const
+		{
+			T* p = w + 1;
+			for ( std::size_t c = 0; c < cols.size( ); ++c )
+			{
+				const input_column& col = cols[c];
+				if ( col.kind == input_column::numeric )
+				{
+					bias += *in * static_cast< T >( col.offset );
+					*p = *in * static_cast< T >( col.scale );
+					++p;
+					++in;
+				}
+				else
+				{
+					// level 0 of a treatment-coded factor has no indicator
+					const std::size_t first = col.baseline ? 1 : 0;
+					for ( std::size_t level = first; level < col.levels; ++level, ++in )
+					{
+						p[level] = *in;
+					}
+					p += col.levels;
+				}
+			}
+			w[0] = bias;
+		}
+
+		nnet_topology topo;
+		std::vector< input_column > cols;
+		std::size_t row_width;           // weights per unit over the columns
+		UnaryOp unaryop;
+		HiddenOp hiddenop;
+		std::vector< T > first_wts;
+		std::vector< T > output_wts;
+	};
+}
+
+#endif
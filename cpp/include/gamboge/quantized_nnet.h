@@ -0,0 +1,374 @@
+//! @file gamboge/quantized_nnet.h
+//! gamboge neural network with integer weights
+
+#ifndef _GAMBOGE_QUANTIZED_NNET_H
+#define _GAMBOGE_QUANTIZED_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+namespace gamboge
+{
+	// evaluates through instrumented gamboge/nnet.h functions, see the
+	// inline namespace there
+#ifdef GAMBOGE_NNET_STATS
+	inline namespace _stats_on
+#else
+	inline namespace _stats_off
+#endif
+	{
+	//! @cond
+	//! largest quantized activation for a layer of @p nin inputs; the
+	//! activations are reduced below the range of Q when necessary so the
+	//! int32 accumulator cannot overflow
+	template< typename Q >
+	int32_t
+	_quantized_activation_max( std::size_t nin )
+	{
+		const int64_t qmax = std::numeric_limits< Q >::max( );
+		const int64_t limit = std::numeric_limits< int32_t >::max( )
+			/ ( qmax * static_cast< int64_t >( std::max( nin, std::size_t( 1 ) ) ) );
+		return static_cast< int32_t >( std::max( int64_t( 1 ), std::min( qmax, limit ) ) );
+	}
+
+	//! round @p v / @a scale to the nearest integer in [ -@p qmax, @p qmax ]
+	template< typename Q >
+	Q
+	_quantize( float v, float inv_scale, int32_t qmax )
+	{
+		float q = v * inv_scale;
+		q = std::min( std::max( q, -static_cast< float >( qmax ) ), static_cast< float >( qmax ) );
+		return static_cast< Q >( q + ( q >= 0.0F ? 0.5F : -0.5F ) );
+	}
+
+	//! layer of units with integer weights; unit u's linear output is
+	//! bias[u] + scale[u] * sum( wts[u*nin+k] * x[k] ), x quantized inputs
+	template< typename Q >
+	struct _quantized_layer
+	{
+		std::size_t nin;
+		std::size_t nunits;
+		std::vector< Q > wts;
+		std::vector< float > bias;
+		std::vector< float > scale;
+
+		// quantize the layer's weight blocks, each a bias followed by nin
+		// weights; quantum[k] is the value of one step of quantized input k
+		template< typename InIterWt >
+		InIterWt assign( InIterWt itw, std::size_t n, std::size_t units, const float* quantum )
+		{
+			const float qmax = static_cast< float >( std::numeric_limits< Q >::max( ) );
+			nin = n;
+			nunits = units;
+			wts.assign( nin * nunits, 0 );
+			bias.assign( nunits, 0.0F );
+			scale.assign( nunits, 1.0F );
+			std::vector< float > folded( nin );
+			for ( std::size_t u = 0; u < nunits; ++u )
+			{
+				bias[u] = static_cast< float >( *itw );
+				++itw;
+				float wmax = 0.0F;
+				for ( std::size_t k = 0; k < nin; ++k, ++itw )
+				{
+					folded[k] = static_cast< float >( *itw ) * quantum[k];
+					wmax = std::max( wmax, std::fabs( folded[k] ) );
+				}
+				if ( wmax > 0.0F )
+				{
+					scale[u] = wmax / qmax;
+				}
+				for ( std::size_t k = 0; k < nin; ++k )
+				{
+					wts[ u*nin + k ] = _quantize< Q >( folded[k], 1.0F / scale[u],
+						std::numeric_limits< Q >::max( ) );
+				}
+			}
+			return itw;
+		}
+
+		void apply( const Q* x, float* out ) const
+		{
+			for ( std::size_t u = 0; u < nunits; ++u )
+			{
+				const Q* w = &(wts[u*nin]);
+				int32_t acc = 0;
+				for ( std::size_t k = 0; k < nin; ++k )
+				{
+					acc += static_cast< int32_t >( w[k] ) * static_cast< int32_t >( x[k] );
+				}
+				out[u] = bias[u] + scale[u] * static_cast< float >( acc );
+			}
+		}
+	};
+	//! @endcond
+
+	//! artificial neural network with integer weights
+	//!
+	//! @tparam Q        weight and activation type, int8_t or int16_t
+	//! @tparam UnaryOp  output transform for a single output-layer unit
+	//!
+	//! Approximates evaluate_neural_network for float inputs and outputs.
+	//! Each unit's weights are stored as integers with a per-unit scale,
+	//! and inner products are accumulated in int32, so a model takes a
+	//! quarter (int8_t) or half (int16_t) of the storage of float weights.
+	//! Biases and scales remain float.
+	//!
+	//! Inputs are quantized with per-input ranges, values outside a range
+	//! being clamped to it. The ranges default to [ -1, 1 ]; calibrate
+	//! chooses them from a sample of input rows. Hidden-layer outputs lie
+	//! in [ 0, 1 ] and need no calibration. The scale of an input is folded
+	//! into the weights that multiply it before they are quantized. For
+	//! int16_t the activations use fewer than 16 bits where the layer's
+	//! input count would otherwise let the int32 accumulator overflow.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	gamboge::quantized_neural_network< int8_t > qnet( in_count, hidden_count,
+	//! 		out_count, wts );
+	//! 	float max_error = qnet.calibrate( wts, &(sample[0]), sample_rows );
+	//! 	qnet.evaluate( nn_out, nn_in );
+	//! }
+	//! @endcode
+	template< typename Q, typename UnaryOp = logistic_output< float > >
+	class quantized_neural_network
+	{
+	public:
+		typedef float value_type;
+
+		//! constructor, quantizes the network weights for inputs in [ -1, 1 ]
+		//!
+		//! @param n        input count
+		//! @param m        hidden-layer count
+		//! @param k        output count
+		//! @param wts      start of weights sequence, see evaluate_neural_network
+		//! @param unaryop  output transform for a single output-layer unit
+		template< typename InIterWt >
+		quantized_neural_network( std::size_t n, std::size_t m, std::size_t k, InIterWt wts,
+			UnaryOp unaryop = UnaryOp( ) )
+		: input_count( n ),
+		  hidden_count( m ),
+		  output_count( k ),
+		  input_range( n, 1.0F ),
+		  unaryop( unaryop )
+		{
+			quantize( wts );
+		}
+
+		//! Choose the input ranges from sample rows and quantize the weights
+		//!
+		//! @param wts      start of weights sequence, as given to the
+		//!                 constructor
+		//! @param sample   start of sample input matrix, rows stored
+		//!                 consecutively
+		//! @param nrows    sample row count
+		//! @return maximum absolute difference over the sample between the
+		//!         outputs of this network and of evaluate_neural_network
+		//!         with the float weights
+		//!
+		//! Each input's range is the largest magnitude of that input in the
+		//! sample.
+		template< typename InIterWt >
+		float calibrate( InIterWt wts, const float* sample, std::size_t nrows )
+		{
+			std::fill( input_range.begin( ), input_range.end( ), 0.0F );
+			for ( std::size_t r = 0; r < nrows; ++r )
+			{
+				for ( std::size_t k = 0; k < input_count; ++k )
+				{
+					input_range[k] = std::max( input_range[k],
+						std::fabs( sample[ r*input_count + k ] ) );
+				}
+			}
+			for ( std::size_t k = 0; k < input_count; ++k )
+			{
+				if ( !( input_range[k] > 0.0F ) )
+				{
+					input_range[k] = 1.0F;
+				}
+			}
+			quantize( wts );
+
+			std::vector< float > wtsbuf( wts_count( ) );
+			for ( std::size_t k = 0; k < wtsbuf.size( ); ++k, ++wts )
+			{
+				wtsbuf[k] = static_cast< float >( *wts );
+			}
+			std::vector< float > reference( output_count );
+			std::vector< float > approx( output_count );
+			float max_error = 0.0F;
+			for ( std::size_t r = 0; r < nrows; ++r )
+			{
+				const float* x = sample + r * input_count;
+				evaluate_neural_network( x, &(wtsbuf[0]), &(reference[0]),
+					input_count, hidden_count, output_count, unaryop );
+				evaluate( &(approx[0]), x );
+				for ( std::size_t k = 0; k < output_count; ++k )
+				{
+					max_error = std::max( max_error, std::fabs( approx[k] - reference[k] ) );
+				}
+			}
+			return max_error;
+		}
+
+		//! Evaluate artificial neural network outputs
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return pointer marking end of result sequence
+		float* evaluate( float* result, const float* values ) const
+		{
+			return evaluate_batch( result, values, 1, input_count );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return pointer marking end of result sequence
+		float* evaluate_batch( float* result, const float* values, std::size_t nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, input_count );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @return pointer marking end of result sequence
+		//!
+		//! Buffers are taken from storage owned by the calling thread, so
+		//! repeated evaluations do not allocate.
+		float* evaluate_batch( float* result, const float* values, std::size_t nrows,
+			std::size_t stride ) const
+		{
+			Q* qbuf = _thread_workspace< Q >().reserve( input_count + hidden_count );
+			float* unitsbuf = _thread_workspace< float >().reserve( hidden_count + output_count );
+			if ( qbuf == 0 || unitsbuf == 0 )
+			{
+				return result;
+			}
+			Q* inq = &(qbuf[0]);
+			Q* hiddenq = &(qbuf[input_count]);
+			float* hidden_out = &(unitsbuf[0]);
+			float* linout = &(unitsbuf[hidden_count]);
+
+			for ( std::size_t r = 0; r < nrows; ++r )
+			{
+				const float* x = values + r * stride;
+				for ( std::size_t k = 0; k < input_count; ++k )
+				{
+					inq[k] = _quantize< Q >( x[k], input_inv_quantum[k], input_qmax );
+				}
+				if ( hidden_count > 0 )
+				{
+					hidden_layer.apply( inq, hidden_out );
+					const float inv_quantum = static_cast< float >( hidden_qmax );
+					for ( std::size_t h = 0; h < hidden_count; ++h )
+					{
+						hiddenq[h] = _quantize< Q >( logistic_output< float >()( hidden_out[h] ),
+							inv_quantum, hidden_qmax );
+					}
+					output_layer.apply( hiddenq, linout );
+				}
+				else  // hidden_count is 0
+				{
+					output_layer.apply( inq, linout );
+				}
+
+				if ( output_count > 1 )
+				{
+					_softmax( linout, linout + output_count, linout );
+					result = std::copy( linout, linout + output_count, result );
+				}
+				else
+				{
+					result = std::transform( linout, linout + output_count, result, unaryop );
+				}
+			}
+			return result;
+		}
+
+		//! @return input count
+		std::size_t inputs( ) const
+		{
+			return input_count;
+		}
+
+		//! @return hidden-layer unit count
+		std::size_t hidden( ) const
+		{
+			return hidden_count;
+		}
+
+		//! @return output count
+		std::size_t outputs( ) const
+		{
+			return output_count;
+		}
+
+		//! @return bytes of quantized weights, biases and scales
+		std::size_t weight_bytes( ) const
+		{
+			return ( hidden_layer.wts.size( ) + output_layer.wts.size( ) ) * sizeof( Q )
+				+ ( hidden_layer.bias.size( ) + hidden_layer.scale.size( ) + output_layer.bias.size( )
+					+ output_layer.scale.size( ) ) * sizeof( float );
+		}
+
+	private:
+		std::size_t wts_count( ) const
+		{
+			return ( hidden_count > 0 )
+				? hidden_count * ( 1 + input_count ) + output_count * ( 1 + hidden_count )
+				: output_count * ( 1 + input_count );
+		}
+
+		template< typename InIterWt >
+		void quantize( InIterWt wts )
+		{
+			input_qmax = _quantized_activation_max< Q >( input_count );
+			std::vector< float > quantum( std::max( input_count, hidden_count ) );
+			input_inv_quantum.resize( input_count );
+			for ( std::size_t k = 0; k < input_count; ++k )
+			{
+				quantum[k] = input_range[k] / static_cast< float >( input_qmax );
+				input_inv_quantum[k] = 1.0F / quantum[k];
+			}
+			if ( hidden_count > 0 )
+			{
+				wts = hidden_layer.assign( wts, input_count, hidden_count, &(quantum[0]) );
+				hidden_qmax = _quantized_activation_max< Q >( hidden_count );
+				std::fill( quantum.begin( ), quantum.begin( ) + hidden_count,
+					1.0F / static_cast< float >( hidden_qmax ) );
+				output_layer.assign( wts, hidden_count, output_count, &(quantum[0]) );
+			}
+			else
+			{
+				hidden_qmax = 1;
+				output_layer.assign( wts, input_count, output_count, &(quantum[0]) );
+			}
+		}
+
+		std::size_t input_count;
+		std::size_t hidden_count;
+		std::size_t output_count;
+		std::vector< float > input_range;
+		std::vector< float > input_inv_quantum;
+		int32_t input_qmax;
+		int32_t hidden_qmax;
+		_quantized_layer< Q > hidden_layer;
+		_quantized_layer< Q > output_layer;
+		UnaryOp unaryop;
+	};
+	}   // inline namespace
+}
+
+#endif
@@ -0,0 +1,399 @@
+//! @file gamboge/sparse_nnet.h
+//! gamboge neural network with pruned, compressed sparse row weights
+
+#ifndef _GAMBOGE_SPARSE_NNET_H
+#define _GAMBOGE_SPARSE_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace gamboge
+{
+	// evaluates through instrumented gamboge/nnet.h functions, see the
+	// inline namespace there
+#ifdef GAMBOGE_NNET_STATS
+	inline namespace _stats_on
+#else
+	inline namespace _stats_off
+#endif
+	{
+	//! @cond
+	//! layer of units with weights in compressed sparse row form; unit u's
+	//! linear output for a row of units x is
+	//! bias[u] + sum( values[j] * x[ cols[j] ] ), j in [ starts[u], starts[u+1] )
+	template< typename T >
+	struct _sparse_layer
+	{
+		std::vector< T > bias;
+		std::vector< uint32_t > starts;
+		std::vector< uint32_t > cols;
+		std::vector< T > values;
+
+		void clear( )
+		{
+			bias.clear( );
+			starts.assign( 1, 0 );
+			cols.clear( );
+			values.clear( );
+		}
+
+		void add_unit( T b )
+		{
+			bias.push_back( b );
+			starts.push_back( starts.back( ) );
+		}
+
+		void add_weight( uint32_t col, T w )
+		{
+			cols.push_back( col );
+			values.push_back( w );
+			++starts.back( );
+		}
+
+		std::size_t units( ) const
+		{
+			return bias.size( );
+		}
+
+		std::size_t bytes( ) const
+		{
+			return ( bias.size( ) + values.size( ) ) * sizeof( T )
+				+ ( starts.size( ) + cols.size( ) ) * sizeof( uint32_t );
+		}
+
+		// compute the layer for a block of rows of units, row r starting at
+		// units + r * stride, writing unit u's output to out[ r*out_stride + u ]
+		template< typename UnaryOp >
+		void apply( const T* units, std::size_t stride, std::size_t rows, T* out,
+			std::size_t out_stride, UnaryOp unaryop ) const
+		{
+			const uint32_t* c = cols.data( );
+			const T* v = values.data( );
+			for ( std::size_t u = 0; u < bias.size( ); ++u )
+			{
+				const uint32_t jb = starts[u];
+				const uint32_t je = starts[u+1];
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					const T* x = units + r * stride;
+					T o = bias[u];
+					for ( uint32_t j = jb; j < je; ++j )
+					{
+						o += v[j] * x[ c[j] ];
+					}
+					out[ r*out_stride + u ] = unaryop( o );
+				}
+			}
+		}
+	};
+	//! @endcond
+
+	//! artificial neural network with pruned weights in sparse form
+	//!
+	//! @tparam T         value type of weights, inputs and outputs
+	//! @tparam UnaryOp   output transform, see neural_network
+	//! @tparam HiddenOp  transfer function for hidden-layer units
+	//!
+	//! Built from dense weights in the evaluate_neural_network (R nnet$wts)
+	//! layout, keeping the weights whose magnitude exceeds a threshold.
+	//! Each layer is stored in compressed sparse row form: per unit a bias
+	//! and its kept weights with their column indices, so storage and the
+	//! multiply-adds of an evaluation are proportional to the kept weights.
+	//! Hidden-layer units left without any kept output-layer weight do not
+	//! affect the outputs and are dropped together with their weights.
+	//! Biases are always kept. With a threshold of 0 only zero weights are
+	//! dropped and the outputs equal those of evaluate_neural_network up
+	//! to the order of summation; max_error reports the difference for a
+	//! larger threshold.
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	gamboge::sparse_neural_network< float > snet( in_count, hidden_count,
+	//! 		out_count, &(wts[0]), 1E-3F );
+	//! 	float max_error = snet.max_error( &(wts[0]), &(sample[0]), sample_rows );
+	//! 	snet.evaluate( nn_out, nn_in );
+	//! }
+	//! @endcode
+	template< typename T, typename UnaryOp = logistic_output< T >,
+		typename HiddenOp = logistic_output< T > >
+	class sparse_neural_network
+	{
+	public:
+		typedef T value_type;
+		typedef nnet_workspace< T > workspace_type;
+
+		//! constructor, prunes and compresses the network weights
+		//!
+		//! @param n          input count
+		//! @param m          hidden-layer count
+		//! @param k          output count
+		//! @param wts        start of weights sequence, see evaluate_neural_network
+		//! @param threshold  weights of magnitude at most @p threshold are dropped
+		//! @param unaryop    output transform for a single output-layer unit
+		//! @param hiddenop   transfer function for hidden-layer units
+		template< typename InIterWt >
+		sparse_neural_network( std::size_t n, std::size_t m, std::size_t k, InIterWt wts,
+			T threshold = static_cast< T >( 0 ), UnaryOp unaryop = UnaryOp( ),
+			HiddenOp hiddenop = HiddenOp( ) )
+		: topo( n, m, k ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop )
+		{
+			assign( wts, threshold );
+		}
+
+		//! constructor, prunes and compresses the weights of a network topology
+		//!
+		//! @param topo       units, skip-layer connections and output transform
+		//! @param wts        start of weights sequence, R nnet$wts
+		//! @param threshold  weights of magnitude at most @p threshold are dropped
+		//! @param unaryop    output transform, see neural_network
+		//! @param hiddenop   transfer function for hidden-layer units
+		template< typename InIterWt >
+		sparse_neural_network( const nnet_topology& topo, InIterWt wts,
+			T threshold = static_cast< T >( 0 ), UnaryOp unaryop = UnaryOp( ),
+			HiddenOp hiddenop = HiddenOp( ) )
+		: topo( topo ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop )
+		{
+			assign( wts, threshold );
+		}
+
+		//! Compare with the dense network
+		//!
+		//! @param wts      start of weights sequence, as given to the
+		//!                 constructor
+		//! @param sample   start of sample input matrix, rows stored
+		//!                 consecutively
+		//! @param nrows    sample row count
+		//! @return maximum absolute difference over the sample between the
+		//!         outputs of this network and of evaluate_neural_network
+		//!         with the dense weights
+		template< typename InIterWt >
+		T max_error( InIterWt wts, const T* sample, std::size_t nrows ) const
+		{
+			std::vector< T > wtsbuf( topo.weight_count( ) );
+			for ( std::size_t k = 0; k < wtsbuf.size( ); ++k, ++wts )
+			{
+				wtsbuf[k] = *wts;
+			}
+			const std::size_t ny = topo.outputs;
+			std::vector< T > reference( nrows * ny );
+			std::vector< T > approx( nrows * ny );
+			evaluate_neural_network_batch( sample, topo.inputs, &(wtsbuf[0]), reference.data( ),
+				nrows, topo, unaryop, hiddenop, _thread_workspace< T >() );
+			evaluate_batch( approx.data( ), sample, nrows );
+			T err = static_cast< T >( 0 );
+			for ( std::size_t k = 0; k < approx.size( ); ++k )
+			{
+				err = std::max( err, static_cast< T >( std::fabs( approx[k] - reference[k] ) ) );
+			}
+			return err;
+		}
+
+		//! Evaluate artificial neural network outputs
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return pointer marking end of result sequence
+		T* evaluate( T* result, const T* values ) const
+		{
+			return evaluate_batch( result, values, 1, topo.inputs, _thread_workspace< T >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix, rows stored consecutively
+		//! @param nrows    input row count
+		//! @return pointer marking end of result sequence
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows ) const
+		{
+			return evaluate_batch( result, values, nrows, topo.inputs, _thread_workspace< T >() );
+		}
+
+		//! Evaluate artificial neural network outputs for many input rows
+		//! using a workspace
+		//!
+		//! @param result   start of output matrix
+		//! @param values   start of input matrix
+		//! @param nrows    input row count
+		//! @param stride   distance between the starts of consecutive input rows
+		//! @param ws       scratch storage for the evaluation
+		//! @return pointer marking end of result sequence
+		//!
+		//! See evaluate_neural_network_batch for the matrix layouts. Rows are
+		//! evaluated in blocks, each unit's kept weights applied to all rows
+		//! of a block.
+		T* evaluate_batch( T* result, const T* values, std::size_t nrows, std::size_t stride,
+			workspace_type& ws ) const
+		{
+			const std::size_t nx = topo.inputs;
+			const std::size_t nh = hidden_layer.units( );
+			const std::size_t ny = topo.outputs;
+			const std::size_t row_units = nx + nh;
+			std::size_t nb = std::min( nrows, _batch_block_rows< T >( nx, nh, ny ) );
+			if ( nb == 0 )
+			{
+				return result;
+			}
+
+			// each buffered row holds the inputs followed by the kept
+			// hidden-layer unit outputs, the columns of the layers' weights
+			T* unitsbuf = ws.reserve( nb * ( row_units + ny ) );
+			if ( unitsbuf == 0 )
+			{
+				return result;
+			}
+			T* linout = &(unitsbuf[ nb * row_units ]);
+
+			for ( std::size_t r0 = 0; r0 < nrows; r0 += nb )
+			{
+				std::size_t rows = std::min( nb, nrows - r0 );
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					const T* itx = values + ( r0 + r ) * stride;
+					std::copy( itx, itx + nx, &(unitsbuf[ r*row_units ]) );
+				}
+				hidden_layer.apply( unitsbuf, row_units, rows, unitsbuf + nx, row_units, hiddenop );
+				output_layer.apply( unitsbuf, row_units, rows, linout, ny, linear_output< T >() );
+				for ( std::size_t r = 0; r < rows; ++r )
+				{
+					result = _apply_output_mode( &(linout[ r*ny ]), ny, topo.mode, result, unaryop );
+				}
+			}
+			return result;
+		}
+
+		//! @return input count
+		std::size_t inputs( ) const
+		{
+			return topo.inputs;
+		}
+
+		//! @return hidden-layer unit count, including dropped units
+		std::size_t hidden( ) const
+		{
+			return topo.hidden;
+		}
+
+		//! @return output count
+		std::size_t outputs( ) const
+		{
+			return topo.outputs;
+		}
+
+		//! @return network topology
+		const nnet_topology& topology( ) const
+		{
+			return topo;
+		}
+
+		//! @return count of kept weights, excluding biases
+		std::size_t nonzeros( ) const
+		{
+			return hidden_layer.values.size( ) + output_layer.values.size( );
+		}
+
+		//! @return count of hidden-layer units evaluated
+		std::size_t hidden_kept( ) const
+		{
+			return hidden_layer.units( );
+		}
+
+		//! @return bytes of kept weights, biases and indices
+		std::size_t weight_bytes( ) const
+		{
+			return hidden_layer.bytes( ) + output_layer.bytes( );
+		}
+
+	private:
+		template< typename InIterWt >
+		void assign( InIterWt wts, T threshold )
+		{
+			const std::size_t nx = topo.inputs;
+			const std::size_t nh = topo.hidden;
+			const std::size_t ny = topo.outputs;
+			const std::size_t out_block = 1 + nh + ( topo.skip_layer( ) ? nx : 0 );
+			std::vector< T > dense( topo.weight_count( ) );
+			for ( std::size_t k = 0; k < dense.size( ); ++k, ++wts )
+			{
+				dense[k] = *wts;
+			}
+			const T* out_wts = dense.data( ) + nh * ( 1 + nx );
+
+			// a hidden-layer unit is kept if any output unit keeps its weight;
+			// column[h] is its position among the buffered units
+			std::vector< uint32_t > column( nh, 0 );
+			std::vector< bool > live( nh, false );
+			std::size_t nlive = 0;
+			for ( std::size_t h = 0; h < nh; ++h )
+			{
+				for ( std::size_t o = 0; o < ny && !live[h]; ++o )
+				{
+					live[h] = std::fabs( out_wts[ o*out_block + 1 + h ] ) > threshold;
+				}
+				if ( live[h] )
+				{
+					column[h] = static_cast< uint32_t >( nx + nlive );
+					++nlive;
+				}
+			}
+
+			hidden_layer.clear( );
+			for ( std::size_t h = 0; h < nh; ++h )
+			{
+				if ( !live[h] )
+				{
+					continue;
+				}
+				const T* w = dense.data( ) + h * ( 1 + nx );
+				hidden_layer.add_unit( w[0] );
+				for ( std::size_t k = 0; k < nx; ++k )
+				{
+					if ( std::fabs( w[ 1 + k ] ) > threshold )
+					{
+						hidden_layer.add_weight( static_cast< uint32_t >( k ), w[ 1 + k ] );
+					}
+				}
+			}
+
+			// output blocks: bias, hidden-layer weights, then with skip-layer
+			// connections (or no hidden layer) the input weights
+			output_layer.clear( );
+			for ( std::size_t o = 0; o < ny; ++o )
+			{
+				const T* w = out_wts + o * out_block;
+				output_layer.add_unit( w[0] );
+				for ( std::size_t h = 0; h < nh; ++h )
+				{
+					if ( live[h] && std::fabs( w[ 1 + h ] ) > threshold )
+					{
+						output_layer.add_weight( column[h], w[ 1 + h ] );
+					}
+				}
+				for ( std::size_t k = 0; k + 1 + nh < out_block; ++k )
+				{
+					if ( std::fabs( w[ 1 + nh + k ] ) > threshold )
+					{
+						output_layer.add_weight( static_cast< uint32_t >( k ), w[ 1 + nh + k ] );
+					}
+				}
+			}
+		}
+
+		nnet_topology topo;
+		UnaryOp unaryop;
+		HiddenOp hiddenop;
+		_sparse_layer< T > hidden_layer;
+		_sparse_layer< T > output_layer;
+	};
+	}   // inline namespace
+}
+
+#endif
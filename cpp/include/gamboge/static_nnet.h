@@ -0,0 +1,206 @@
+//! @file gamboge/static_nnet.h
+//! gamboge neural network with compile-time topology
+
+#ifndef _GAMBOGE_STATIC_NNET_H
+#define _GAMBOGE_STATIC_NNET_H 1
+
+#include "gamboge/nnet.h"
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+namespace gamboge
+{
+	//! @cond
+	//! unrolled inner product of N values added to an initial value,
+	//! accumulated in the same order as std::inner_product
+	template< std::size_t N >
+	struct _static_dot
+	{
+		template< typename T >
+		static constexpr T apply( const T* w, const T* x, T acc )
+		{
+			return _static_dot< N - 1 >::apply( w + 1, x + 1, acc + w[0] * x[0] );
+		}
+	};
+
+	template< >
+	struct _static_dot< 0 >
+	{
+		template< typename T >
+		static constexpr T apply( const T*, const T*, T acc )
+		{
+			return acc;
+		}
+	};
+
+	//! unrolled evaluation of a layer of NU units each having NIN inputs;
+	//! each unit's weight block is its bias followed by NIN weights
+	template< std::size_t NIN, std::size_t NU >
+	struct _static_layer
+	{
+		template< typename T, typename UnaryOp >
+		static void apply( const T* w, const T* in, T* out, UnaryOp unaryop )
+		{
+			out[0] = unaryop( _static_dot< NIN >::apply( w + 1, in, w[0] ) );
+			_static_layer< NIN, NU - 1 >::apply( w + 1 + NIN, in, out + 1, unaryop );
+		}
+	};
+
+	template< std::size_t NIN >
+	struct _static_layer< NIN, 0 >
+	{
+		template< typename T, typename UnaryOp >
+		static void apply( const T*, const T*, T*, UnaryOp )
+		{
+		}
+	};
+	//! @endcond
+
+	//! artificial neural network with compile-time topology
+	//!
+	//! @tparam T        value type of weights, inputs and outputs
+	//! @tparam NX       input count
+	//! @tparam NH       hidden-layer count
+	//! @tparam NY       output count
+	//! @tparam UnaryOp  output transform for a single output-layer unit
+	//! @tparam HiddenOp transfer function for hidden-layer units
+	//!
+	//! Computes the same outputs as evaluate_neural_network for a network
+	//! whose topology is fixed at compile time. Unit buffers are arrays on
+	//! the stack, the loops over inputs and units are unrolled, and the
+	//! choice between the softmax operator and @p UnaryOp is made at
+	//! compile time. Arithmetic is performed in the same order as
+	//! evaluate_neural_network, so results are identical unless the compiler
+	//! contracts multiply-add pairs differently in the two (e.g. building for
+	//! FMA targets with -ffp-contract=fast).
+	//!
+	//! Example
+	//! @code
+	//! {
+	//! 	static const double wts[ ] = {
+	//! 		 0.56974212, -1.5468268,  1.494846, -2.8907045,
+	//! 		-6.5020564,   3.0203401, -1.7088961, 2.5260361,
+	//! 		 3.393649,   -6.7710899, -7.2983476
+	//! 		};
+	//! 	const gamboge::static_neural_network< double, 3, 2, 1 > example_nnet( wts );
+	//! 	const double nn_in[ 3 ] = { 1.4, 6.8, 4.8 };
+	//! 	double nn_out[ 1 ];
+	//!
+	//! 	example_nnet.evaluate( nn_out, nn_in );
+	//! }
+	//! @endcode
+	template< typename T, std::size_t NX, std::size_t NH, std::size_t NY,
+		typename UnaryOp = logistic_output< T >, typename HiddenOp = logistic_output< T > >
+	class static_neural_network
+	{
+	public:
+		typedef T value_type;
+
+		static constexpr std::size_t input_count = NX;
+		static constexpr std::size_t hidden_count = NH;
+		static constexpr std::size_t output_count = NY;
+
+		//! number of weights, see evaluate_neural_network
+		static constexpr std::size_t weight_count = ( NH > 0 )
+			? NH * ( 1 + NX ) + NY * ( 1 + NH )
+			: NY * ( 1 + NX );
+
+		//! constructor, artificial neural network
+		//!
+		//! @param wts      start of the weight_count weights,
+		//!                 see evaluate_neural_network
+		//! @param unaryop  output transform for a single output-layer unit
+		//! @param hiddenop transfer function for hidden-layer units
+		constexpr explicit static_neural_network( const T* wts, UnaryOp unaryop = UnaryOp( ),
+			HiddenOp hiddenop = HiddenOp( ) )
+		: weights( wts ),
+		  unaryop( unaryop ),
+		  hiddenop( hiddenop )
+		{
+		}
+
+		//! Evaluate artificial neural network outputs
+		//!
+		//! @param result   start of output sequence
+		//! @param values   start of input value sequence
+		//! @return iterator marking end of result sequence
+		template< typename InIter, typename OutIter >
+		OutIter evaluate( OutIter result, InIter values ) const
+		{
+			std::array< T, NX > inbuf;
+			for ( std::size_t k = 0; k < NX; ++k )
+			{
+				inbuf[k] = *values++;
+			}
+
+			std::array< T, NY > linout;
+			evaluate_layers( inbuf.data(), linout.data(),
+				std::integral_constant< bool, ( NH > 0 ) >( ) );
+
+			return transform_outputs( linout, result,
+				std::integral_constant< bool, ( NY > 1 ) >( ) );
+		}
+
+		//! @return start of weights sequence
+		constexpr const T* weights_begin( ) const
+		{
+			return weights;
+		}
+
+	private:
+		// network inputs feed the hidden layer, the hidden layer feeds
+		// the output layer
+		void evaluate_layers( const T* in, T* linout, std::true_type ) const
+		{
+			std::array< T, NH > hidden_out;
+			_static_layer< NX, NH >::apply( weights, in, hidden_out.data(), hiddenop );
+			_static_layer< NH, NY >::apply( weights + NH * ( 1 + NX ),
+				hidden_out.data(), linout, linear_output< T >( ) );
+		}
+
+		// no hidden layer, network inputs feed the output layer
+		void evaluate_layers( const T* in, T* linout, std::false_type ) const
+		{
+			_static_layer< NX, NY >::apply( weights, in, linout,
+				linear_output< T >( ) );
+		}
+
+		// multiple outputs, softmax operator
+		template< typename OutIter >
+		OutIter transform_outputs( std::array< T, NY >& linout, OutIter result,
+			std::true_type ) const
+		{
+			_softmax( linout.begin(), linout.end(), linout.begin() );
+			return std::copy( linout.begin(), linout.end(), result );
+		}
+
+		// single output, output transform
+		template< typename OutIter >
+		OutIter transform_outputs( std::array< T, NY >& linout, OutIter result,
+			std::false_type ) const
+		{
+			*result = unaryop( linout[0] );
+			return ++result;
+		}
+
+		const T* weights;
+		UnaryOp unaryop;
+		HiddenOp hiddenop;
+	};
+
+	template< typename T, std::size_t NX, std::size_t NH, std::size_t NY, typename UnaryOp,
+		typename HiddenOp >
+	constexpr std::size_t static_neural_network< T, NX, NH, NY, UnaryOp, HiddenOp >::input_count;
+	template< typename T, std::size_t NX, std::size_t NH, std::size_t NY, typename UnaryOp,
+		typename HiddenOp >
+	constexpr std::size_t static_neural_network< T, NX, NH, NY, UnaryOp, HiddenOp >::hidden_count;
+	template< typename T, std::size_t NX, std::size_t NH, std::size_t NY, typename UnaryOp,
+		typename HiddenOp >
+	constexpr std::size_t static_neural_network< T, NX, NH, NY, UnaryOp, HiddenOp >::output_count;
+	template< typename T, std::size_t NX, std::size_t NH, std::size_t NY, typename UnaryOp,
+		typename HiddenOp >
+	constexpr std::size_t static_neural_network< T, NX, NH, NY, UnaryOp, HiddenOp >::weight_count;
+}
+
+#endif
@@ -0,0 +1,163 @@
+// gamboge neural network C interface, see gamboge/nnet_c.h
+
+#include "gamboge/nnet_c.h"
+#include "gamboge/model_file.h"
+#include "gamboge/nnet.h"
+#include <new>
+#include <vector>
+
+struct gamboge_nnet
+{
+	gamboge_nnet( const gamboge::nnet_topology& topo )
+	: topo( topo )
+	{
+	}
+
+	gamboge::nnet_topology topo;
+	std::vector< float > wts;
+};
+
+namespace
+{
+	bool valid_topology( int32_t nx, int32_t nh, int32_t ny, int32_t output )
+	{
+		return nx > 0 && nh >= 0 && ny > 0
+			&& output >= GAMBOGE_NNET_OUTPUT_DEFAULT && output <= GAMBOGE_NNET_OUTPUT_SOFTMAX;
+	}
+
+	// as above, for a topology read from a model file; the counts must
+	// also be representable as int32_t
+	bool valid_topology( const gamboge::nnet_topology& topo )
+	{
+		const std::size_t limit = INT32_MAX;
+		return topo.inputs <= limit && topo.hidden <= limit && topo.outputs <= limit
+			&& valid_topology( static_cast< int32_t >( topo.inputs ),
+				static_cast< int32_t >( topo.hidden ), static_cast< int32_t >( topo.outputs ),
+				static_cast< int32_t >( topo.mode ) );
+	}
+
+	// allocate a network and copy its weights; vector growth is the only
+	// operation that may throw
+	template< typename T >
+	int make_network( const gamboge::nnet_topology& topo, const T* wts, gamboge_nnet** nnet )
+	{
+		gamboge_nnet* p = new (std::nothrow) gamboge_nnet( topo );
+		if ( p == 0 )
+		{
+			return GAMBOGE_NNET_OUT_OF_MEMORY;
+		}
+		try
+		{
+			p->wts.assign( wts, wts + topo.weight_count( ) );
+		}
+		catch ( ... )
+		{
+			delete p;
+			return GAMBOGE_NNET_OUT_OF_MEMORY;
+		}
+		*nnet = p;
+		return GAMBOGE_NNET_OK;
+	}
+}
+
+uint32_t
+gamboge_nnet_abi_version( void )
+{
+	return GAMBOGE_NNET_ABI_VERSION;
+}
+
+int
+gamboge_nnet_create( int32_t nx, int32_t nh, int32_t ny, int32_t output, int32_t skip,
+	const float* wts, size_t wts_count, gamboge_nnet** nnet )
+{
+	if ( nnet == 0 || wts == 0 || !valid_topology( nx, nh, ny, output ) )
+	{
+		return GAMBOGE_NNET_INVALID_ARGUMENT;
+	}
+	const gamboge::nnet_topology topo( nx, nh, ny, static_cast< gamboge::output_mode >( output ),
+		skip != 0 );
+	if ( wts_count < topo.weight_count( ) )
+	{
+		return GAMBOGE_NNET_INVALID_ARGUMENT;
+	}
+	return make_network( topo, wts, nnet );
+}
+
+int
+gamboge_nnet_load( const char* path, gamboge_nnet** nnet )
+{
+	if ( path == 0 || nnet == 0 )
+	{
+		return GAMBOGE_NNET_INVALID_ARGUMENT;
+	}
+	gamboge::mapped_model model;
+	gamboge::model_status status = model.open( path );
+	if ( status != gamboge::model_ok )
+	{
+		return ( status == gamboge::model_open_failed ) ? GAMBOGE_NNET_OPEN_FAILED
+			: GAMBOGE_NNET_BAD_MODEL;
+	}
+	if ( !valid_topology( model.topology( ) ) )
+	{
+		return GAMBOGE_NNET_BAD_MODEL;
+	}
+	if ( model.weights< float >( ) != 0 )
+	{
+		return make_network( model.topology( ), model.weights< float >( ), nnet );
+	}
+	return make_network( model.topology( ), model.weights< double >( ), nnet );
+}
+
+void
+gamboge_nnet_free( gamboge_nnet* nnet )
+{
+	delete nnet;
+}
+
+int32_t
+gamboge_nnet_inputs( const gamboge_nnet* nnet )
+{
+	return nnet != 0 ? static_cast< int32_t >( nnet->topo.inputs ) : 0;
+}
+
+int32_t
+gamboge_nnet_hidden( const gamboge_nnet* nnet )
+{
+	return nnet != 0 ? static_cast< int32_t >( nnet->topo.hidden ) : 0;
+}
+
+int32_t
+gamboge_nnet_outputs( const gamboge_nnet* nnet )
+{
+	return nnet != 0 ? static_cast< int32_t >( nnet->topo.outputs ) : 0;
+}
+
+int
+gamboge_nnet_evaluate( const gamboge_nnet* nnet, const float* values, size_t values_count,
+	float* result, size_t result_count )
+{
+	if ( nnet == 0 || values == 0 || result == 0
+		|| values_count < nnet->topo.inputs || result_count < nnet->topo.outputs )
+	{
+		return GAMBOGE_NNET_INVALID_ARGUMENT;
+	}
+	float* end = gamboge::evaluate_neural_network_batch( values, nnet->topo.inputs,
+		nnet->wts.data( ), result, std::size_t( 1 ), nnet->topo );
+	return ( end == result + nnet->topo.outputs ) ? GAMBOGE_NNET_OK
+		: GAMBOGE_NNET_OUT_OF_MEMORY;
+}
+
+int
+gamboge_nnet_evaluate_batch( const gamboge_nnet* nnet, const float* values, size_t values_count,
+	size_t nrows, float* result, size_t result_count )
+{
+	if ( nnet == 0 || ( nrows > 0 && ( values == 0 || result == 0 ) )
+		|| values_count / nnet->topo.inputs < nrows || result_count / nnet->topo.outputs < nrows )
+	{
+		return GAMBOGE_NNET_INVALID_ARGUMENT;
+	}
+	float* end = gamboge::evaluate_neural_network_batch( values, nnet->topo.inputs,
+		nnet->wts.data( ), result, nrows, nnet->topo );
+	return ( end == result + nrows * nnet->topo.outputs ) ? GAMBOGE_NNET_OK
+		: GAMBOGE_NNET_OUT_OF_MEMORY;
+}
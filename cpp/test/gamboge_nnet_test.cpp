@@ -1,16 +1,106 @@
+// the tests run with evaluation counters compiled in
+#define GAMBOGE_NNET_STATS 1
+
 #include "gamboge/nnet.h"
+#include "gamboge/nnet_stats.h"
+#include "gamboge/static_nnet.h"
+#include "gamboge/nnet_simd.h"
+#include "gamboge/packed_nnet.h"
+#include "gamboge/parallel.h"
+#include "gamboge/model_file.h"
+#include "gamboge/ensemble.h"
+#include "gamboge/quantized_nnet.h"
+#include "gamboge/half_nnet.h"
+#include "gamboge/incremental_nnet.h"
+#include "gamboge/sparse_nnet.h"
+#include "gamboge/prepared_nnet.h"
+#include "gamboge/inference_queue.h"
+#include "gamboge/prediction_cache.h"
+#include "gamboge/nnet_c.h"
+#include "gamboge/model_handle.h"
 #include <string>
 #include <vector>
 #include <functional>
 #include <cmath>
 #include <algorithm>
 #include <numeric>
+#include <limits>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
 
 #include "cppunit/TestCase.h"
 #include "cppunit/TestSuite.h"
 #include "cppunit/TestResult.h"
 #include <cppunit/ui/text/TestRunner.h>
 
+// count of calls to the replacement operator new functions below, used
+// to verify that evaluation does not allocate; worker threads of the
+// parallel, queue and model handle tests allocate too
+static std::atomic< unsigned long > allocation_count( 0 );
+
+void* operator new( std::size_t n )
+{
+	allocation_count.fetch_add( 1, std::memory_order_relaxed );
+	void* p = std::malloc( n > 0 ? n : 1 );
+	if ( p == 0 )
+	{
+		throw std::bad_alloc( );
+	}
+	return p;
+}
+
+void* operator new[]( std::size_t n )
+{
+	return operator new( n );
+}
+
+void* operator new( std::size_t n, const std::nothrow_t& ) throw( )
+{
+	allocation_count.fetch_add( 1, std::memory_order_relaxed );
+	return std::malloc( n > 0 ? n : 1 );
+}
+
+void* operator new[]( std::size_t n, const std::nothrow_t& tag ) throw( )
+{
+	return operator new( n, tag );
+}
+
+void operator delete( void* p ) throw( )
+{
+	std::free( p );
+}
+
+void operator delete[]( void* p ) throw( )
+{
+	std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) throw( )
+{
+	std::free( p );
+}
+
+void operator delete[]( void* p, std::size_t ) throw( )
+{
+	std::free( p );
+}
+
+void operator delete( void* p, const std::nothrow_t& ) throw( )
+{
+	std::free( p );
+}
+
+void operator delete[]( void* p, const std::nothrow_t& ) throw( )
+{
+	std::free( p );
+}
+
 template< typename FP >
 struct absdiff : public std::binary_function< FP, FP, FP >
 {
@@ -20,6 +110,71 @@ struct absdiff : public std::binary_function< FP, FP, FP >
 	}
 };
 
+// uniformly distributed value in [ -1, 1 ) from a linear congruential
+// generator, reproducible across platforms
+static double next_value( unsigned& seed )
+{
+	seed = seed * 1103515245U + 12345U;
+	return static_cast<double>( ( seed >> 8 ) & 0xFFFFU ) / 32768.0 - 1.0;
+}
+
+// largest absolute difference between the analytic Jacobians of a
+// network and central differences of the network evaluated in double
+// precision, over the rows of verif_in; the outputs returned with the
+// Jacobians must match evaluate
+template< typename FP >
+double jacobian_error( const gamboge::nnet_topology& topo, const FP* wts, const FP* verif_in,
+	unsigned rows )
+{
+	const unsigned nx = static_cast<unsigned>( topo.inputs );
+	const unsigned ny = static_cast<unsigned>( topo.outputs );
+	typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+	const nnet_type nnet( topo, wts );
+	std::vector<FP> nn_out( rows * ny );
+	std::vector<FP> jac( rows * ny * nx );
+	CPPUNIT_ASSERT( nnet.evaluate_batch_with_jacobian( &(nn_out[0]), &(jac[0]), verif_in, rows )
+		== &(nn_out[0]) + nn_out.size( ) );
+
+	std::vector<FP> row_out( ny );
+	std::vector<FP> row_jac( ny * nx );
+	CPPUNIT_ASSERT( nnet.evaluate_with_jacobian( &(row_out[0]), &(row_jac[0]), verif_in )
+		== &(row_out[0]) + ny );
+	CPPUNIT_ASSERT( std::equal( row_jac.begin( ), row_jac.end( ), jac.begin( ) ) );
+	for ( unsigned r = 0; r < rows; ++r )
+	{
+		nnet.evaluate( &(row_out[0]), &(verif_in[r*nx]) );
+		CPPUNIT_ASSERT_LESS( static_cast<FP>( 1E-6 ), std::inner_product( row_out.begin( ),
+			row_out.end( ), &(nn_out[r*ny]), static_cast<FP>( 0 ), fmax, absdiff<FP>() ) );
+	}
+
+	typedef gamboge::neural_network< const double*, const double*, double*, unsigned > double_type;
+	const std::vector<double> double_wts( wts, wts + topo.weight_count( ) );
+	const double_type double_nnet( topo, &(double_wts[0]) );
+	const double step = 1E-5;
+	std::vector<double> x( nx );
+	std::vector<double> y_plus( ny );
+	std::vector<double> y_minus( ny );
+	double max_error = 0.0;
+	for ( unsigned r = 0; r < rows; ++r )
+	{
+		for ( unsigned k = 0; k < nx; ++k )
+		{
+			std::copy( &(verif_in[r*nx]), &(verif_in[(r+1)*nx]), x.begin( ) );
+			x[k] += step;
+			double_nnet.evaluate( &(y_plus[0]), &(x[0]) );
+			x[k] -= 2.0 * step;
+			double_nnet.evaluate( &(y_minus[0]), &(x[0]) );
+			for ( unsigned o = 0; o < ny; ++o )
+			{
+				const double fd = ( y_plus[o] - y_minus[o] ) / ( 2.0 * step );
+				max_error = std::max( max_error,
+					std::abs( fd - static_cast<double>( jac[ ( r*ny + o ) * nx + k ] ) ) );
+			}
+		}
+	}
+	return max_error;
+}
+
 template <typename FP>
 class gamboge_nnet_tester
 {
@@ -85,13 +240,700 @@ public:
 		delete[] nn_out;
 	}
 
+	void run_test_batch( )
+	{
+		// copy the verification inputs into a matrix with padded rows
+		// to exercise the row stride
+		const unsigned stride = in_count + 3;
+		std::vector<FP> padded_in( verif_count * stride, static_cast<FP>( 99 ) );
+		for ( unsigned k = 0; k < verif_count; ++k )
+		{
+			std::copy( &(verif_in[k*in_count]), &(verif_in[(k+1)*in_count]),
+				&(padded_in[k*stride]) );
+		}
+		std::vector<FP> nn_out( verif_count * out_count );
+
+		typename std::vector<FP>::iterator out_end = gamboge::evaluate_neural_network_batch(
+			padded_in.begin(), stride, wts, nn_out.begin(), verif_count,
+			in_count, hidden_count, out_count );
+		CPPUNIT_ASSERT( out_end == nn_out.end() );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (batch algorithm)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_class_batch( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+		nnet_type nnet_uut( in_count, hidden_count, out_count, wts );
+		std::vector<FP> nn_out( verif_count * out_count );
+
+		FP* out_end = nnet_uut.evaluate_batch( &(nn_out[0]), verif_in, verif_count );
+		CPPUNIT_ASSERT( out_end == &(nn_out[0]) + nn_out.size() );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (nnet class batch)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_no_allocation( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+		nnet_type nnet_uut( in_count, hidden_count, out_count, wts );
+		gamboge::nnet_workspace<FP> ws( in_count, hidden_count, out_count );
+		std::vector<FP> nn_out( verif_count * out_count );
+
+		// first evaluations size the per-thread and batch workspaces
+		nnet_uut.evaluate( &(nn_out[0]), verif_in );
+		nnet_uut.evaluate_batch( &(nn_out[0]), verif_in, verif_count );
+		nnet_uut.evaluate_batch( &(nn_out[0]), verif_in, verif_count, in_count, ws );
+
+		const unsigned long start_count = allocation_count.load( std::memory_order_relaxed );
+		for ( unsigned k = 0; k < verif_count; ++k )
+		{
+			gamboge::evaluate_neural_network( &(verif_in[k*in_count]), wts,
+				&(nn_out[k*out_count]), in_count, hidden_count, out_count );
+			gamboge::evaluate_neural_network( &(verif_in[k*in_count]), wts,
+				&(nn_out[k*out_count]), in_count, hidden_count, out_count, ws );
+			nnet_uut.evaluate( &(nn_out[k*out_count]), &(verif_in[k*in_count]) );
+			nnet_uut.evaluate( &(nn_out[k*out_count]), &(verif_in[k*in_count]), ws );
+		}
+		nnet_uut.evaluate_batch( &(nn_out[0]), verif_in, verif_count );
+		nnet_uut.evaluate_batch( &(nn_out[0]), verif_in, verif_count, in_count, ws );
+
+		CPPUNIT_ASSERT_EQUAL_MESSAGE( "check evaluation does not allocate",
+			start_count, allocation_count.load( std::memory_order_relaxed ) );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (workspace)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	template< std::size_t NX, std::size_t NH, std::size_t NY >
+	void run_test_static( )
+	{
+		typedef gamboge::static_neural_network< FP, NX, NH, NY > nnet_type;
+		CPPUNIT_ASSERT( nnet_type::input_count == in_count );
+		CPPUNIT_ASSERT( nnet_type::hidden_count == hidden_count );
+		CPPUNIT_ASSERT( nnet_type::output_count == out_count );
+
+		const nnet_type nnet_uut( wts );
+		FP max_error = static_cast<FP>( 0 );
+		std::vector<FP> nn_out( out_count );
+		std::vector<FP> generic_out( out_count );
+
+		for ( unsigned k = 0; k < verif_count; ++k )
+		{
+			typename std::vector<FP>::iterator out_end =
+				nnet_uut.evaluate( nn_out.begin(), &(verif_in[k*in_count]) );
+			CPPUNIT_ASSERT( out_end == nn_out.end() );
+
+			// results are identical to the generic algorithm
+			gamboge::evaluate_neural_network( &(verif_in[k*in_count]), wts,
+				generic_out.begin(), in_count, hidden_count, out_count );
+			CPPUNIT_ASSERT( nn_out == generic_out );
+
+			max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+				&(expected_out[k*out_count]), max_error,
+				fmax, absdiff<FP>() );
+		}
+
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (static nnet)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_simd( )
+	{
+		gamboge::nnet_workspace<FP> ws;
+		std::vector<FP> nn_out( out_count );
+
+		// each kernel level supported by the running CPU
+		for ( int level = gamboge::simd_scalar;
+			level <= gamboge::simd_supported_level( ); ++level )
+		{
+			gamboge::simd_kernels<FP> kernels =
+				gamboge::simd_select<FP>( static_cast<gamboge::simd_level>( level ) );
+			CPPUNIT_ASSERT_EQUAL( level, static_cast<int>( kernels.level ) );
+			FP max_error = static_cast<FP>( 0 );
+
+			for ( unsigned k = 0; k < verif_count; ++k )
+			{
+				gamboge::evaluate_neural_network_simd( &(verif_in[k*in_count]), wts,
+					&(nn_out[0]), in_count, hidden_count, out_count,
+					gamboge::logistic_output<FP>(), kernels, ws );
+
+				max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+					&(expected_out[k*out_count]), max_error,
+					fmax, absdiff<FP>() );
+			}
+
+			CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (simd kernels)",
+				CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+		}
+
+		std::vector<FP> batch_out( verif_count * out_count );
+		gamboge::evaluate_neural_network_batch_simd( verif_in, in_count, wts,
+			&(batch_out[0]), verif_count, in_count, hidden_count, out_count );
+		FP max_error = std::inner_product( batch_out.begin(), batch_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (simd batch)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_packed( )
+	{
+		typedef gamboge::packed_neural_network< FP > nnet_type;
+		std::vector<FP> nn_out( verif_count * out_count );
+
+		// each kernel level supported by the running CPU
+		for ( int level = gamboge::simd_scalar;
+			level <= gamboge::simd_supported_level( ); ++level )
+		{
+			const nnet_type nnet_uut( in_count, hidden_count, out_count, wts,
+				gamboge::logistic_output<FP>(),
+				gamboge::simd_select<FP>( static_cast<gamboge::simd_level>( level ) ) );
+			FP max_error = static_cast<FP>( 0 );
+
+			for ( unsigned k = 0; k < verif_count; ++k )
+			{
+				FP* out_end = nnet_uut.evaluate( &(nn_out[0]), &(verif_in[k*in_count]) );
+				CPPUNIT_ASSERT( out_end == &(nn_out[0]) + out_count );
+
+				max_error = std::inner_product( nn_out.begin(), nn_out.begin() + out_count,
+					&(expected_out[k*out_count]), max_error,
+					fmax, absdiff<FP>() );
+			}
+
+			CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (packed nnet)",
+				CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+
+			FP* out_end = nnet_uut.evaluate_batch( &(nn_out[0]), verif_in, verif_count );
+			CPPUNIT_ASSERT( out_end == &(nn_out[0]) + nn_out.size() );
+			max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+				expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+
+			CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (packed nnet batch)",
+				CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+		}
+	}
+
+	void run_test_parallel( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+		const nnet_type nnet( in_count, hidden_count, out_count, wts );
+		const gamboge::packed_neural_network< FP > packed_nnet( in_count, hidden_count,
+			out_count, wts );
+		std::vector<FP> nn_out( verif_count * out_count );
+
+		// small chunks, more chunks than workers, so workers steal
+		gamboge::parallel_evaluator< nnet_type > scorer( nnet, 3,
+			std::vector<int>( ), 3 );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 3 ), scorer.threads( ) );
+		for ( int pass = 0; pass < 4; ++pass )
+		{
+			std::fill( nn_out.begin(), nn_out.end(), static_cast<FP>( -1 ) );
+			FP* out_end = scorer.evaluate( &(nn_out[0]), verif_in, verif_count, in_count );
+			CPPUNIT_ASSERT( out_end == &(nn_out[0]) + nn_out.size() );
+
+			FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+				expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+			CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (parallel)",
+				CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+		}
+
+		gamboge::parallel_evaluator< gamboge::packed_neural_network< FP > > packed_scorer(
+			packed_nnet, 2, std::vector<int>( 1, 0 ) );
+		std::fill( nn_out.begin(), nn_out.end(), static_cast<FP>( -1 ) );
+		packed_scorer.evaluate( &(nn_out[0]), verif_in, verif_count, in_count );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (parallel packed)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_jacobian( )
+	{
+		double max_error = jacobian_error( gamboge::nnet_topology( in_count, hidden_count,
+			out_count ), wts, verif_in, verif_count );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check Jacobian against finite differences",
+			CPPUNIT_ASSERT_LESS( 5E-5, max_error ) );
+
+		max_error = jacobian_error( gamboge::nnet_topology( in_count, hidden_count,
+			out_count, gamboge::output_linear ), wts, verif_in, verif_count );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check Jacobian against finite differences (linear)",
+			CPPUNIT_ASSERT_LESS( 5E-5, max_error ) );
+
+		// a workspace too large to allocate; nothing is evaluated
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, std::size_t > huge_type;
+		const huge_type huge_nnet( gamboge::nnet_topology(
+			std::numeric_limits< std::size_t >::max( ) / ( 16 * sizeof( FP ) ), 0, 2 ), wts );
+		typename huge_type::workspace_type ws;
+		std::vector<FP> nn_out( 4 );
+		std::vector<FP> jac( 4 );
+		CPPUNIT_ASSERT( huge_nnet.evaluate_with_jacobian( &(nn_out[0]), &(jac[0]), verif_in, ws )
+			== &(nn_out[0]) );
+		CPPUNIT_ASSERT( huge_nnet.evaluate_batch_with_jacobian( &(nn_out[0]), &(jac[0]), verif_in,
+			2, 0, ws ) == &(nn_out[0]) );
+	}
+
+	void run_test_columns( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+		const nnet_type nnet( in_count, hidden_count, out_count, wts );
+
+		// the verification rows transposed, one column per input
+		std::vector<FP> column_major( in_count * verif_count );
+		std::vector<const FP*> columns( in_count );
+		for ( unsigned k = 0; k < in_count; ++k )
+		{
+			for ( unsigned r = 0; r < verif_count; ++r )
+			{
+				column_major[ k*verif_count + r ] = verif_in[ r*in_count + k ];
+			}
+			columns[k] = &(column_major[ k*verif_count ]);
+		}
+
+		std::vector<FP> nn_out( verif_count * out_count );
+		FP* out_end = gamboge::evaluate_neural_network_columns( &(columns[0]), wts,
+			&(nn_out[0]), verif_count, nnet.topology( ) );
+		CPPUNIT_ASSERT( out_end == &(nn_out[0]) + nn_out.size() );
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (columns)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+
+		std::fill( nn_out.begin(), nn_out.end(), static_cast<FP>( -1 ) );
+		nnet.evaluate_column_major( &(nn_out[0]), &(column_major[0]), verif_count, verif_count );
+		max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (column-major)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+
+		std::fill( nn_out.begin(), nn_out.end(), static_cast<FP>( -1 ) );
+		nnet.evaluate_columns( &(nn_out[0]), columns.begin(), verif_count );
+		max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (columns method)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_queue( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+		const nnet_type nnet( in_count, hidden_count, out_count, wts );
+		std::vector<FP> nn_out( verif_count * out_count, static_cast<FP>( -1 ) );
+
+		{
+			// a batch the size of the request count is dispatched when full
+			gamboge::inference_queue< nnet_type > queue( nnet, verif_count,
+				std::chrono::seconds( 10 ) );
+			std::vector< std::future< std::vector<FP> > > results;
+			for ( unsigned k = 0; k < verif_count; ++k )
+			{
+				results.push_back( queue.submit( &(verif_in[k*in_count]) ) );
+			}
+			for ( unsigned k = 0; k < verif_count; ++k )
+			{
+				std::vector<FP> row = results[k].get( );
+				CPPUNIT_ASSERT_EQUAL( static_cast<std::size_t>( out_count ), row.size() );
+				std::copy( row.begin(), row.end(), &(nn_out[k*out_count]) );
+			}
+			CPPUNIT_ASSERT_EQUAL( std::size_t( 1 ), queue.batches( ) );
+			CPPUNIT_ASSERT_EQUAL( std::size_t( verif_count ), queue.requests( ) );
+		}
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (queue)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+
+		// callbacks; a partial batch is dispatched at its deadline, and
+		// queued requests are completed before the queue is destroyed
+		std::fill( nn_out.begin(), nn_out.end(), static_cast<FP>( -1 ) );
+		{
+			gamboge::inference_queue< nnet_type > queue( nnet, 2 * verif_count,
+				std::chrono::microseconds( 100 ) );
+			for ( unsigned k = 0; k < verif_count; ++k )
+			{
+				FP* out = &(nn_out[k*out_count]);
+				const unsigned ny = out_count;
+				queue.submit( &(verif_in[k*in_count]), [out, ny]( const FP* outputs )
+					{
+						std::copy( outputs, outputs + ny, out );
+					} );
+			}
+		}
+		max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (queue callbacks)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_model_file( )
+	{
+		const char* path = "gamboge_nnet_test.gnnm";
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_ok, gamboge::write_model_file( path,
+			in_count, hidden_count, out_count, wts,
+			out_count > 1 ? gamboge::model_output_softmax : gamboge::model_output_logistic ) );
+
+		gamboge::mapped_model model;
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_ok, model.open( path ) );
+		CPPUNIT_ASSERT_EQUAL( in_count, model.header().input_count );
+		CPPUNIT_ASSERT_EQUAL( hidden_count, model.header().hidden_count );
+		CPPUNIT_ASSERT_EQUAL( out_count, model.header().output_count );
+		CPPUNIT_ASSERT( model.weights<double>() == 0 );
+
+		// the mapped weights are used in place, aligned within the file
+		const FP* mapped_wts = model.weights<FP>();
+		CPPUNIT_ASSERT( reinterpret_cast<std::size_t>( mapped_wts ) % 64 == 0 );
+		CPPUNIT_ASSERT( std::equal( mapped_wts, mapped_wts + model.header().weight_count, wts ) );
+
+		gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet =
+			model.network<FP>();
+		std::vector<FP> nn_out( verif_count * out_count );
+		nnet.evaluate_batch( &(nn_out[0]), verif_in, verif_count );
+
+		// the checked accessor refuses a network of another element type
+		const double unused_wts[ 2 ] = { 0.0, 0.0 };
+		gamboge::neural_network< const double*, const double*, double*, unsigned > double_nnet(
+			1, 0, 1, unused_wts );
+		CPPUNIT_ASSERT( !model.network<double>( double_nnet ) );
+		CPPUNIT_ASSERT( model.network<FP>( nnet ) );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (model file)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+		model.close( );
+
+		// a damaged weight is detected by the checksum
+		std::FILE* f = std::fopen( path, "r+b" );
+		CPPUNIT_ASSERT( f != 0 );
+		std::fseek( f, 64 + 1, SEEK_SET );
+		std::fputc( 0x5A, f );
+		std::fclose( f );
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_bad_checksum, model.open( path ) );
+		CPPUNIT_ASSERT( !model.is_open( ) );
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_ok, model.open( path, false ) );
+		model.close( );
+
+		// counts, weight count last, rejected with a consistent weight
+		// count: no inputs; no outputs; a true weight count wrapping to
+		// the header's 32 bits, 1 * ( 1 + 0xFFFFFFFF ) + 1 * ( 1 + 1 ) is
+		// 2 modulo 2^32
+		const uint32_t bad_counts[ 3 ][ 4 ] = {
+			{ 0U, 1U, 1U, 3U }, { 2U, 1U, 0U, 3U }, { 0xFFFFFFFFU, 1U, 1U, 2U }
+			};
+		for ( unsigned k = 0; k < 3; ++k )
+		{
+			f = std::fopen( path, "r+b" );
+			CPPUNIT_ASSERT( f != 0 );
+			std::fseek( f, 12, SEEK_SET );
+			std::fwrite( bad_counts[k], sizeof( bad_counts[k] ), 1, f );
+			std::fclose( f );
+			CPPUNIT_ASSERT_EQUAL( gamboge::model_bad_header, model.open( path, false ) );
+			CPPUNIT_ASSERT( !model.is_open( ) );
+		}
+
+		// topologies without inputs or outputs are not written
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_write_failed, gamboge::write_model_file( path,
+			gamboge::nnet_topology( 2, 1, 0 ), wts ) );
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_write_failed, gamboge::write_model_file( path,
+			gamboge::nnet_topology( 0, 1, 1 ), wts ) );
+
+		std::remove( path );
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_open_failed, model.open( path ) );
+	}
+
+	void run_test_quantized( )
+	{
+		const unsigned wt_count = ( hidden_count > 0 )
+			? hidden_count * ( 1 + in_count ) + out_count * ( 1 + hidden_count )
+			: out_count * ( 1 + in_count );
+		const std::vector<float> float_wts( wts, wts + wt_count );
+		const std::vector<float> float_in( verif_in, verif_in + verif_count * in_count );
+
+		// calibrated on the verification inputs; the reported error is the
+		// error of the quantized outputs
+		gamboge::quantized_neural_network<int8_t> qnet8( in_count, hidden_count, out_count,
+			float_wts.begin() );
+		gamboge::quantized_neural_network<int16_t> qnet16( in_count, hidden_count, out_count,
+			&(float_wts[0]) );
+		const float error8 = qnet8.calibrate( float_wts.begin(), &(float_in[0]), verif_count );
+		const float error16 = qnet16.calibrate( &(float_wts[0]), &(float_in[0]), verif_count );
+		CPPUNIT_ASSERT_LESS( 0.05F, error8 );
+		CPPUNIT_ASSERT_LESS( 5E-4F, error16 );
+		CPPUNIT_ASSERT( qnet8.weight_bytes() < wt_count * sizeof( float ) );
+
+		std::vector<float> nn_out( verif_count * out_count );
+		qnet16.evaluate_batch( &(nn_out[0]), &(float_in[0]), verif_count );
+		float max_error = 0.0F;
+		for ( unsigned k = 0; k < nn_out.size(); ++k )
+		{
+			max_error = std::max( max_error,
+				std::fabs( nn_out[k] - static_cast<float>( expected_out[k] ) ) );
+		}
+		CPPUNIT_ASSERT_LESS( 5E-4F, max_error );
+	}
+
+	// 16-bit weights at each kernel level; the outputs cannot meet the float
+	// tolerance, so the error is checked against a tolerance for the format
+	template< typename Format >
+	float half_error( float tolerance )
+	{
+		const unsigned wt_count = ( hidden_count > 0 )
+			? hidden_count * ( 1 + in_count ) + out_count * ( 1 + hidden_count )
+			: out_count * ( 1 + in_count );
+		const std::vector<float> float_wts( wts, wts + wt_count );
+		const std::vector<float> float_in( verif_in, verif_in + verif_count * in_count );
+
+		const gamboge::half_neural_network< Format > scalar_net( in_count, hidden_count, out_count,
+			&(float_wts[0]), gamboge::logistic_output<float>(),
+			gamboge::half_select< Format >( gamboge::simd_scalar ) );
+		std::vector<float> scalar_out( verif_count * out_count );
+		CPPUNIT_ASSERT( scalar_net.evaluate_batch( &(scalar_out[0]), &(float_in[0]), verif_count )
+			== &(scalar_out[0]) + scalar_out.size() );
+		CPPUNIT_ASSERT( scalar_net.weight_bytes() < wt_count * sizeof( float ) );
+
+		float max_error = 0.0F;
+		for ( unsigned k = 0; k < scalar_out.size(); ++k )
+		{
+			max_error = std::max( max_error,
+				std::fabs( scalar_out[k] - static_cast<float>( expected_out[k] ) ) );
+		}
+		CPPUNIT_ASSERT_LESS( tolerance, max_error );
+
+		const gamboge::simd_level levels[] = { gamboge::simd_avx2, gamboge::simd_avx512 };
+		for ( unsigned v = 0; v < 2; ++v )
+		{
+			const gamboge::half_neural_network< Format > hnet( in_count, hidden_count, out_count,
+				&(float_wts[0]), gamboge::logistic_output<float>(),
+				gamboge::half_select< Format >( levels[v] ) );
+			std::vector<float> nn_out( verif_count * out_count );
+			hnet.evaluate_batch( &(nn_out[0]), &(float_in[0]), verif_count );
+			for ( unsigned r = 0; r < verif_count; ++r )
+			{
+				float row_out[ 8 ];
+				hnet.evaluate( row_out, &(float_in[r*in_count]) );
+				CPPUNIT_ASSERT( std::equal( row_out, row_out + out_count, &(nn_out[r*out_count]) ) );
+			}
+			CPPUNIT_ASSERT_LESS( 1E-5F, std::inner_product( nn_out.begin(), nn_out.end(),
+				scalar_out.begin(), 0.0F, fmax, absdiff<float>() ) );
+		}
+		return max_error;
+	}
+
+	void run_test_half( )
+	{
+		half_error< gamboge::fp16_storage >( 5E-3F );
+		half_error< gamboge::bf16_storage >( 2E-2F );
+	}
+
+	void run_test_fast_transfer( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned,
+			gamboge::fast_logistic_output<FP>, gamboge::fast_logistic_output<FP> > nnet_type;
+		const nnet_type nnet( in_count, hidden_count, out_count, wts );
+		std::vector<FP> nn_out( verif_count * out_count );
+		nnet.evaluate_batch( &(nn_out[0]), verif_in, verif_count );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (fast logistic)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
+	void run_test_classify( )
+	{
+		typedef gamboge::neural_network< const FP*, const FP*, FP*, unsigned > nnet_type;
+		const nnet_type nnet( in_count, hidden_count, out_count, wts );
+		const unsigned class_count = std::max( out_count, 2U );
+		std::vector<unsigned> classes( verif_count );
+		std::vector<unsigned> confident( verif_count );
+		std::vector<unsigned> ranked( verif_count * class_count );
+		nnet.classify_batch( classes.begin(), verif_in, verif_count );
+		nnet.classify_batch( &(confident[0]), verif_in, verif_count, static_cast<FP>( 0.9 ) );
+		CPPUNIT_ASSERT( nnet.classify_top_k( ranked.begin(), verif_in, verif_count,
+			class_count + 1 ) == ranked.end() );
+
+		for ( unsigned r = 0; r < verif_count; ++r )
+		{
+			// expected classes and ranking from the expected probabilities
+			std::vector<FP> probs( expected_out + r * out_count,
+				expected_out + ( r + 1 ) * out_count );
+			if ( out_count == 1 )
+			{
+				probs.insert( probs.begin(), 1 - probs[0] );
+				CPPUNIT_ASSERT_EQUAL( probs[1] > static_cast<FP>( 0.9 ) ? 1U : 0U, confident[r] );
+			}
+			std::vector<unsigned> order( class_count );
+			for ( unsigned c = 0; c < class_count; ++c )
+			{
+				order[c] = c;
+			}
+			std::sort( order.begin(), order.end(), greater_prob( probs ) );
+			CPPUNIT_ASSERT_EQUAL( order[0], classes[r] );
+			CPPUNIT_ASSERT( std::equal( order.begin(), order.end(), &(ranked[r*class_count]) ) );
+		}
+		CPPUNIT_ASSERT_EQUAL( classes[0], nnet.classify( verif_in ) );
+
+		// top 1 agrees with classify_batch
+		CPPUNIT_ASSERT( nnet.classify_top_k( ranked.begin(), verif_in, verif_count, 1U )
+			== ranked.begin() + verif_count );
+		CPPUNIT_ASSERT( std::equal( classes.begin(), classes.end(), ranked.begin() ) );
+
+		// softmax into a separate output range
+		std::vector<FP> linear( out_count );
+		std::vector<FP> probs( out_count );
+		for ( unsigned k = 0; k < out_count; ++k )
+		{
+			linear[k] = static_cast<FP>( k ) - static_cast<FP>( 1.5 );
+		}
+		gamboge::_softmax( linear.begin(), linear.end(), probs.begin() );
+		CPPUNIT_ASSERT_LESS( static_cast<FP>( 1E-6 ), static_cast<FP>(
+			std::fabs( std::accumulate( probs.begin(), probs.end(), static_cast<FP>( 0 ) ) - 1 ) ) );
+	}
+
+	void run_test_incremental( )
+	{
+		gamboge::incremental_evaluator<FP> eval( in_count, hidden_count, out_count, wts );
+		std::vector<FP> nn_out( out_count );
+		std::vector<FP> full_out( out_count );
+		std::vector<FP> row( verif_in, verif_in + in_count );
+		eval.set_base( verif_in );
+		FP max_error = static_cast<FP>( 0 );
+		for ( unsigned r = 1; r < verif_count; ++r )
+		{
+			// what-if for each input of row r applied to the base row
+			for ( unsigned k = 0; k < in_count; ++k )
+			{
+				const FP v = verif_in[ r*in_count + k ];
+				eval.evaluate_with( &(nn_out[0]), k, v );
+				row[k] = v;
+				gamboge::evaluate_neural_network( &(row[0]), wts, &(full_out[0]),
+					in_count, hidden_count, out_count );
+				row[k] = verif_in[k];
+				max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+					full_out.begin(), max_error, fmax, absdiff<FP>() );
+			}
+
+			// move the base row to row r, one input at a time
+			gamboge::incremental_evaluator<FP> moved( eval.topology( ), wts );
+			moved.set_base( verif_in );
+			for ( unsigned k = 0; k < in_count; ++k )
+			{
+				moved.update( k, verif_in[ r*in_count + k ] );
+			}
+			moved.evaluate( &(nn_out[0]) );
+			max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+				&(expected_out[r*out_count]), max_error, fmax, absdiff<FP>() );
+		}
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (incremental)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+
+		// the base row is unchanged by evaluate_with
+		CPPUNIT_ASSERT( std::equal( verif_in, verif_in + in_count, eval.base() ) );
+	}
+
+	void run_test_sparse( )
+	{
+		const gamboge::sparse_neural_network<FP> snet( in_count, hidden_count, out_count, wts );
+		std::vector<FP> nn_out( verif_count * out_count );
+		CPPUNIT_ASSERT( snet.evaluate_batch( &(nn_out[0]), verif_in, verif_count )
+			== &(nn_out[0]) + nn_out.size() );
+
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (sparse)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+		CPPUNIT_ASSERT_LESS( static_cast<FP>( 1E-6 ), snet.max_error( wts, verif_in, verif_count ) );
+	}
+
+	void run_test_prepared( )
+	{
+		// raw inputs whose transforms are the verification inputs
+		std::vector<FP> scale( in_count );
+		std::vector<FP> offset( in_count );
+		std::vector<gamboge::input_column> columns;
+		for ( unsigned k = 0; k < in_count; ++k )
+		{
+			scale[k] = static_cast<FP>( 0.5 + 0.25 * k );
+			offset[k] = static_cast<FP>( 0.1 * k - 0.3 );
+			columns.push_back( gamboge::input_column::affine( scale[k], offset[k] ) );
+		}
+		std::vector<FP> raw( verif_count * in_count );
+		for ( unsigned k = 0; k < raw.size(); ++k )
+		{
+			raw[k] = static_cast<FP>( ( static_cast<double>( verif_in[k] )
+				- offset[ k % in_count ] ) / scale[ k % in_count ] );
+		}
+
+		const gamboge::nnet_topology topo( in_count, hidden_count, out_count );
+		std::vector<FP> folded( topo.weight_count( ) );
+		CPPUNIT_ASSERT( gamboge::fold_input_transform( topo, wts, scale.begin(), offset.begin(),
+			folded.begin() ) == folded.end() );
+		std::vector<FP> nn_out( verif_count * out_count );
+		gamboge::evaluate_neural_network_batch( &(raw[0]), in_count, &(folded[0]), &(nn_out[0]),
+			verif_count, in_count, hidden_count, out_count );
+		FP max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+
+		const gamboge::prepared_neural_network<FP> pnet( topo, wts, &(columns[0]), in_count );
+		CPPUNIT_ASSERT( pnet.valid( ) );
+		pnet.evaluate_batch( &(nn_out[0]), &(raw[0]), verif_count );
+		max_error = std::inner_product( nn_out.begin(), nn_out.end(),
+			expected_out, max_error, fmax, absdiff<FP>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (prepared)",
+			CPPUNIT_ASSERT_LESS( 7.8E-7F, max_error ) );
+	}
+
 	void run_test( )
 	{
 		run_test_algo( );
 		run_test_class( );
+		run_test_batch( );
+		run_test_class_batch( );
+		run_test_no_allocation( );
+		run_test_simd( );
+		run_test_packed( );
+		run_test_parallel( );
+		run_test_queue( );
+		run_test_jacobian( );
+		run_test_columns( );
+		run_test_model_file( );
+		run_test_quantized( );
+		run_test_half( );
+		run_test_fast_transfer( );
+		run_test_classify( );
+		run_test_incremental( );
+		run_test_sparse( );
+		run_test_prepared( );
 	}
 
 private:
+	// orders class indices by decreasing probability
+	struct greater_prob
+	{
+		greater_prob( const std::vector<FP>& probs )
+		: probs( probs )
+		{}
+
+		bool operator()( unsigned a, unsigned b ) const
+		{
+			return probs[a] > probs[b];
+		}
+
+		const std::vector<FP>& probs;
+	};
+
 	unsigned in_count;
 	unsigned hidden_count;
 	unsigned out_count;
@@ -114,6 +956,7 @@ public:
 		gamboge_nnet_tester<float> tester( 6U, 3U, 1U, test_wts,
 			 8U, test_inputs, expected_outputs );
 		tester.run_test( );
+		tester.run_test_static< 6, 3, 1 >( );
 	}
 
 private:
@@ -169,6 +1012,7 @@ public:
 		gamboge_nnet_tester<float> tester( 3U, 2U, 1U, weights,
 			20U, verif_data, predicted );
 		tester.run_test( );
+		tester.run_test_static< 3, 2, 1 >( );
 	}
 
 private:
@@ -257,22 +1101,60 @@ public:
 	}
 };
 
-// test neural network 4-2-3 topology
-class ann423TestCase : public CppUnit::TestCase
+// example neural network 3-2-1 with compile-time topology
+class exampleStatic321TestCase : public CppUnit::TestCase
 {
 public:
-	ann423TestCase( std::string name )
+	exampleStatic321TestCase( std::string name )
 	: CppUnit::TestCase( name )
 	{}
 
 	void runTest( )
 	{
-		gamboge_nnet_tester<float> tester( 4U, 2U, 3U, weights,
-			20U, verif_data, predicted );
-		tester.run_test( );
-	}
-
-private:
+		typedef gamboge::static_neural_network< double, 3, 2, 1 > nnet_type;
+		static_assert( nnet_type::weight_count == 11, "3-2-1 weight count" );
+		static const double wts[ ] = {
+			 0.56974212, -1.5468268,  1.494846, -2.8907045,
+			-6.5020564,   3.0203401, -1.7088961, 2.5260361,
+			 3.393649,   -6.7710899, -7.2983476
+			};
+		const nnet_type example_nnet( wts );
+		const double nn_in[ 3 ] = { 1.4, 6.8, 4.8 };
+		double nn_out[ 1 ];
+
+		example_nnet.evaluate( nn_out, nn_in );
+
+		// no hidden layer, 3 inputs feed 2 softmax outputs; compare
+		// with the generic algorithm
+		typedef gamboge::static_neural_network< double, 3, 0, 2 > nnet0_type;
+		static_assert( nnet0_type::weight_count == 8, "3-0-2 weight count" );
+		const nnet0_type example_nnet0( wts );
+		double nn0_out[ 2 ];
+		double generic_out[ 2 ];
+
+		example_nnet0.evaluate( nn0_out, nn_in );
+		gamboge::evaluate_neural_network( nn_in, wts, generic_out, 3U, 0U, 2U );
+		CPPUNIT_ASSERT( std::equal( nn0_out, nn0_out + 2, generic_out ) );
+	}
+};
+
+// test neural network 4-2-3 topology
+class ann423TestCase : public CppUnit::TestCase
+{
+public:
+	ann423TestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		gamboge_nnet_tester<float> tester( 4U, 2U, 3U, weights,
+			20U, verif_data, predicted );
+		tester.run_test( );
+		tester.run_test_static< 4, 2, 3 >( );
+	}
+
+private:
 	static const float weights[];
 	static const float verif_data[];
 	static const float predicted[];
@@ -332,6 +1214,1136 @@ const float ann423TestCase::predicted[] =
 	0.99489201F, 0.0044910661F, 0.00061692014F
 };
 
+// R nnet skip-layer connections and output modes: 4-2-3 and 3-2-1
+// networks with skip=TRUE, linout=TRUE and logistic outputs. The weights
+// are synthetic, not fitted by R; testdata_423_skip, testdata_321_skip and
+// testdata_321_linout in R/testdata_gen.R produce fixtures of the same
+// shape. Weights are in nnet$wts order, each skip-layer output block
+// holding the bias, the hidden-layer weights and then the input weights.
+// The expected outputs were computed from the weights in double
+// precision by a direct implementation of that layout, so they check the
+// layout and output modes as implemented here rather than agreement with
+// R's predict.nnet.
+class skipLayerTestCase : public CppUnit::TestCase
+{
+public:
+	skipLayerTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		check( gamboge::nnet_topology( 4, 2, 3, gamboge::output_softmax, true ),
+			weights_423_skip, verif_data_423, predicted_423_skip_softmax, 7.8E-7F );
+		check( gamboge::nnet_topology( 4, 2, 3, gamboge::output_linear, true ),
+			weights_423_skip, verif_data_423, predicted_423_skip_linear, 4E-6F );
+		check( gamboge::nnet_topology( 4, 2, 3, gamboge::output_logistic, true ),
+			weights_423_skip, verif_data_423, predicted_423_skip_logistic, 7.8E-7F );
+		check( gamboge::nnet_topology( 3, 2, 1, gamboge::output_logistic, true ),
+			weights_321_skip, verif_data_321, predicted_321_skip, 7.8E-7F );
+		check( gamboge::nnet_topology( 3, 2, 1, gamboge::output_linear ),
+			weights_321_linout, verif_data_321, predicted_321_linout, 7.8E-7F );
+
+		// zero skip-layer weights give the network without them
+		const gamboge::nnet_topology topo( 4, 2, 3, gamboge::output_default, true );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 31 ), topo.weight_count( ) );
+		std::vector<float> wts( weights_423_skip, weights_423_skip + topo.weight_count( ) );
+		std::vector<float> plain_wts( wts.begin( ), wts.begin( ) + 10 );
+		for ( unsigned ok = 0; ok < 3; ++ok )
+		{
+			std::fill( &(wts[ 10 + ok*7 + 3 ]), &(wts[ 10 + ok*7 + 7 ]), 0.0F );
+			plain_wts.insert( plain_wts.end( ), &(wts[ 10 + ok*7 ]), &(wts[ 10 + ok*7 + 3 ]) );
+		}
+		std::vector<float> skip_out( rows * 3 );
+		std::vector<float> plain_out( rows * 3 );
+		gamboge::evaluate_neural_network_batch( verif_data_423, 4U, &(wts[0]),
+			&(skip_out[0]), rows, topo );
+		gamboge::evaluate_neural_network_batch( verif_data_423, 4U, &(plain_wts[0]),
+			&(plain_out[0]), rows, 4U, 2U, 3U );
+		CPPUNIT_ASSERT( skip_out == plain_out );
+
+		// linear output compared with the threshold itself
+		typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+		const nnet_type linout_nnet( gamboge::nnet_topology( 3, 2, 1, gamboge::output_linear ),
+			weights_321_linout );
+		std::vector<unsigned> classes( rows );
+		linout_nnet.classify_batch( &(classes[0]), verif_data_321, rows, 0.3F );
+		for ( unsigned r = 0; r < rows; ++r )
+		{
+			CPPUNIT_ASSERT_EQUAL( predicted_321_linout[r] > 0.3F ? 1U : 0U, classes[r] );
+		}
+
+		// incremental evaluation with skip-layer connections
+		gamboge::incremental_evaluator<float> eval(
+			gamboge::nnet_topology( 4, 2, 3, gamboge::output_linear, true ), weights_423_skip );
+		eval.set_base( verif_data_423 );
+		std::vector<float> incr_out( 3 );
+		for ( unsigned k = 0; k < 4; ++k )
+		{
+			eval.update( k, verif_data_423[ 4 + k ] );
+		}
+		eval.evaluate( &(incr_out[0]) );
+		float incr_error = std::inner_product( incr_out.begin( ), incr_out.end( ),
+			&(predicted_423_skip_linear[3]), 0.0F, fmax, absdiff<float>() );
+		CPPUNIT_ASSERT_LESS( 4E-6F, incr_error );
+
+		// the topology is recorded in model files
+		const char* path = "gamboge_nnet_skip_test.gnnm";
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_ok, gamboge::write_model_file( path,
+			gamboge::nnet_topology( 4, 2, 3, gamboge::output_linear, true ), weights_423_skip ) );
+		gamboge::mapped_model model;
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_ok, model.open( path ) );
+		CPPUNIT_ASSERT( model.topology( ).skip );
+		CPPUNIT_ASSERT_EQUAL( gamboge::output_linear, model.topology( ).mode );
+		std::vector<float> model_out( rows * 3 );
+		model.network<float>( ).evaluate_batch( &(model_out[0]), verif_data_423, rows );
+		float max_error = std::inner_product( model_out.begin( ), model_out.end( ),
+			predicted_423_skip_linear, 0.0F, fmax, absdiff<float>() );
+		CPPUNIT_ASSERT_LESS( 4E-6F, max_error );
+		model.close( );
+		std::remove( path );
+	}
+
+private:
+	void check( const gamboge::nnet_topology& topo, const float* wts, const float* verif_in,
+		const float* expected_out, float tolerance )
+	{
+		const unsigned nx = static_cast<unsigned>( topo.inputs );
+		const unsigned ny = static_cast<unsigned>( topo.outputs );
+		std::vector<float> nn_out( rows * ny );
+
+		for ( unsigned r = 0; r < rows; ++r )
+		{
+			gamboge::evaluate_neural_network( &(verif_in[r*nx]), wts, &(nn_out[r*ny]), topo );
+		}
+		float max_error = std::inner_product( nn_out.begin( ), nn_out.end( ), expected_out,
+			0.0F, fmax, absdiff<float>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (topology)",
+			CPPUNIT_ASSERT_LESS( tolerance, max_error ) );
+
+		std::vector<float> batch_out( rows * ny );
+		gamboge::evaluate_neural_network_batch( verif_in, nx, wts, &(batch_out[0]), rows, topo );
+		CPPUNIT_ASSERT( batch_out == nn_out );
+
+		typedef gamboge::neural_network< const float*, const float*, float*, unsigned > nnet_type;
+		const nnet_type nnet( topo, wts );
+		nnet.evaluate( &(nn_out[0]), verif_in );
+		CPPUNIT_ASSERT( std::equal( batch_out.begin( ), batch_out.begin( ) + ny, nn_out.begin( ) ) );
+		nnet.evaluate_batch( &(nn_out[0]), verif_in, rows );
+		CPPUNIT_ASSERT( batch_out == nn_out );
+
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check Jacobian against finite differences",
+			CPPUNIT_ASSERT_LESS( 5E-5, jacobian_error( topo, wts, verif_in, rows ) ) );
+
+		std::vector<float> column_major( nx * rows );
+		for ( unsigned r = 0; r < rows; ++r )
+		{
+			for ( unsigned k = 0; k < nx; ++k )
+			{
+				column_major[ k*rows + r ] = verif_in[ r*nx + k ];
+			}
+		}
+		gamboge::evaluate_neural_network_column_major( &(column_major[0]), rows, wts,
+			&(nn_out[0]), rows, topo );
+		max_error = std::inner_product( nn_out.begin( ), nn_out.end( ), expected_out,
+			0.0F, fmax, absdiff<float>() );
+		CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check maximum absolute error (column-major)",
+			CPPUNIT_ASSERT_LESS( tolerance, max_error ) );
+	}
+
+	static const unsigned rows = 8;
+	static const float weights_423_skip[];
+	static const float verif_data_423[];
+	static const float predicted_423_skip_softmax[];
+	static const float predicted_423_skip_linear[];
+	static const float predicted_423_skip_logistic[];
+	static const float weights_321_skip[];
+	static const float weights_321_linout[];
+	static const float verif_data_321[];
+	static const float predicted_321_skip[];
+	static const float predicted_321_linout[];
+};
+const float skipLayerTestCase::weights_423_skip[] =
+{
+	 -7.5744544F, -0.98429384F, -1.216025F, 1.9840944F, 4.3170568F,
+	 0.35806831F, 0.47724404F, 1.5541206F, -2.4603607F, -0.99349176F,
+	 -1.6232478F, -2.1703089F, 6.0064449F, 0.41843522F, 0.76204933F, -1.2916378F, -0.53710492F,
+	 3.9738482F, -5.5195306F, -5.2175259F, -0.1507733F, -0.62844307F, 0.49573018F, 0.31217905F,
+	 -2.3506086F, 7.6898515F, -0.78892375F, -0.26766192F, -0.13360626F, 0.79590763F, 0.22492587F
+};
+const float skipLayerTestCase::verif_data_423[] =
+{
+	4.4F, 3.0F, 1.3F, 0.2F,
+	5.1F, 3.8F, 1.9F, 0.4F,
+	7.2F, 3.2F, 6.0F, 1.8F,
+	5.6F, 2.7F, 4.2F, 1.3F,
+	6.0F, 2.2F, 5.0F, 1.5F,
+	6.9F, 3.2F, 5.7F, 2.3F,
+	5.7F, 2.6F, 3.5F, 1.0F,
+	6.2F, 2.8F, 4.8F, 1.8F
+};
+const float skipLayerTestCase::predicted_423_skip_softmax[] =
+{
+	0.99989133F, 7.1571891e-05F, 3.7093367e-05F,
+	0.99989741F, 5.6180041e-05F, 4.6414383e-05F,
+	2.7542071e-06F, 0.0024011204F, 0.99759613F,
+	0.001015506F, 0.96569228F, 0.033292211F,
+	3.2358719e-05F, 0.055633082F, 0.94433456F,
+	4.1073649e-07F, 0.00019614539F, 0.99980344F,
+	0.0068798015F, 0.98007396F, 0.013046234F,
+	8.3689606e-05F, 0.050425165F, 0.94949115F
+};
+const float skipLayerTestCase::predicted_423_skip_linear[] =
+{
+	6.5822168F, -2.9624827F, -3.619747F,
+	6.5882107F, -3.1986357F, -3.3895879F,
+	-6.5235115F, 0.2470496F, 6.2764627F,
+	-3.449134F, 3.4083243F, 0.040802501F,
+	-5.9103345F, 1.5393152F, 4.3710177F,
+	-6.9579246F, -0.78926507F, 7.7471927F,
+	-1.8663188F, 3.0927194F, -1.2264091F,
+	-5.2458997F, 1.1552311F, 4.090667F
+};
+const float skipLayerTestCase::predicted_423_skip_logistic[] =
+{
+	0.99861714F, 0.049149849F, 0.026090504F,
+	0.99862539F, 0.039217096F, 0.032622459F,
+	0.00146635F, 0.56145017F, 0.99812349F,
+	0.030794696F, 0.96796368F, 0.51019921F,
+	0.0027039485F, 0.82336516F, 0.98751936F,
+	0.00095016466F, 0.31232649F, 0.99956823F,
+	0.13396824F, 0.95659143F, 0.22681053F,
+	0.0052414611F, 0.7604651F, 0.98354715F
+};
+const float skipLayerTestCase::weights_321_skip[] =
+{
+	0.56974212F, -1.5468268F, 1.494846F, -2.8907045F,
+	-6.5020564F, 3.0203401F, -1.7088961F, 2.5260361F,
+	3.393649F, -6.7710899F, -7.2983476F, 0.93310451F, -0.21566713F, 0.18070316F
+};
+const float skipLayerTestCase::weights_321_linout[] =
+{
+	0.56974212F, -1.5468268F, 1.494846F, -2.8907045F,
+	-6.5020564F, 3.0203401F, -1.7088961F, 2.5260361F,
+	0.82351148F, -0.79622981F, -0.87417309F
+};
+const float skipLayerTestCase::verif_data_321[] =
+{
+	1.4F, 6.8F, 4.8F,
+	2.3F, 6.4F, 5.3F,
+	1.3F, 5.7F, 4.1F,
+	0.2F, 4.7F, 1.3F,
+	1.5F, 6.0F, 5.0F,
+	1.0F, 5.0F, 3.5F,
+	1.4F, 6.1F, 4.7F,
+	0.3F, 5.7F, 1.7F
+};
+const float skipLayerTestCase::predicted_321_skip[] =
+{
+	0.95277145F,
+	0.14184823F,
+	0.95930173F,
+	0.022387564F,
+	0.50482382F,
+	0.96814979F,
+	0.88026312F,
+	0.020667916F
+};
+const float skipLayerTestCase::predicted_321_linout[] =
+{
+	0.69225424F,
+	-0.0050149812F,
+	0.70885997F,
+	0.04996883F,
+	0.29847753F,
+	0.76801689F,
+	0.5553886F,
+	0.046252424F
+};
+
+// pruned network: storage shrinks with the dropped weights, and the
+// reported error bounds the difference from the dense network
+class sparseNetworkTestCase : public CppUnit::TestCase
+{
+public:
+	sparseNetworkTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		const unsigned in_count = 64;
+		const unsigned hidden_count = 24;
+		const unsigned out_count = 3;
+		const unsigned row_count = 300;
+		const gamboge::nnet_topology topo( in_count, hidden_count, out_count,
+			gamboge::output_softmax, true );
+
+		// about three quarters of the weights are small, as after decay;
+		// hidden unit 5 feeds no output unit
+		unsigned seed = 4242U;
+		std::vector<double> wts( topo.weight_count( ) );
+		for ( unsigned k = 0; k < wts.size(); ++k )
+		{
+			double v = next_value( seed );
+			wts[k] = ( seed % 4U == 0 ) ? v : 1E-4 * v;
+		}
+		const unsigned out_block = 1 + hidden_count + in_count;
+		for ( unsigned o = 0; o < out_count; ++o )
+		{
+			wts[ hidden_count * ( 1 + in_count ) + o * out_block + 1 + 5 ] = 0.0;
+		}
+		std::vector<double> values( row_count * in_count );
+		for ( unsigned k = 0; k < values.size(); ++k )
+		{
+			values[k] = 2.0 * next_value( seed );
+		}
+
+		// threshold 0 keeps all non-zero weights
+		const gamboge::sparse_neural_network<double> exact( topo, &(wts[0]) );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( hidden_count - 1 ), exact.hidden_kept( ) );
+		CPPUNIT_ASSERT_LESS( 1E-14, exact.max_error( &(wts[0]), &(values[0]), row_count ) );
+
+		const gamboge::sparse_neural_network<double> pruned( topo, &(wts[0]), 1E-3 );
+		const std::size_t dense_count = topo.weight_count( ) - hidden_count - out_count;
+		CPPUNIT_ASSERT( pruned.nonzeros( ) < dense_count / 3 );
+		CPPUNIT_ASSERT( pruned.weight_bytes( ) < topo.weight_count( ) * sizeof( double ) / 2 );
+		const double max_error = pruned.max_error( &(wts[0]), &(values[0]), row_count );
+		CPPUNIT_ASSERT_LESS( 1E-2, max_error );
+
+		std::vector<double> dense_out( row_count * out_count );
+		std::vector<double> sparse_out( row_count * out_count );
+		gamboge::evaluate_neural_network_batch( &(values[0]), in_count, &(wts[0]),
+			&(dense_out[0]), row_count, topo );
+		gamboge::nnet_workspace<double> ws;
+		pruned.evaluate_batch( &(sparse_out[0]), &(values[0]), row_count, in_count, ws );
+		CPPUNIT_ASSERT_EQUAL( max_error, std::inner_product( sparse_out.begin(),
+			sparse_out.end(), dense_out.begin(), 0.0, fmax, absdiff<double>() ) );
+	}
+};
+
+// raw columns: standardized numeric columns and one-hot and
+// treatment-coded factor columns given by level index, compared with the
+// network evaluated on the encoded inputs
+class rawColumnsTestCase : public CppUnit::TestCase
+{
+public:
+	rawColumnsTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		const gamboge::input_column columns[] = {
+			gamboge::input_column::standardized( 5.8, 0.8 ),
+			gamboge::input_column::one_hot( 4 ),
+			gamboge::input_column::affine( 2.0, -1.0 ),
+			gamboge::input_column::dummy( 4 ),
+			gamboge::input_column::standardized( -3.0, 10.0 )
+		};
+		const unsigned column_count = 5;
+		const unsigned row_count = 40;
+		const gamboge::nnet_topology topo( 10, 5, 2, gamboge::output_softmax, true );
+
+		unsigned seed = 777U;
+		std::vector<double> wts( topo.weight_count( ) );
+		for ( unsigned k = 0; k < wts.size(); ++k )
+		{
+			wts[k] = next_value( seed );
+		}
+		const gamboge::prepared_neural_network<double> pnet( topo, &(wts[0]), columns,
+			column_count );
+		CPPUNIT_ASSERT( pnet.valid( ) );
+		CPPUNIT_ASSERT( !gamboge::prepared_neural_network<double>( topo, &(wts[0]), columns,
+			column_count - 1 ).valid( ) );
+
+		// raw rows; the factor levels include one past the last level,
+		// which contributes nothing
+		std::vector<double> raw( row_count * column_count );
+		std::vector<double> encoded( row_count * topo.inputs, 0.0 );
+		for ( unsigned r = 0; r < row_count; ++r )
+		{
+			double* x = &(raw[ r*column_count ]);
+			double* z = &(encoded[ r*topo.inputs ]);
+			x[0] = 5.8 + next_value( seed );
+			x[1] = r % 5;
+			x[2] = next_value( seed );
+			x[3] = ( r / 5 ) % 5;
+			x[4] = 20.0 * next_value( seed );
+			z[0] = ( x[0] - 5.8 ) / 0.8;
+			if ( x[1] < 4 )
+			{
+				z[ 1 + static_cast<unsigned>( x[1] ) ] = 1.0;
+			}
+			z[5] = 2.0 * x[2] - 1.0;
+			if ( x[3] >= 1 && x[3] < 4 )
+			{
+				z[ 5 + static_cast<unsigned>( x[3] ) ] = 1.0;
+			}
+			z[9] = ( x[4] + 3.0 ) / 10.0;
+		}
+
+		std::vector<double> expected( row_count * topo.outputs );
+		std::vector<double> nn_out( row_count * topo.outputs );
+		gamboge::evaluate_neural_network_batch( &(encoded[0]), 10U, &(wts[0]),
+			&(expected[0]), row_count, topo );
+		pnet.evaluate_batch( &(nn_out[0]), &(raw[0]), row_count );
+		CPPUNIT_ASSERT_LESS( 1E-12, std::inner_product( nn_out.begin(), nn_out.end(),
+			expected.begin(), 0.0, fmax, absdiff<double>() ) );
+	}
+};
+
+// batched evaluation of many rows of a wide network, spanning several
+// row blocks; results must match row at a time evaluation exactly
+class batchBlocksTestCase : public CppUnit::TestCase
+{
+public:
+	batchBlocksTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		const unsigned in_count = 40;
+		const unsigned hidden_count = 12;
+		const unsigned out_count = 3;
+		const unsigned row_count = 1000;
+		const unsigned wt_count =
+			hidden_count * ( 1 + in_count ) + out_count * ( 1 + hidden_count );
+
+		// deterministic pseudo-random weights and inputs
+		unsigned seed = 12345U;
+		std::vector<double> wts( wt_count );
+		for ( unsigned k = 0; k < wt_count; ++k )
+		{
+			wts[k] = next_value( seed );
+		}
+		std::vector<double> values( row_count * in_count );
+		for ( unsigned k = 0; k < values.size(); ++k )
+		{
+			values[k] = 4.0 * next_value( seed );
+		}
+
+		std::vector<double> batch_out( row_count * out_count );
+		gamboge::evaluate_neural_network_batch( &(values[0]), in_count, &(wts[0]),
+			&(batch_out[0]), row_count, in_count, hidden_count, out_count );
+
+		std::vector<double> row_out( out_count );
+		for ( unsigned r = 0; r < row_count; ++r )
+		{
+			gamboge::evaluate_neural_network( &(values[r*in_count]), &(wts[0]),
+				&(row_out[0]), in_count, hidden_count, out_count );
+			CPPUNIT_ASSERT( std::equal( row_out.begin(), row_out.end(),
+				&(batch_out[r*out_count]) ) );
+		}
+
+		// the same rows as columns, several row blocks
+		std::vector<double> column_major( values.size() );
+		for ( unsigned r = 0; r < row_count; ++r )
+		{
+			for ( unsigned k = 0; k < in_count; ++k )
+			{
+				column_major[ k*row_count + r ] = values[ r*in_count + k ];
+			}
+		}
+		std::vector<double> column_out( row_count * out_count );
+		gamboge::evaluate_neural_network_column_major( &(column_major[0]), row_count,
+			&(wts[0]), &(column_out[0]), row_count,
+			gamboge::nnet_topology( in_count, hidden_count, out_count ) );
+		double column_error = std::inner_product( column_out.begin(), column_out.end(),
+			batch_out.begin(), 0.0, fmax, absdiff<double>() );
+		CPPUNIT_ASSERT_LESS( 1E-12, column_error );
+
+		// packed weights, several panels of hidden-layer units
+		const gamboge::packed_neural_network<double> packed_nnet(
+			in_count, hidden_count, out_count, &(wts[0]) );
+		std::vector<double> packed_out( row_count * out_count );
+		packed_nnet.evaluate_batch( &(packed_out[0]), &(values[0]), row_count );
+		double max_error = std::inner_product( packed_out.begin(), packed_out.end(),
+			batch_out.begin(), 0.0, fmax, absdiff<double>() );
+		CPPUNIT_ASSERT_LESS( 1E-12, max_error );
+
+		// vectorized kernels: several row blocks; several tiles of
+		// hidden-layer units; no hidden layer
+		check_simd( in_count, hidden_count, out_count );
+		check_simd( 64, 80, 1 );
+		check_simd( 6, 0, 2 );
+	}
+
+private:
+	// evaluate_neural_network_batch_simd at each kernel level supported
+	// by the running CPU against evaluate_neural_network_batch, for input
+	// rows with a stride longer than the row
+	void check_simd( unsigned nx, unsigned nh, unsigned ny )
+	{
+		const unsigned row_count = 700;
+		const unsigned stride = nx + 1;
+		const unsigned wt_count = ( nh > 0 ) ? nh * ( 1 + nx ) + ny * ( 1 + nh ) : ny * ( 1 + nx );
+		unsigned seed = 54321U;
+		std::vector<double> wts( wt_count );
+		for ( unsigned k = 0; k < wt_count; ++k )
+		{
+			wts[k] = next_value( seed );
+		}
+		std::vector<double> values( row_count * stride );
+		for ( unsigned k = 0; k < values.size(); ++k )
+		{
+			values[k] = 4.0 * next_value( seed );
+		}
+
+		std::vector<double> batch_out( row_count * ny );
+		gamboge::evaluate_neural_network_batch( &(values[0]), stride, &(wts[0]),
+			&(batch_out[0]), row_count, nx, nh, ny );
+
+		gamboge::nnet_workspace<double> ws;
+		std::vector<double> simd_out( row_count * ny );
+		for ( int level = gamboge::simd_scalar;
+			level <= gamboge::simd_supported_level( ); ++level )
+		{
+			std::fill( simd_out.begin(), simd_out.end(), -1.0 );
+			double* end = gamboge::evaluate_neural_network_batch_simd( &(values[0]), stride,
+				&(wts[0]), &(simd_out[0]), row_count, nx, nh, ny,
+				gamboge::logistic_output<double>(),
+				gamboge::simd_select<double>( static_cast<gamboge::simd_level>( level ) ), ws );
+			CPPUNIT_ASSERT( end == &(simd_out[0]) + simd_out.size() );
+			CPPUNIT_ASSERT_LESS( 1E-12, std::inner_product( simd_out.begin(), simd_out.end(),
+				batch_out.begin(), 0.0, fmax, absdiff<double>() ) );
+		}
+	}
+};
+
+// memoized outputs: hits, least recently used eviction and quantized keys
+class predictionCacheTestCase : public CppUnit::TestCase
+{
+public:
+	predictionCacheTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		const unsigned in_count = 3;
+		const unsigned hidden_count = 2;
+		const unsigned out_count = 1;
+		const double wts[ ] = {
+			 0.56974212, -1.5468268,  1.494846, -2.8907045,
+			-6.5020564,   3.0203401, -1.7088961, 2.5260361,
+			 3.393649,   -6.7710899, -7.2983476
+			};
+		const double rows[ ][ in_count ] = {
+			{ 1.4, 6.8, 4.8 }, { 0.2, -1.0, 3.5 }, { 2.0, 2.0, 2.0 }
+			};
+		typedef gamboge::neural_network< const double*, const double*, double*, unsigned > nnet_type;
+		const nnet_type nnet( in_count, hidden_count, out_count, &(wts[0]) );
+		double expected[ 3 ];
+		for ( unsigned r = 0; r < 3; ++r )
+		{
+			nnet.evaluate( &(expected[r]), rows[r] );
+		}
+
+		// one shard holding two rows
+		gamboge::prediction_cache< nnet_type > cache( nnet, 2, 1 );
+		double out = 0.0;
+		CPPUNIT_ASSERT( cache.evaluate( &out, rows[0] ) == &out + 1 );
+		CPPUNIT_ASSERT_EQUAL( expected[0], out );
+		cache.evaluate( &out, rows[1] );
+		out = 0.0;
+		cache.evaluate( &out, rows[0] );
+		CPPUNIT_ASSERT_EQUAL( expected[0], out );
+		gamboge::prediction_cache_stats st = cache.stats( );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 1 ), st.hits );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 2 ), st.misses );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 2 ), st.size );
+
+		// row 1 is least recently used and is evicted by row 2
+		cache.evaluate( &out, rows[2] );
+		CPPUNIT_ASSERT_EQUAL( expected[2], out );
+		cache.evaluate( &out, rows[0] );
+		cache.evaluate( &out, rows[1] );
+		CPPUNIT_ASSERT_EQUAL( expected[1], out );
+		st = cache.stats( );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 2 ), st.hits );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 4 ), st.misses );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 2 ), st.evictions );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 2 ), st.size );
+
+		cache.clear( );
+		cache.evaluate( &out, rows[1] );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 5 ), cache.stats( ).misses );
+
+		// rows within half a quantum share a key; exact keys differ
+		gamboge::prediction_cache< nnet_type > rounded( nnet, 64, 4, 0.01 );
+		gamboge::prediction_cache< nnet_type > exact( nnet, 64, 4 );
+		const double near_row[ in_count ] = { 1.401, 6.799, 4.8 };
+		rounded.evaluate( &out, rows[0] );
+		rounded.evaluate( &out, near_row );
+		CPPUNIT_ASSERT_EQUAL( expected[0], out );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 1 ), rounded.stats( ).hits );
+		exact.evaluate( &out, rows[0] );
+		exact.evaluate( &out, near_row );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 0 ), exact.stats( ).hits );
+
+		// many rows over several shards, each cached value matches
+		unsigned seed = 99U;
+		std::vector< double > values( 200 * in_count );
+		for ( std::size_t k = 0; k < values.size( ); ++k )
+		{
+			values[k] = 4.0 * next_value( seed );
+		}
+		gamboge::prediction_cache< nnet_type > sharded( nnet, 128, 8 );
+		for ( int pass = 0; pass < 2; ++pass )
+		{
+			for ( unsigned r = 0; r < 200; ++r )
+			{
+				double direct;
+				nnet.evaluate( &direct, &(values[r*in_count]) );
+				sharded.evaluate( &out, &(values[r*in_count]) );
+				CPPUNIT_ASSERT_EQUAL( direct, out );
+			}
+		}
+		st = sharded.stats( );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 400 ), st.hits + st.misses );
+		CPPUNIT_ASSERT( st.size <= st.capacity );
+		CPPUNIT_ASSERT_EQUAL( st.misses - st.size, st.evictions );
+
+		// a failed evaluation is reported and not cached
+		struct failing_network
+		{
+			typedef double value_type;
+			typedef gamboge::nnet_workspace< double > workspace_type;
+			bool fail;
+			std::size_t inputs( ) const { return in_count; }
+			std::size_t outputs( ) const { return 1; }
+			double* evaluate_batch( double* result, const double* values, std::size_t,
+				std::size_t, workspace_type& ) const
+			{
+				if ( !fail )
+				{
+					*result = values[0];
+					++result;
+				}
+				return result;
+			}
+		};
+		failing_network failing = { true };
+		gamboge::prediction_cache< failing_network > failing_cache( failing, 4, 1 );
+		CPPUNIT_ASSERT( failing_cache.evaluate( &out, rows[0] ) == &out );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 0 ), failing_cache.stats( ).size );
+		failing.fail = false;
+		CPPUNIT_ASSERT( failing_cache.evaluate( &out, rows[0] ) == &out + 1 );
+		CPPUNIT_ASSERT_EQUAL( rows[0][0], out );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 0 ), failing_cache.stats( ).hits );
+	}
+};
+
+// evaluation counters of a model and of the free functions, and their
+// JSON and Prometheus exports
+class statsTestCase : public CppUnit::TestCase
+{
+public:
+	statsTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		const unsigned in_count = 3;
+		const unsigned hidden_count = 2;
+		const unsigned out_count = 1;
+		const double wts[ ] = {
+			 0.56974212, -1.5468268,  1.494846, -2.8907045,
+			-6.5020564,   3.0203401, -1.7088961, 2.5260361,
+			 3.393649,   -6.7710899, -7.2983476
+			};
+		const double values[ ] = { 1.4, 6.8, 4.8,  0.2, -1.0, 3.5,  2.0, 2.0, 2.0 };
+		double nn_out[ 3 ];
+
+		gamboge::nnet_stats model_stats( "example \"321\"" );
+		typedef gamboge::neural_network< const double*, const double*, double*, unsigned > nnet_type;
+		nnet_type nnet( in_count, hidden_count, out_count, &(wts[0]) );
+		nnet.set_stats( &model_stats );
+
+		const gamboge::nnet_stats_snapshot single_start = gamboge::_stats_single( ).snapshot( );
+		nnet.evaluate( nn_out, values );
+		nnet.evaluate_batch( nn_out, values, 3U );
+		nnet.classify_batch( nn_out, values, 3U );
+		gamboge::evaluate_neural_network( values, wts, nn_out, in_count, hidden_count, out_count );
+
+		// a workspace too large to allocate: no outputs, one failure
+		gamboge::nnet_workspace<double> ws;
+		const std::size_t huge = static_cast< std::size_t >( 1 ) << 44;
+		gamboge::evaluate_neural_network( values, wts, nn_out, huge, huge, huge, ws );
+
+		const gamboge::nnet_stats_snapshot model = model_stats.snapshot( );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 3 ), model.calls );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 7 ), model.rows );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 0 ), model.alloc_failures );
+		CPPUNIT_ASSERT_EQUAL( model.calls, std::accumulate( model.latency_buckets,
+			model.latency_buckets + model.bucket_count, static_cast< uint64_t >( 0 ) ) );
+
+		const gamboge::nnet_stats_snapshot single = gamboge::_stats_single( ).snapshot( );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 2 ), single.calls - single_start.calls );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 1 ),
+			single.alloc_failures - single_start.alloc_failures );
+
+		CPPUNIT_ASSERT_EQUAL( static_cast< std::size_t >( 0 ), gamboge::nnet_stats::bucket( 1 ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< std::size_t >( 10 ), gamboge::nnet_stats::bucket( 1024 ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< std::size_t >( 11 ), gamboge::nnet_stats::bucket( 1025 ) );
+		CPPUNIT_ASSERT_EQUAL( model.bucket_count - 1,
+			gamboge::nnet_stats::bucket( ~static_cast< uint64_t >( 0 ) ) );
+
+		std::vector< gamboge::nnet_stats_snapshot > snap( 1, model );
+		const std::string json = gamboge::stats_json( snap );
+		CPPUNIT_ASSERT( json.find( "{\"models\":[{\"name\":\"example \\\"321\\\"\","
+			"\"calls\":3,\"rows\":7,\"alloc_failures\":0," ) == 0 );
+		CPPUNIT_ASSERT( json.find( "{\"le\":null,\"count\":" ) != std::string::npos );
+
+		const std::string text = gamboge::stats_prometheus( snap );
+		CPPUNIT_ASSERT( text.find( "# TYPE gamboge_nnet_calls_total counter\n"
+			"gamboge_nnet_calls_total{model=\"example \\\"321\\\"\"} 3\n" ) != std::string::npos );
+		CPPUNIT_ASSERT( text.find( "gamboge_nnet_rows_total{model=\"example \\\"321\\\"\"} 7\n" )
+			!= std::string::npos );
+		CPPUNIT_ASSERT( text.find( "gamboge_nnet_latency_seconds_bucket{model=\"example \\\"321\\\"\","
+			"le=\"+Inf\"} 3\n" ) != std::string::npos );
+		CPPUNIT_ASSERT( text.find( "gamboge_nnet_latency_seconds_count{model=\"example \\\"321\\\"\"} 3\n" )
+			!= std::string::npos );
+
+		// every registered model is exported, including the free functions
+		const std::string all = gamboge::stats_prometheus( );
+		CPPUNIT_ASSERT( all.find( "{model=\"evaluate_neural_network\"}" ) != std::string::npos );
+		CPPUNIT_ASSERT( all.find( "{model=\"example \\\"321\\\"\"}" ) != std::string::npos );
+	}
+};
+
+// C interface of libgamboge_nnet, compared with the C++ engine
+class cInterfaceTestCase : public CppUnit::TestCase
+{
+public:
+	cInterfaceTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		const unsigned in_count = 3;
+		const unsigned hidden_count = 2;
+		const unsigned out_count = 1;
+		const float wts[ ] = {
+			 0.56974212F, -1.5468268F,  1.494846F, -2.8907045F,
+			-6.5020564F,   3.0203401F, -1.7088961F, 2.5260361F,
+			 3.393649F,   -6.7710899F, -7.2983476F
+			};
+		const float rows[ ] = { 1.4F, 6.8F, 4.8F, 0.2F, -1.0F, 3.5F, 2.0F, 2.0F, 2.0F };
+		const gamboge::neural_network< const float*, const float*, float*, unsigned > nnet(
+			in_count, hidden_count, out_count, &(wts[0]) );
+		float expected[ 3 ];
+		nnet.evaluate_batch( expected, rows, 3 );
+
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint32_t >( GAMBOGE_NNET_ABI_VERSION ),
+			gamboge_nnet_abi_version( ) );
+		gamboge_nnet* handle = 0;
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_OK ), gamboge_nnet_create(
+			in_count, hidden_count, out_count, GAMBOGE_NNET_OUTPUT_DEFAULT, 0, wts, 11, &handle ) );
+		CPPUNIT_ASSERT_EQUAL( 3, gamboge_nnet_inputs( handle ) );
+		CPPUNIT_ASSERT_EQUAL( 2, gamboge_nnet_hidden( handle ) );
+		CPPUNIT_ASSERT_EQUAL( 1, gamboge_nnet_outputs( handle ) );
+
+		float out[ 3 ] = { 0.0F, 0.0F, 0.0F };
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_OK ),
+			gamboge_nnet_evaluate( handle, rows + 3, 3, out, 1 ) );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[1], out[0], 7.8E-7F );
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_OK ),
+			gamboge_nnet_evaluate_batch( handle, rows, 9, 3, out, 3 ) );
+		for ( unsigned r = 0; r < 3; ++r )
+		{
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[r], out[r], 7.8E-7F );
+		}
+
+		// short buffers and bad topologies are rejected
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_INVALID_ARGUMENT ),
+			gamboge_nnet_evaluate( handle, rows, 2, out, 1 ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_INVALID_ARGUMENT ),
+			gamboge_nnet_evaluate_batch( handle, rows, 9, 3, out, 2 ) );
+		gamboge_nnet* bad = 0;
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_INVALID_ARGUMENT ), gamboge_nnet_create(
+			in_count, hidden_count, out_count, GAMBOGE_NNET_OUTPUT_DEFAULT, 0, wts, 10, &bad ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_INVALID_ARGUMENT ), gamboge_nnet_create(
+			0, hidden_count, out_count, GAMBOGE_NNET_OUTPUT_DEFAULT, 0, wts, 11, &bad ) );
+		CPPUNIT_ASSERT( bad == 0 );
+		gamboge_nnet_free( handle );
+		gamboge_nnet_free( 0 );
+
+		// a model file loads with the same outputs
+		const char* path = "gamboge_nnet_c_test.gnnm";
+		CPPUNIT_ASSERT_EQUAL( gamboge::model_ok, gamboge::write_model_file( path,
+			in_count, hidden_count, out_count, wts, gamboge::model_output_logistic ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_OK ), gamboge_nnet_load( path, &handle ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_OK ),
+			gamboge_nnet_evaluate_batch( handle, rows, 9, 3, out, 3 ) );
+		for ( unsigned r = 0; r < 3; ++r )
+		{
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[r], out[r], 7.8E-7F );
+		}
+		gamboge_nnet_free( handle );
+		std::remove( path );
+		CPPUNIT_ASSERT_EQUAL( static_cast< int >( GAMBOGE_NNET_OPEN_FAILED ),
+			gamboge_nnet_load( path, &handle ) );
+	}
+};
+
+// models replaced continuously while several threads evaluate them
+class modelHandleTestCase : public CppUnit::TestCase
+{
+public:
+	modelHandleTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	// weights owned by a snapshot, poisoned when the snapshot is freed
+	struct owned_weights
+	{
+		owned_weights( const double* first, const double* last, std::atomic< unsigned >& freed )
+		: wts( first, last ),
+		  freed( freed )
+		{
+		}
+
+		~owned_weights( )
+		{
+			std::fill( wts.begin( ), wts.end( ), std::numeric_limits< double >::quiet_NaN( ) );
+			++freed;
+		}
+
+		std::vector< double > wts;
+		std::atomic< unsigned >& freed;
+	};
+
+	void runTest( )
+	{
+		const unsigned in_count = 3;
+		const unsigned hidden_count = 2;
+		const unsigned out_count = 1;
+		const double wts[ 2 ][ 11 ] = {
+			{ 0.56974212, -1.5468268,  1.494846, -2.8907045,
+			 -6.5020564,   3.0203401, -1.7088961, 2.5260361,
+			  3.393649,   -6.7710899, -7.2983476 },
+			{ 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1 }
+			};
+		const double row[ in_count ] = { 1.4, 6.8, 4.8 };
+		typedef gamboge::neural_network< const double*, const double*, double*, unsigned > nnet_type;
+		double expected[ 2 ];
+		for ( unsigned m = 0; m < 2; ++m )
+		{
+			nnet_type( in_count, hidden_count, out_count, wts[m] ).evaluate( &(expected[m]), row );
+		}
+
+		gamboge::model_handle< nnet_type > handle;
+		double out = -1.0;
+		CPPUNIT_ASSERT( handle.evaluate( &out, row ) == &out );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( 0 ), handle.version( ) );
+
+		std::atomic< unsigned > freed( 0 );
+		const unsigned publish_count = 2000;
+		std::atomic< bool > done( false );
+		std::atomic< unsigned > mismatches( 0 );
+		std::atomic< unsigned > evaluations( 0 );
+		std::vector< std::thread > readers;
+		for ( unsigned t = 0; t < 4; ++t )
+		{
+			readers.push_back( std::thread( [&]
+				{
+					while ( !done.load( ) )
+					{
+						double y;
+						gamboge::model_handle< nnet_type >::pin p = handle.acquire( );
+						if ( !p )
+						{
+							continue;
+						}
+						p->evaluate( &y, row );
+						// snapshot m + 1 evaluates model m % 2
+						if ( y != expected[ ( p.version( ) - 1 ) % 2 ] )
+						{
+							++mismatches;
+						}
+						++evaluations;
+					}
+				} ) );
+		}
+
+		// each snapshot owns a copy of its weights
+		for ( unsigned k = 0; k < publish_count; ++k )
+		{
+			std::unique_ptr< owned_weights > owner( new owned_weights(
+				wts[ k % 2 ], wts[ k % 2 ] + 11, freed ) );
+			const nnet_type nnet( in_count, hidden_count, out_count, &(owner->wts[0]) );
+			CPPUNIT_ASSERT( handle.publish( nnet, std::move( owner ) ) );
+			if ( k % 64 == 0 )
+			{
+				std::this_thread::yield( );
+			}
+		}
+		while ( evaluations.load( ) < 1000 )
+		{
+			std::this_thread::yield( );
+		}
+		done = true;
+		for ( unsigned t = 0; t < readers.size( ); ++t )
+		{
+			readers[t].join( );
+		}
+
+		CPPUNIT_ASSERT_EQUAL( 0U, mismatches.load( ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast< uint64_t >( publish_count ), handle.version( ) );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 0 ), handle.reclaim( ) );
+		CPPUNIT_ASSERT_EQUAL( publish_count - 1, freed.load( ) );
+		handle.evaluate( &out, row );
+		CPPUNIT_ASSERT_EQUAL( expected[ ( publish_count - 1 ) % 2 ], out );
+
+		// a pinned snapshot survives its replacement
+		{
+			gamboge::model_handle< nnet_type >::pin p = handle.acquire( );
+			std::unique_ptr< owned_weights > owner( new owned_weights( wts[0], wts[0] + 11, freed ) );
+			const nnet_type nnet( in_count, hidden_count, out_count, &(owner->wts[0]) );
+			handle.publish( nnet, std::move( owner ) );
+			CPPUNIT_ASSERT_EQUAL( std::size_t( 1 ), handle.reclaim( ) );
+			p->evaluate( &out, row );
+			CPPUNIT_ASSERT_EQUAL( expected[1], out );
+		}
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 0 ), handle.reclaim( ) );
+		CPPUNIT_ASSERT_EQUAL( publish_count, freed.load( ) );
+	}
+};
+
+// ensemble of networks with different hidden-layer counts
+class ensembleTestCase : public CppUnit::TestCase
+{
+public:
+	ensembleTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		check_ensemble( 1U );
+		check_ensemble( 3U );
+	}
+
+private:
+	void check_ensemble( unsigned out_count )
+	{
+		const unsigned in_count = 5;
+		const unsigned row_count = 300;
+		const unsigned member_count = 6;
+		const unsigned hidden_counts[ member_count ] = { 4, 7, 0, 1, 4, 12 };
+
+		unsigned seed = 4242U;
+		std::vector< std::vector<double> > member_wts( member_count );
+		gamboge::ensemble_network<double> mean_ensemble( in_count, out_count );
+		gamboge::ensemble_network<double, gamboge::vote_reducer<double> > vote_ensemble(
+			in_count, out_count );
+		for ( unsigned m = 0; m < member_count; ++m )
+		{
+			const unsigned nh = hidden_counts[m];
+			member_wts[m].resize( ( nh > 0 ) ? nh * ( 1 + in_count ) + out_count * ( 1 + nh )
+				: out_count * ( 1 + in_count ) );
+			for ( unsigned k = 0; k < member_wts[m].size(); ++k )
+			{
+				member_wts[m][k] = 2.0 * next_value( seed );
+			}
+			mean_ensemble.add_member( nh, member_wts[m].begin() );
+			vote_ensemble.add_member( nh, &(member_wts[m][0]) );
+		}
+		CPPUNIT_ASSERT_EQUAL( std::size_t( member_count ), mean_ensemble.members() );
+		CPPUNIT_ASSERT_EQUAL( std::size_t( 28 ), mean_ensemble.hidden() );
+
+		std::vector<double> values( row_count * in_count );
+		for ( unsigned k = 0; k < values.size(); ++k )
+		{
+			values[k] = 3.0 * next_value( seed );
+		}
+		std::vector<double> mean_out( row_count * out_count );
+		std::vector<double> vote_out( row_count * out_count );
+		mean_ensemble.evaluate_batch( &(mean_out[0]), &(values[0]), row_count );
+		vote_ensemble.evaluate_batch( &(vote_out[0]), &(values[0]), row_count );
+
+		// reference, each member evaluated separately
+		std::vector<double> member_out( out_count );
+		for ( unsigned r = 0; r < row_count; ++r )
+		{
+			std::vector<double> mean( out_count, 0.0 );
+			std::vector<double> votes( out_count, 0.0 );
+			for ( unsigned m = 0; m < member_count; ++m )
+			{
+				gamboge::evaluate_neural_network( &(values[r*in_count]), &(member_wts[m][0]),
+					&(member_out[0]), in_count, hidden_counts[m], out_count );
+				for ( unsigned k = 0; k < out_count; ++k )
+				{
+					mean[k] += member_out[k] / member_count;
+				}
+				if ( out_count > 1 )
+				{
+					votes[ std::max_element( member_out.begin(), member_out.end() )
+						- member_out.begin() ] += 1.0 / member_count;
+				}
+				else if ( member_out[0] > 0.5 )
+				{
+					votes[0] += 1.0 / member_count;
+				}
+			}
+			double max_error = std::inner_product( mean.begin(), mean.end(),
+				&(mean_out[r*out_count]), 0.0, fmax, absdiff<double>() );
+			CPPUNIT_ASSERT_LESS( 1E-12, max_error );
+			max_error = std::inner_product( votes.begin(), votes.end(),
+				&(vote_out[r*out_count]), 0.0, fmax, absdiff<double>() );
+			CPPUNIT_ASSERT_LESS( 1E-12, max_error );
+		}
+
+		// single row evaluation matches the batch
+		std::vector<double> row_out( out_count );
+		mean_ensemble.evaluate( &(row_out[0]), &(values[0]) );
+		CPPUNIT_ASSERT( std::equal( row_out.begin(), row_out.end(), mean_out.begin() ) );
+	}
+};
+
+
+// approximate transfer functions, error bounds over the input range
+class transferFunctionsTestCase : public CppUnit::TestCase
+{
+public:
+	transferFunctionsTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		check_bounds<float>( 1.2E-7, 3.1E-6 );
+		check_bounds<double>( 3E-16, 3.1E-6 );
+	}
+
+private:
+	template< typename T >
+	void check_bounds( double fast_bound, double table_bound )
+	{
+		const gamboge::fast_logistic_output<T> fast_op;
+		const gamboge::table_logistic_output<T> table_op;
+		double fast_error = 0.0;
+		double table_error = 0.0;
+
+		// fine steps where the function varies, coarse steps in the tails
+		// out to the largest finite values
+		std::vector<T> xs;
+		for ( double x = -40.0; x <= 40.0; x += 1.0 / 2048 )
+		{
+			xs.push_back( static_cast<T>( x ) );
+		}
+		for ( double x = 40.0; x < std::numeric_limits<T>::max() / 2; x *= 1.5 )
+		{
+			xs.push_back( static_cast<T>( x ) );
+			xs.push_back( static_cast<T>( -x ) );
+		}
+		xs.push_back( std::numeric_limits<T>::max() );
+		xs.push_back( -std::numeric_limits<T>::max() );
+		xs.push_back( std::numeric_limits<T>::infinity() );
+		xs.push_back( -std::numeric_limits<T>::infinity() );
+
+		for ( std::size_t k = 0; k < xs.size(); ++k )
+		{
+			const double ref = gamboge::logistic_output<double>()( xs[k] );
+			fast_error = std::max( fast_error, std::fabs( fast_op( xs[k] ) - ref ) );
+			table_error = std::max( table_error, std::fabs( table_op( xs[k] ) - ref ) );
+		}
+		CPPUNIT_ASSERT_LESS( fast_bound, fast_error );
+		CPPUNIT_ASSERT_LESS( table_bound, table_error );
+
+		// hidden-layer policy: a 2-2-1 network using each approximation
+		const T wts[ ] = { 0.5, -1.5, 2.0, -0.25, 3.0, 1.0, 1.0, 4.0, -2.0 };
+		const T nn_in[ 2 ] = { 0.75, -0.5 };
+		T exact_out;
+		T fast_out;
+		gamboge::evaluate_neural_network( nn_in, wts, &exact_out, 2U, 2U, 1U );
+		gamboge::evaluate_neural_network( nn_in, wts, &fast_out, 2U, 2U, 1U,
+			fast_op, fast_op );
+		CPPUNIT_ASSERT_LESS( 8.0 * fast_bound, std::fabs( static_cast<double>( fast_out - exact_out ) ) );
+		gamboge::static_neural_network< T, 2, 2, 1, gamboge::logistic_output<T>,
+			gamboge::table_logistic_output<T> > table_nnet( wts );
+		table_nnet.evaluate( &fast_out, nn_in );
+		CPPUNIT_ASSERT_LESS( 8.0 * table_bound, std::fabs( static_cast<double>( fast_out - exact_out ) ) );
+	}
+};
+
+// vectorized kernels at each supported level compared with the
+// portable kernels, over sizes exercising partial vectors
+class simdKernelsTestCase : public CppUnit::TestCase
+{
+public:
+	simdKernelsTestCase( std::string name )
+	: CppUnit::TestCase( name )
+	{}
+
+	void runTest( )
+	{
+		check_kernels<float>( 5E-7F, 1E-6F );
+		check_kernels<double>( 1E-15, 1E-15 );
+	}
+
+private:
+	template< typename FP >
+	void check_kernels( FP layer_tolerance, FP logistic_tolerance )
+	{
+		gamboge::simd_kernels<FP> reference = gamboge::simd_select<FP>( gamboge::simd_scalar );
+
+		for ( int level = gamboge::simd_sse2;
+			level <= gamboge::simd_supported_level( ); ++level )
+		{
+			gamboge::simd_kernels<FP> kernels =
+				gamboge::simd_select<FP>( static_cast<gamboge::simd_level>( level ) );
+
+			// logistic over [ -100, 100 ], partial vectors at the end
+			const unsigned n = 2001;
+			std::vector<FP> y( n );
+			std::vector<FP> y_ref( n );
+			for ( unsigned k = 0; k < n; ++k )
+			{
+				y[k] = y_ref[k] = static_cast<FP>( 0.1 * ( static_cast<int>( k ) - 1000 ) );
+			}
+			kernels.logistic( &(y[0]), n );
+			reference.logistic( &(y_ref[0]), n );
+			FP max_error = std::inner_product( y.begin(), y.end(), y_ref.begin(),
+				static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+			CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check logistic kernel error",
+				CPPUNIT_ASSERT_LESS( logistic_tolerance, max_error ) );
+
+			// layers of 1 to 7 units with 1 to 37 inputs; the rounding error
+			// of the reassociated sums grows with the input count
+			for ( unsigned nin = 1; nin <= 37; nin += 3 )
+			{
+				for ( unsigned nunits = 1; nunits <= 7; ++nunits )
+				{
+					std::vector<FP> w( nunits * ( 1 + nin ) );
+					std::vector<FP> x( nin );
+					for ( unsigned k = 0; k < w.size(); ++k )
+					{
+						w[k] = static_cast<FP>( std::sin( 1.0 + k ) );
+					}
+					for ( unsigned k = 0; k < nin; ++k )
+					{
+						x[k] = static_cast<FP>( std::cos( 2.0 + k ) );
+					}
+					std::vector<FP> out( nunits );
+					std::vector<FP> out_ref( nunits );
+					kernels.layer( &(w[0]), &(x[0]), nin, nunits, &(out[0]) );
+					reference.layer( &(w[0]), &(x[0]), nin, nunits, &(out_ref[0]) );
+					max_error = std::inner_product( out.begin(), out.end(), out_ref.begin(),
+						static_cast<FP>( 0 ), fmax, absdiff<FP>() );
+					CPPUNIT_ASSERT_ASSERTION_PASS_MESSAGE( "check layer kernel error",
+						CPPUNIT_ASSERT_LESS( layer_tolerance * nin, max_error ) );
+				}
+			}
+		}
+	}
+};
+
 void
 gamboge_nnet_runtests( )
 {
@@ -341,7 +2353,19 @@ gamboge_nnet_runtests( )
 	suite->addTest( new ann631TestCase( "nnet 6-3-1 topology" ) );
 	suite->addTest( new ann321TestCase( "nnet 3-2-1 topology" ) );
 	suite->addTest( new ann423TestCase( "nnet 4-2-3 topology" ) );
+	suite->addTest( new skipLayerTestCase( "nnet skip-layer and output modes" ) );
 	suite->addTest( new example321TestCase( "example 3-2-1 neural network" ) );
+	suite->addTest( new exampleStatic321TestCase( "example 3-2-1 static neural network" ) );
+	suite->addTest( new batchBlocksTestCase( "batch evaluation row blocks" ) );
+	suite->addTest( new sparseNetworkTestCase( "sparse network" ) );
+	suite->addTest( new rawColumnsTestCase( "raw input columns" ) );
+	suite->addTest( new predictionCacheTestCase( "prediction cache" ) );
+	suite->addTest( new statsTestCase( "evaluation counters" ) );
+	suite->addTest( new cInterfaceTestCase( "C interface" ) );
+	suite->addTest( new modelHandleTestCase( "model replaced during evaluation" ) );
+	suite->addTest( new simdKernelsTestCase( "vectorized kernels" ) );
+	suite->addTest( new ensembleTestCase( "ensemble of networks" ) );
+	suite->addTest( new transferFunctionsTestCase( "approximate transfer functions" ) );
 
 	runner.addTest( suite );
 	runner.run( );
@@ -0,0 +1,631 @@
+// nnet_predict, streaming neural network scorer
+//
+// usage: nnet_predict [ -i csv|bin ] [ -o csv|bin ] [ -r rows ] [ -H ]
+//                     model [ input ]
+//
+//   -i csv|bin  input format: comma separated text, one row per line
+//               (default), or raw little-endian values of the model's
+//               element type, nx values per row
+//   -o csv|bin  output format, as for -i; ny values per row
+//   -r rows     rows per block (default 4096)
+//   -H          skip a header line in csv input
+//   model       model file written by write_model_file or write.nnet.model
+//   input       input file; standard input if omitted or "-"
+//
+// Predictions are written to standard output. Reading, parsing,
+// evaluation and writing run as pipeline stages on their own threads.
+// Blocks of rows are passed between the stages through a fixed pool of
+// buffers, two for each stage, so memory use does not depend on the size
+// of the input.
+
+#include "gamboge/model_file.h"
+#include "gamboge/nnet.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	enum stream_format
+	{
+		format_csv,
+		format_bin
+	};
+
+	struct options
+	{
+		options( )
+		: input_format( format_csv ),
+		  output_format( format_csv ),
+		  block_rows( 4096 ),
+		  skip_header( false ),
+		  model_path( 0 ),
+		  input_path( 0 )
+		{
+		}
+
+		stream_format input_format;
+		stream_format output_format;
+		std::size_t block_rows;
+		bool skip_header;
+		const char* model_path;
+		const char* input_path;
+	};
+
+	// rows in flight between the pipeline stages
+	template< typename T >
+	struct block
+	{
+		block( )
+		: rows( 0 ),
+		  first_line( 0 ),
+		  last( false )
+		{
+		}
+
+		std::vector< char > raw;       // bytes read, whole lines for csv
+		std::vector< T > values;       // parsed input rows
+		std::vector< T > outputs;      // predictions
+		std::size_t rows;
+		std::size_t first_line;        // csv line number of the first byte
+		bool last;                     // end of the stream
+	};
+
+	// blocking queue of blocks; never holds more than the pool size
+	template< typename T >
+	class block_queue
+	{
+	public:
+		void push( block< T >* b )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				blocks.push_back( b );
+			}
+			ready.notify_one( );
+		}
+
+		block< T >* pop( )
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			ready.wait( lock, [this] { return !blocks.empty( ); } );
+			block< T >* b = blocks.front( );
+			blocks.pop_front( );
+			return b;
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::deque< block< T >* > blocks;
+	};
+
+	// first error reported by any stage
+	class pipeline_error
+	{
+	public:
+		pipeline_error( )
+		: failed( false )
+		{
+		}
+
+		void set( const std::string& what )
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			if ( !failed )
+			{
+				message = what;
+				failed = true;
+			}
+		}
+
+		bool is_set( ) const
+		{
+			return failed;
+		}
+
+		const std::string& what( ) const
+		{
+			return message;
+		}
+
+	private:
+		std::mutex mutex;
+		std::atomic< bool > failed;
+		std::string message;
+	};
+
+	template< typename T >
+	struct value_format;
+
+	template< >
+	struct value_format< float >
+	{
+		static float parse( const char* s, char** end )
+		{
+			return std::strtof( s, end );
+		}
+
+		static const char* print( )
+		{
+			return "%.9g";
+		}
+	};
+
+	template< >
+	struct value_format< double >
+	{
+		static double parse( const char* s, char** end )
+		{
+			return std::strtod( s, end );
+		}
+
+		static const char* print( )
+		{
+			return "%.17g";
+		}
+	};
+
+	template< typename T >
+	class pipeline
+	{
+	public:
+		typedef gamboge::neural_network< const T*, const T*, T*, unsigned > nnet_type;
+
+		pipeline( const options& opts, const gamboge::mapped_model& model,
+			std::FILE* in, std::FILE* out )
+		: opts( opts ),
+		  model( model ),
+		  nnet( model.network< T >( ) ),
+		  in( in ),
+		  out( out ),
+		  nx( model.header( ).input_count ),
+		  ny( model.header( ).output_count ),
+		  line( 1 )
+		{
+		}
+
+		bool run( std::string& message )
+		{
+			// two blocks for each stage: one being worked on while the
+			// other waits for, or is taken by, the neighbouring stage
+			block< T > pool[ 8 ];
+			for ( std::size_t k = 0; k < sizeof( pool ) / sizeof( pool[0] ); ++k )
+			{
+				free_blocks.push( &(pool[k]) );
+			}
+
+			std::thread parser( &pipeline::parse_stage, this );
+			std::thread evaluator( &pipeline::evaluate_stage, this );
+			std::thread writer( &pipeline::write_stage, this );
+			read_stage( );
+			parser.join( );
+			evaluator.join( );
+			writer.join( );
+
+			if ( error.is_set( ) )
+			{
+				message = error.what( );
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		void read_stage( )
+		{
+			std::vector< char > carry;
+			bool at_end = false;
+			if ( opts.input_format == format_csv && opts.skip_header )
+			{
+				int c;
+				while ( ( c = std::fgetc( in ) ) != EOF && c != '\n' )
+				{
+				}
+				++line;
+			}
+			while ( !at_end )
+			{
+				block< T >* b = free_blocks.pop( );
+				b->rows = 0;
+				b->raw.swap( carry );
+				carry.clear( );
+				b->first_line = line;
+				if ( error.is_set( ) )
+				{
+					at_end = true;
+				}
+				else if ( opts.input_format == format_csv )
+				{
+					at_end = read_lines( *b, carry );
+				}
+				else
+				{
+					at_end = read_rows( *b );
+				}
+				b->last = at_end;
+				parsed_queue.push( b );
+			}
+		}
+
+		// read whole lines, about 64 bytes a row; the partial line at the
+		// end of the block is carried into the next
+		bool read_lines( block< T >& b, std::vector< char >& carry )
+		{
+			const std::size_t target = opts.block_rows * 64;
+			std::size_t used = b.raw.size( );
+			b.raw.resize( std::max( target, used + 4096 ) );
+			bool eof = false;
+			for ( ;; )
+			{
+				std::size_t n = std::fread( &(b.raw[used]), 1, b.raw.size( ) - used, in );
+				used += n;
+				if ( n == 0 )
+				{
+					eof = true;
+					if ( std::ferror( in ) )
+					{
+						error.set( "read error" );
+					}
+					break;
+				}
+				if ( used == b.raw.size( ) )
+				{
+					// split after the last newline; a block holds at least one line
+					std::size_t split = used;
+					while ( split > 0 && b.raw[split-1] != '\n' )
+					{
+						--split;
+					}
+					if ( split > 0 )
+					{
+						carry.assign( b.raw.begin( ) + split, b.raw.begin( ) + used );
+						used = split;
+						break;
+					}
+					b.raw.resize( 2 * b.raw.size( ) );
+				}
+			}
+			b.raw.resize( used );
+			for ( std::size_t k = 0; k < used; ++k )
+			{
+				line += ( b.raw[k] == '\n' );
+			}
+			return eof;
+		}
+
+		bool read_rows( block< T >& b )
+		{
+			const std::size_t row_bytes = nx * sizeof( T );
+			b.raw.resize( opts.block_rows * row_bytes );
+			std::size_t n = std::fread( &(b.raw[0]), 1, b.raw.size( ), in );
+			b.raw.resize( n );
+			if ( n % row_bytes != 0 )
+			{
+				error.set( "input ends within a row" );
+			}
+			else if ( std::ferror( in ) )
+			{
+				error.set( "read error" );
+			}
+			return n < opts.block_rows * row_bytes;
+		}
+
+		void parse_stage( )
+		{
+			for ( bool last = false; !last; )
+			{
+				block< T >* b = parsed_queue.pop( );
+				last = b->last;
+				if ( !error.is_set( ) )
+				{
+					if ( opts.input_format == format_csv )
+					{
+						parse_lines( *b );
+					}
+					else
+					{
+						b->rows = b->raw.size( ) / ( nx * sizeof( T ) );
+						b->values.resize( b->rows * nx );
+						if ( b->rows > 0 )
+						{
+							std::memcpy( &(b->values[0]), &(b->raw[0]), b->raw.size( ) );
+						}
+					}
+				}
+				eval_queue.push( b );
+			}
+		}
+
+		void parse_lines( block< T >& b )
+		{
+			b.raw.push_back( '\0' );
+			b.values.clear( );
+			std::size_t lineno = b.first_line;
+			const char* p = &(b.raw[0]);
+			const char* end = p + b.raw.size( ) - 1;
+			while ( p < end )
+			{
+				const char* eol = static_cast< const char* >( std::memchr( p, '\n', end - p ) );
+				if ( eol == 0 )
+				{
+					eol = end;
+				}
+				// blank lines are skipped
+				const char* q = p;
+				while ( q < eol && ( *q == ' ' || *q == '\t' || *q == '\r' ) )
+				{
+					++q;
+				}
+				if ( q < eol )
+				{
+					for ( std::size_t k = 0; k < nx; ++k )
+					{
+						char* next;
+						T v = value_format< T >::parse( p, &next );
+						if ( next == p || next > eol )
+						{
+							fail_line( lineno, "expected a number" );
+							return;
+						}
+						b.values.push_back( v );
+						p = next;
+						while ( p < eol && ( *p == ' ' || *p == '\t' || *p == '\r' ) )
+						{
+							++p;
+						}
+						if ( k + 1 < nx )
+						{
+							if ( p == eol || *p != ',' )
+							{
+								fail_line( lineno, "too few fields" );
+								return;
+							}
+							++p;
+						}
+						else if ( p != eol )
+						{
+							fail_line( lineno, "too many fields" );
+							return;
+						}
+					}
+					++b.rows;
+				}
+				p = eol + 1;
+				++lineno;
+			}
+		}
+
+		void fail_line( std::size_t lineno, const char* what )
+		{
+			char buf[ 64 ];
+			std::snprintf( buf, sizeof( buf ), "line %lu: ",
+				static_cast< unsigned long >( lineno ) );
+			error.set( std::string( buf ) + what );
+		}
+
+		void evaluate_stage( )
+		{
+			typename nnet_type::workspace_type ws;
+			for ( bool last = false; !last; )
+			{
+				block< T >* b = eval_queue.pop( );
+				last = b->last;
+				if ( !error.is_set( ) && b->rows > 0 )
+				{
+					b->outputs.resize( b->rows * ny );
+					T* end = nnet.evaluate_batch( &(b->outputs[0]), &(b->values[0]),
+						static_cast< unsigned >( b->rows ), nx, ws );
+					if ( end != &(b->outputs[0]) + b->rows * ny )
+					{
+						error.set( "out of memory" );
+					}
+				}
+				write_queue.push( b );
+			}
+		}
+
+		void write_stage( )
+		{
+			std::vector< char > text;
+			for ( bool last = false; !last; )
+			{
+				block< T >* b = write_queue.pop( );
+				last = b->last;
+				if ( !error.is_set( ) && b->rows > 0 )
+				{
+					if ( opts.output_format == format_csv )
+					{
+						format_rows( *b, text );
+						write( &(text[0]), text.size( ) );
+					}
+					else
+					{
+						write( &(b->outputs[0]), b->outputs.size( ) * sizeof( T ) );
+					}
+				}
+				free_blocks.push( b );
+			}
+			if ( std::fflush( out ) != 0 )
+			{
+				error.set( "write error" );
+			}
+		}
+
+		void format_rows( const block< T >& b, std::vector< char >& text )
+		{
+			// 26 characters hold any %.17g value and its separator
+			text.resize( b.rows * ny * 26 );
+			char* p = &(text[0]);
+			for ( std::size_t k = 0; k < b.rows * ny; ++k )
+			{
+				p += std::sprintf( p, value_format< T >::print( ), b.outputs[k] );
+				*p++ = ( k % ny == ny - 1 ) ? '\n' : ',';
+			}
+			text.resize( p - &(text[0]) );
+		}
+
+		void write( const void* p, std::size_t n )
+		{
+			if ( std::fwrite( p, 1, n, out ) != n )
+			{
+				error.set( "write error" );
+			}
+		}
+
+		const options& opts;
+		const gamboge::mapped_model& model;
+		const nnet_type nnet;
+		std::FILE* in;
+		std::FILE* out;
+		const unsigned nx;
+		const unsigned ny;
+		std::size_t line;               // csv line number, reader stage only
+		block_queue< T > free_blocks;
+		block_queue< T > parsed_queue;
+		block_queue< T > eval_queue;
+		block_queue< T > write_queue;
+		pipeline_error error;
+	};
+
+	const char*
+	status_message( gamboge::model_status status )
+	{
+		switch ( status )
+		{
+		case gamboge::model_ok:
+			return "ok";
+		case gamboge::model_open_failed:
+			return "cannot open file";
+		case gamboge::model_bad_magic:
+			return "not a model file";
+		case gamboge::model_bad_version:
+			return "unsupported model file version";
+		case gamboge::model_bad_header:
+			return "invalid model file header";
+		case gamboge::model_truncated:
+			return "model file is truncated";
+		case gamboge::model_bad_checksum:
+			return "model weights do not match the checksum";
+		default:
+			return "cannot read model file";
+		}
+	}
+
+	bool
+	parse_format( const char* arg, stream_format& format )
+	{
+		if ( std::strcmp( arg, "csv" ) == 0 )
+		{
+			format = format_csv;
+		}
+		else if ( std::strcmp( arg, "bin" ) == 0 )
+		{
+			format = format_bin;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	int
+	usage( )
+	{
+		std::fprintf( stderr, "usage: nnet_predict [ -i csv|bin ] [ -o csv|bin ] [ -r rows ] [ -H ]"
+			" model [ input ]\n" );
+		return 2;
+	}
+}
+
+int
+main( int argc, char* argv[] )
+{
+	options opts;
+	int k = 1;
+	for ( ; k < argc && argv[k][0] == '-' && argv[k][1] != '\0'; ++k )
+	{
+		const std::string flag( argv[k] );
+		if ( flag == "-H" )
+		{
+			opts.skip_header = true;
+		}
+		else if ( k + 1 < argc && ( flag == "-i" || flag == "-o" || flag == "-r" ) )
+		{
+			const char* arg = argv[++k];
+			if ( flag == "-r" )
+			{
+				opts.block_rows = std::strtoul( arg, 0, 10 );
+				if ( opts.block_rows == 0 )
+				{
+					return usage( );
+				}
+			}
+			else if ( !parse_format( arg, ( flag == "-i" ) ? opts.input_format : opts.output_format ) )
+			{
+				return usage( );
+			}
+		}
+		else
+		{
+			return usage( );
+		}
+	}
+	if ( k == argc || argc - k > 2 )
+	{
+		return usage( );
+	}
+	opts.model_path = argv[k];
+	opts.input_path = ( k + 1 < argc ) ? argv[k+1] : 0;
+
+	gamboge::mapped_model model;
+	gamboge::model_status status = model.open( opts.model_path );
+	if ( status != gamboge::model_ok )
+	{
+		std::fprintf( stderr, "nnet_predict: %s: %s\n", opts.model_path, status_message( status ) );
+		return 1;
+	}
+	const gamboge::model_file_header& hdr = model.header( );
+
+	std::FILE* in = stdin;
+	if ( opts.input_path != 0 && std::strcmp( opts.input_path, "-" ) != 0 )
+	{
+		in = std::fopen( opts.input_path, ( opts.input_format == format_bin ) ? "rb" : "r" );
+		if ( in == 0 )
+		{
+			std::fprintf( stderr, "nnet_predict: %s: cannot open file\n", opts.input_path );
+			return 1;
+		}
+	}
+
+	std::string message;
+	bool ok;
+	if ( hdr.element_type == gamboge::model_element_float )
+	{
+		ok = pipeline< float >( opts, model, in, stdout ).run( message );
+	}
+	else
+	{
+		ok = pipeline< double >( opts, model, in, stdout ).run( message );
+	}
+	if ( in != stdin )
+	{
+		std::fclose( in );
+	}
+	if ( !ok )
+	{
+		std::fprintf( stderr, "nnet_predict: %s: %s\n",
+			opts.input_path != 0 ? opts.input_path : "-", message.c_str( ) );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,230 @@
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Runtime.InteropServices;
+using Microsoft.Win32.SafeHandles;
+
+namespace Gamboge
+{
+    /// <summary>
+    /// output-layer transforms, as gamboge_nnet_output in gamboge/nnet_c.h
+    /// </summary>
+    public enum NativeOutputMode
+    {
+        /// <summary>logistic for one output unit, softmax for several</summary>
+        Default = 0,
+        /// <summary>logistic for each output unit</summary>
+        Logistic = 1,
+        /// <summary>linear output units</summary>
+        Linear = 2,
+        /// <summary>softmax over the output units</summary>
+        Softmax = 3
+    }
+
+    /// <summary>
+    /// artificial neural network evaluated by the native gamboge library
+    /// </summary>
+    /// <remarks>
+    /// Calls libgamboge_nnet through its C interface. Input and output spans
+    /// are pinned for the duration of a call and passed to the library
+    /// directly, without copies. An instance may be evaluated by several
+    /// threads at once.
+    /// </remarks>
+    public sealed class NativeNeuralNetwork : IDisposable
+    {
+        /// <summary>
+        /// constructor
+        /// </summary>
+        /// <param name="n">network inputs count</param>
+        /// <param name="m">hidden-layer units count</param>
+        /// <param name="k">network outputs count</param>
+        /// <param name="wts">network weights, copied</param>
+        public NativeNeuralNetwork(int n, int m, int k, IEnumerable<float> wts)
+            : this(n, m, k, wts, NativeOutputMode.Default, false)
+        {
+        }
+
+        /// <summary>
+        /// constructor
+        /// </summary>
+        /// <param name="n">network inputs count</param>
+        /// <param name="m">hidden-layer units count</param>
+        /// <param name="k">network outputs count</param>
+        /// <param name="wts">network weights, copied</param>
+        /// <param name="output">output-layer transform</param>
+        /// <param name="skip">true for skip-layer connections</param>
+        public NativeNeuralNetwork(int n, int m, int k, IEnumerable<float> wts,
+            NativeOutputMode output, bool skip)
+        {
+            float[] weights = wts as float[] ?? wts.ToArray();
+            unsafe
+            {
+                fixed (float* pw = weights)
+                {
+                    Check(NativeMethods.gamboge_nnet_create(n, m, k, (int)output, skip ? 1 : 0,
+                        pw, (UIntPtr)weights.Length, out handle));
+                }
+            }
+        }
+
+        private NativeNeuralNetwork(NativeNeuralNetworkHandle h)
+        {
+            handle = h;
+        }
+
+        /// <summary>
+        /// Load a network from a model file, see gamboge/model_file.h
+        /// </summary>
+        /// <param name="path">file name</param>
+        /// <returns>network</returns>
+        public static NativeNeuralNetwork Load(string path)
+        {
+            NativeNeuralNetworkHandle h;
+            Check(NativeMethods.gamboge_nnet_load(path, out h));
+            return new NativeNeuralNetwork(h);
+        }
+
+        private readonly NativeNeuralNetworkHandle handle;
+
+        /// <summary>network inputs count</summary>
+        public int Inputs { get { return NativeMethods.gamboge_nnet_inputs(handle); } }
+
+        /// <summary>hidden-layer units count</summary>
+        public int Hidden { get { return NativeMethods.gamboge_nnet_hidden(handle); } }
+
+        /// <summary>network outputs count</summary>
+        public int Outputs { get { return NativeMethods.gamboge_nnet_outputs(handle); } }
+
+        /// <summary>
+        /// Compute artificial neural network output for one input row.
+        /// </summary>
+        /// <param name="values">input row</param>
+        /// <param name="result">receives the outputs</param>
+        public void Evaluate(ReadOnlySpan<float> values, Span<float> result)
+        {
+            unsafe
+            {
+                fixed (float* px = values)
+                fixed (float* py = result)
+                {
+                    Check(NativeMethods.gamboge_nnet_evaluate(handle, px, (UIntPtr)values.Length,
+                        py, (UIntPtr)result.Length));
+                }
+            }
+        }
+
+        /// <summary>
+        /// Compute artificial neural network outputs for many input rows.
+        /// </summary>
+        /// <param name="values">input rows stored consecutively</param>
+        /// <param name="rows">row count</param>
+        /// <param name="result">receives the outputs, rows stored consecutively</param>
+        public void EvaluateBatch(ReadOnlySpan<float> values, int rows, Span<float> result)
+        {
+            if (rows < 0)
+            {
+                throw new ArgumentOutOfRangeException("rows");
+            }
+            unsafe
+            {
+                fixed (float* px = values)
+                fixed (float* py = result)
+                {
+                    Check(NativeMethods.gamboge_nnet_evaluate_batch(handle, px, (UIntPtr)values.Length,
+                        (UIntPtr)rows, py, (UIntPtr)result.Length));
+                }
+            }
+        }
+
+        /// <summary>
+        /// Compute artificial neural network output, as NeuralNetwork.Compute
+        /// </summary>
+        /// <param name="values">input value sequence</param>
+        /// <returns>neural network output values</returns>
+        public IEnumerable<float> Compute(IEnumerable<float> values)
+        {
+            float[] inputs = values as float[] ?? values.ToArray();
+            float[] result = new float[Outputs];
+            Evaluate(inputs, result);
+            return result;
+        }
+
+        /// <summary>
+        /// Release the native network.
+        /// </summary>
+        public void Dispose()
+        {
+            handle.Dispose();
+        }
+
+        private static void Check(int status)
+        {
+            switch (status)
+            {
+                case NativeMethods.GAMBOGE_NNET_OK:
+                    return;
+                case NativeMethods.GAMBOGE_NNET_INVALID_ARGUMENT:
+                    throw new ArgumentException("invalid network topology, or buffer too short");
+                case NativeMethods.GAMBOGE_NNET_OUT_OF_MEMORY:
+                    throw new OutOfMemoryException();
+                case NativeMethods.GAMBOGE_NNET_OPEN_FAILED:
+                    throw new System.IO.IOException("model file could not be opened");
+                default:
+                    throw new System.IO.InvalidDataException("model file rejected");
+            }
+        }
+    }
+
+    internal sealed class NativeNeuralNetworkHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        public NativeNeuralNetworkHandle()
+            : base(true)
+        {
+        }
+
+        protected override bool ReleaseHandle()
+        {
+            NativeMethods.gamboge_nnet_free(handle);
+            return true;
+        }
+    }
+
+    internal static unsafe class NativeMethods
+    {
+        private const string Library = "gamboge_nnet";
+
+        public const int GAMBOGE_NNET_OK = 0;
+        public const int GAMBOGE_NNET_INVALID_ARGUMENT = -1;
+        public const int GAMBOGE_NNET_OUT_OF_MEMORY = -2;
+        public const int GAMBOGE_NNET_OPEN_FAILED = -3;
+        public const int GAMBOGE_NNET_BAD_MODEL = -4;
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gamboge_nnet_create(int nx, int nh, int ny, int output, int skip,
+            float* wts, UIntPtr wts_count, out NativeNeuralNetworkHandle nnet);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi,
+            BestFitMapping = false, ThrowOnUnmappableChar = true)]
+        public static extern int gamboge_nnet_load(string path, out NativeNeuralNetworkHandle nnet);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void gamboge_nnet_free(IntPtr nnet);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gamboge_nnet_inputs(NativeNeuralNetworkHandle nnet);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gamboge_nnet_hidden(NativeNeuralNetworkHandle nnet);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gamboge_nnet_outputs(NativeNeuralNetworkHandle nnet);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gamboge_nnet_evaluate(NativeNeuralNetworkHandle nnet,
+            float* values, UIntPtr values_count, float* result, UIntPtr result_count);
+
+        [DllImport(Library, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gamboge_nnet_evaluate_batch(NativeNeuralNetworkHandle nnet,
+            float* values, UIntPtr values_count, UIntPtr nrows, float* result, UIntPtr result_count);
+    }
+}
@@ -3,6 +3,9 @@ using System;
 using System.Collections.Generic;
 using System.Linq;
 using Gamboge;
+#if GAMBOGE_NATIVE
+using NeuralNetwork = Gamboge.NativeNeuralNetwork;
+#endif
 
 namespace UnitTest
 {